@@ -14,6 +14,8 @@
 
 #include <iostream>
 
+#include <afina/allocator/StlAllocator.h>
+
 namespace Afina {
 
 /**
@@ -169,9 +171,9 @@ private:
     std::set<std::thread::id> threads;
 
     /**
-     * Task queue
+     * Task queue, blocks come from the process arena, see Allocator::DefaultArena
      */
-    std::deque<std::function<void()>> tasks;
+    std::deque<std::function<void()>, Allocator::StlAllocator<std::function<void()>>> tasks;
 
     /**
      * Flag to stop bg threads
@@ -0,0 +1,39 @@
+#ifndef AFINA_METADATA_H
+#define AFINA_METADATA_H
+
+#include <cstdint>
+#include <ctime>
+
+namespace Afina {
+
+/**
+ * # Item metadata
+ * Fixed size header storage keeps next to each value: opaque client flags, expiration time
+ * and version. Header is a part of the storage entry itself, so it costs no extra allocation
+ * and is read together with the entry
+ */
+struct Metadata {
+    Metadata() : cas(0), expire(0), flags(0) {}
+
+    Metadata(uint32_t flags, time_t expire) : cas(0), expire(static_cast<uint32_t>(expire)), flags(flags) {}
+
+    /**
+     * Whether item is expired by the given unix time
+     */
+    bool expired(time_t now) const { return (expire != 0) && (time_t(expire) <= now); }
+
+    // Version of the item, storage assigns it on every modification
+    uint64_t cas;
+
+    // Unix time item expires at, 0 if it never does
+    uint32_t expire;
+
+    // Opaque flags client passed along with the value, storage never interprets them
+    uint32_t flags;
+};
+
+static_assert(sizeof(Metadata) == 16, "Metadata must stay compact");
+
+} // namespace Afina
+
+#endif // AFINA_METADATA_H
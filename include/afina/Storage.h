@@ -1,7 +1,13 @@
 #ifndef AFINA_STORAGE_H
 #define AFINA_STORAGE_H
 
+#include <memory>
 #include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/Metadata.h>
+#include <afina/Value.h>
 
 namespace Afina {
 
@@ -10,6 +16,32 @@ namespace Afina {
  */
 class Storage {
 public:
+    /**
+     * Outcome of the CompareAndSwap operation
+     */
+    enum class CasResult {
+        // Value has been replaced
+        Stored,
+        // Value can't be stored at all, for example because it is too big
+        NotStored,
+        // Association was modified since version given has been read
+        Exists,
+        // There is no association for the key
+        NotFound
+    };
+
+    /**
+     * Outcome of the Increment and Decrement operations
+     */
+    enum class ArithmeticResult {
+        // Value has been updated
+        Stored,
+        // There is no association for the key
+        NotFound,
+        // Value isn't a decimal representation of 64-bit unsigned integer
+        NonNumeric
+    };
+
     Storage() {}
     virtual ~Storage() {}
 
@@ -30,6 +62,17 @@ public:
      */
     virtual bool Put(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but value is stored along with the given flags and
+     * expiration time. Once expiration time passes storage behaves like
+     * there is no such key
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param meta flags and expiration time to store, cas is ignored
+     */
+    virtual bool Put(const std::string &key, const std::string &value, const Metadata &meta) = 0;
+
     /**
      * Stores association between given key/value pair if key isn't present in
      * storage.
@@ -43,6 +86,16 @@ public:
      */
     virtual bool PutIfAbsent(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but value is stored along with the given flags and
+     * expiration time. Expired association is considered to be absent
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param meta flags and expiration time to store, cas is ignored
+     */
+    virtual bool PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) = 0;
+
     /**
      * Updates existing association between given key/value pair
      * If requested key doesn't present in storage method returns false and
@@ -56,6 +109,69 @@ public:
      */
     virtual bool Set(const std::string &key, const std::string &value) = 0;
 
+    /**
+     * Same as above, but flags and expiration time get replaced as well.
+     * Expired association can't be updated
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param meta flags and expiration time to store, cas is ignored
+     */
+    virtual bool Set(const std::string &key, const std::string &value, const Metadata &meta) = 0;
+
+    /**
+     * Adds data to the end of existing value, flags and expiration time stay as they were.
+     * Operation is atomic: concurrent updates of the same key never get lost
+     *
+     * If requested key doesn't present in storage or value would become too big
+     * method returns false and doesn't change anything
+     *
+     * @param key to update value for
+     * @param data to be added to the value
+     */
+    virtual bool Append(const std::string &key, const std::string &data) = 0;
+
+    /**
+     * Same as above, but data is added in front of existing value
+     *
+     * @param key to update value for
+     * @param data to be added to the value
+     */
+    virtual bool Prepend(const std::string &key, const std::string &data) = 0;
+
+    /**
+     * Treats existing value as decimal 64-bit unsigned integer and adds delta to it,
+     * overflow wraps around. Flags and expiration time stay as they were. Operation is
+     * atomic: concurrent updates of the same key never get lost
+     *
+     * @param key to update value for
+     * @param delta to be added to the value
+     * @param result output parameter to put updated value to
+     */
+    virtual ArithmeticResult Increment(const std::string &key, uint64_t delta, uint64_t &result) = 0;
+
+    /**
+     * Same as above, but delta is subtracted from the value. Value never goes below zero
+     *
+     * @param key to update value for
+     * @param delta to be subtracted from the value
+     * @param result output parameter to put updated value to
+     */
+    virtual ArithmeticResult Decrement(const std::string &key, uint64_t delta, uint64_t &result) = 0;
+
+    /**
+     * Updates existing association only if it wasn't modified since given version was
+     * read. Versions are reported in Metadata::cas by Get and change on every write to
+     * the association, so read-modify-write cycle could be done without any locks
+     *
+     * @param key to be associated with value
+     * @param value to be assigned for the key
+     * @param meta flags and expiration time to store, cas is ignored
+     * @param cas version of the association value is based on
+     */
+    virtual CasResult CompareAndSwap(const std::string &key, const std::string &value, const Metadata &meta,
+                                     uint64_t cas) = 0;
+
     /**
      * Removes association for the given key
      * If requested key doesn't present in storage method returns false and
@@ -77,13 +193,73 @@ public:
      * If there is an association for the given key then method copies value
      * into given output parameter (possibly extends its size) and return true
      *
-     * In case if given key not found method returns false and doesn't perform
-     * any changes on the output parameter
+     * In case if given key not found or association has expired method returns
+     * false and doesn't perform any changes on the output parameter
      *
      * @param key to retrive1 value for
      * @param value output parameter to copy value to
      */
     virtual bool Get(const std::string &key, std::string &value) const = 0;
+
+    /**
+     * Retrive key for the given value without copy
+     * Same as above, but instead of copy value bytes method returns handle to the value
+     * stored. Bytes referenced by the handle never change, even if association gets
+     * updated or deleted later
+     *
+     * Default implementation copies value, so implementations are encouraged to override
+     * it
+     *
+     * @param key to retrive value for
+     * @param value output parameter to put value handle to
+     */
+    virtual bool Get(const std::string &key, Value &value) const {
+        std::string result;
+        if (!Get(key, result)) {
+            return false;
+        }
+
+        value = Value(std::make_shared<const std::string>(std::move(result)));
+        return true;
+    }
+
+    /**
+     * Retrive value handle along with the item metadata
+     * Same as above, but also fills flags, expiration time and version of the item
+     *
+     * Default implementation reports empty metadata, so implementations that keep it
+     * must override this method
+     *
+     * @param key to retrive value for
+     * @param value output parameter to put value handle to
+     * @param meta output parameter to copy item metadata to
+     */
+    virtual bool Get(const std::string &key, Value &value, Metadata &meta) const {
+        meta = Metadata();
+        return Get(key, value);
+    }
+
+    /**
+     * Implementation specific metrics, such as internal counters. Each metric is a
+     * name/value pair that "stats" command reports back to the client
+     *
+     * @param stats output parameter to append metrics to
+     */
+    virtual void Stats(std::vector<std::pair<std::string, std::string>> &/*stats*/) const {}
+
+    /**
+     * Number of bytes stored items take as storage accounts them: keys and values along with
+     * per-item overhead of the storage structures. Zero if storage doesn't track it
+     */
+    virtual size_t Size() const { return 0; }
+
+    /**
+     * Changes number of bytes items are allowed to take, see Size. Items are evicted right away
+     * if they take more than that. Noop for the storages without size limit
+     *
+     * @param max_size new limit in bytes
+     */
+    virtual void SetMaxSize(size_t /*max_size*/) {}
 };
 
 } // namespace Afina
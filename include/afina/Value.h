@@ -0,0 +1,74 @@
+#ifndef AFINA_VALUE_H
+#define AFINA_VALUE_H
+
+#include <cstddef>
+#include <memory>
+#include <string>
+
+namespace Afina {
+
+/**
+ * # Immutable value handle
+ * Reference to the bytes of a value stored somewhere else, usually inside of the storage. Handle
+ * keeps bytes alive and unchanged as long as it exists, even if storage already replaced or
+ * deleted the association. So value could be passed down to the network layer without copy
+ * and without holding any storage lock while it is being sent out.
+ *
+ * Copying handle is cheap: it only increments reference counter
+ */
+class Value {
+public:
+    Value() : _data(nullptr), _size(0) {}
+
+    /**
+     * Handle to the whole string, string is owned by the handle
+     */
+    explicit Value(std::shared_ptr<const std::string> str)
+        : _owner(str), _data(str ? str->data() : nullptr), _size(str ? str->size() : 0) {}
+
+    /**
+     * Handle to the [data, data + size) bytes that are kept alive by owner
+     */
+    Value(std::shared_ptr<const void> owner, const char *data, size_t size)
+        : _owner(std::move(owner)), _data(data), _size(size) {}
+
+    /**
+     * Creates handle owning a copy of given string
+     */
+    static Value Copy(const std::string &str) { return Value(std::make_shared<const std::string>(str)); }
+
+    /**
+     * Pointer to the first byte of the value
+     */
+    const char *data() const { return _data; }
+
+    /**
+     * Number of bytes in the value
+     */
+    size_t size() const { return _size; }
+
+    bool empty() const { return _size == 0; }
+
+    /**
+     * Copy of the value bytes
+     */
+    std::string str() const { return std::string(_data, _size); }
+
+    /**
+     * Drops reference to the value
+     */
+    void reset() {
+        _owner.reset();
+        _data = nullptr;
+        _size = 0;
+    }
+
+private:
+    std::shared_ptr<const void> _owner;
+    const char *_data;
+    size_t _size;
+};
+
+} // namespace Afina
+
+#endif // AFINA_VALUE_H
@@ -7,6 +7,13 @@ namespace Allocator {
 // to avoid expensive macros calculations and increase compile speed
 class Simple;
 
+/**
+ * Handle of the memory allocated by Simple. Allocator moves blocks around during defragmentation,
+ * so pointer refers to the handle slot in allocator table and the slot refers to the block. Copies
+ * of the pointer share the same slot, so all of them see the block once it is moved.
+ *
+ * Address returned by get is valid until the next realloc or defrag call
+ */
 class Pointer {
 public:
     Pointer();
@@ -17,7 +24,15 @@ public:
     Pointer &operator=(const Pointer &);
     Pointer &operator=(Pointer &&);
 
-    void *get() const { return 0; }
+    void *get() const { return _handle != nullptr ? *_handle : nullptr; }
+
+private:
+    friend class Simple;
+
+    explicit Pointer(void **handle);
+
+    // Slot of the allocator table, nullptr if nothing is allocated
+    void **_handle;
 };
 
 } // namespace Allocator
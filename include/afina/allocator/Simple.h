@@ -3,6 +3,7 @@
 
 #include <string>
 #include <cstddef>
+#include <cstdint>
 
 namespace Afina {
 namespace Allocator {
@@ -18,44 +19,122 @@ class Pointer;
  * Allocator instance doesn't take ownership of wrapped memmory and do not delete it
  * on destruction. So caller must take care of resource cleaup after allocator stop
  * being needs
+ *
+ * Blocks are placed from the bottom of the area, table of handles Pointer refers to grows
+ * down from the top, space in between is never used yet. Each block starts with a header
+ * keeping its size and the handle it belongs to. Freed blocks are merged with free neighbours
+ * and kept in segregated lists: each power of two is split into 8 size ranges. Allocation takes
+ * the first block from the smallest list whose blocks all fit, and tries a few blocks from the
+ * list of its own size only if there are none. So fitting free space is found in a constant time
+ * and big blocks aren't split while smaller ones would do. Since
+ * blocks are reached only through handles, defrag could move all of them to the bottom, leaving
+ * single free space.
+ *
+ * Payloads are aligned to 16 bytes. Allocator isn't thread safe.
+ *
+ * Standard containers keep raw pointers, which blocks moving on defrag can't give them, so they
+ * draw from the Slab through StlAllocator instead
  */
-// TODO: Implements interface to allow usage as C++ allocators
 class Simple {
 public:
     Simple(void *base, const size_t size);
 
     /**
-     * TODO: semantics
+     * Allocates block of at least N bytes, contents are undefined
+     *
      * @param N size_t
+     * @throw AllocError with NoMemory type if there is no space for the block or its handle,
+     * defrag could make some
      */
     Pointer alloc(size_t N);
 
     /**
-     * TODO: semantics
+     * Changes size of the block, contents are kept up to the smaller of the sizes. Block is
+     * shrunk or grown in place if it could, otherwise it is moved. Empty pointer gets a new block
+     *
      * @param p Pointer
      * @param N size_t
+     * @throw AllocError with NoMemory type, p stays intact then
      */
     void realloc(Pointer &p, size_t N);
 
     /**
-     * TODO: semantics
+     * Releases block, p becomes empty. Noop for empty pointer. Other copies of p must not be used
+     * after that
+     *
      * @param p Pointer
+     * @throw AllocError with InvalidFree type if p doesn't belong to the allocator
      */
     void free(Pointer &p);
 
     /**
-     * TODO: semantics
+     * Moves all blocks to the bottom of the area, so the free space is contiguous. Addresses
+     * taken from pointers before the call become invalid
      */
     void defrag();
 
     /**
-     * TODO: semantics
+     * Human readable layout of the area: one line per block with its offset, size and state,
+     * and the handle table summary
      */
     std::string dump() const;
 
+    /**
+     * Bytes taken by the blocks in use, headers included
+     */
+    size_t used() const { return _used; }
+
+    /**
+     * Bytes available for allocations: free blocks and never used space. Single allocation
+     * could take less than that unless area is defragmented
+     */
+    size_t available() const { return reinterpret_cast<char *>(_handles) - _brk + _free_bytes; }
+
+    /**
+     * Size of the largest block that could be allocated right now, headers included
+     */
+    size_t largest_free() const;
+
 private:
+    struct Block;
+
+    // Free block at least that big, nullptr if there is none
+    Block *FindFree(size_t size) const;
+
+    // Takes block of the given size from the free list or the never used space, nullptr if none fits
+    Block *Reserve(size_t size);
+
+    // Marks block free and merges it with free neighbours
+    void Release(Block *b);
+
+    // Gives tail of the used block beyond the given size back
+    void Shrink(Block *b, size_t size);
+
+    void Link(Block *b);
+    void Unlink(Block *b);
+
+    void **TakeHandle();
+    void ReleaseHandle(void **handle);
+
     void *_base;
     const size_t _base_len;
+
+    // Blocks take [_begin, _brk), handles take [_handles, _handles_end)
+    char *_begin;
+    char *_brk;
+    void **_handles;
+    void **_handles_end;
+
+    // Chain of free handles, each one keeps address of the next
+    void **_free_handles;
+
+    // Free blocks lists, see Bin in Simple.cpp. Bit of the mask is set if the list isn't empty
+    static constexpr size_t BINS = 64 * 8;
+    Block *_free[BINS];
+    uint64_t _bins[BINS / 64];
+
+    size_t _used;
+    size_t _free_bytes;
 };
 
 } // namespace Allocator
@@ -0,0 +1,231 @@
+#ifndef AFINA_ALLOCATOR_SLAB_H
+#define AFINA_ALLOCATOR_SLAB_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <mutex>
+#include <vector>
+
+#include <pthread.h>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * # Slab allocator
+ * Allocator for lots of small objects of similar sizes, such as storage entries. Memory is mapped from
+ * the system in arenas of ARENA_SIZE bytes, arena is cut into pages of PAGE_SIZE bytes, and each page is
+ * cut into chunks of the same size. Chunk sizes grow by the factor of 1.25 from MIN_CHUNK up to
+ * MAX_CHUNK, so the chunk is at most a quarter bigger than requested.
+ *
+ * Each thread has its own cache, a magazine of pages per size class, and takes chunks from the pages it
+ * owns without any locks or atomic operations. Chunk freed by the owner thread goes right back to its
+ * page. Chunk freed by any other thread is pushed to the lock-free list of remote frees of the owner,
+ * which owner takes at once when it runs out of free chunks of some class. So memory allocated by one
+ * thread and freed by another returns to the thread that allocates it, and none of them waits for the
+ * other. Cache of the exited thread is left with its pages for the next thread to come, remote frees
+ * are collected by that thread then.
+ *
+ * Page with no chunks in use goes back to the arena, unless it is the last one of the class with free
+ * chunks in the cache, and could be taken by any thread and class then. Only arena is guarded by a lock.
+ * Memory of the page given back to the arena is released to the system (MADV_DONTNEED), so process
+ * shrinks as items go away, arenas themselves are unmapped only when the allocator is destroyed. Blocks
+ * bigger than MAX_CHUNK are mapped separately and unmapped on free.
+ *
+ * Pages are aligned to their size, so the page chunk belongs to is found by the chunk address and free
+ * doesn't need the size. Chunks are aligned to 8 bytes. Allocator is thread safe.
+ *
+ * Arena could be bounded: mapping that would take it over the limit fails, see alloc. See StlAllocator
+ * for the use with the standard containers.
+ *
+ * With huge pages on, arenas are mapped from the explicit huge pages (MAP_HUGETLB) if system has them
+ * reserved. Otherwise arenas and big blocks are aligned to HUGE_PAGE_SIZE and advised to be backed by
+ * transparent huge pages (MADV_HUGEPAGE), which is noop if system has them disabled. Lookups over a big
+ * cache then miss TLB much less often
+ */
+class Slab {
+public:
+    static constexpr size_t PAGE_SIZE = 1 << 20;
+    static constexpr size_t ARENA_SIZE = 16 * PAGE_SIZE;
+
+    // Page header takes the beginning of the page
+    static constexpr size_t HEADER = 64;
+
+    // Size of the huge page arenas are aligned to
+    static constexpr size_t HUGE_PAGE_SIZE = 2 << 20;
+
+    static constexpr size_t MIN_CHUNK = 16;
+
+    // At least 8 chunks fit into a page, so no more than 1/8 of the page is wasted
+    static constexpr size_t MAX_CHUNK = (PAGE_SIZE - HEADER) / 8;
+
+    /**
+     * Usage of a single size class
+     */
+    struct ClassStats {
+        // Bytes each chunk of the class takes
+        size_t chunk_size;
+
+        // Pages class holds
+        size_t pages;
+
+        // Chunks allocated and chunks left free in the pages of the class. Chunks freed by other threads
+        // than the page owner count as used until the owner collects them
+        size_t used;
+        size_t free;
+    };
+
+    /**
+     * @param limit bytes allocator could map from the system at most, 0 means no limit
+     * @param huge_pages back memory with the huge pages, see above
+     */
+    explicit Slab(size_t limit = 0, bool huge_pages = false);
+    ~Slab();
+
+    Slab(const Slab &) = delete;
+    Slab &operator=(const Slab &) = delete;
+
+    /**
+     * Allocates chunk of at least size bytes, contents are undefined
+     *
+     * @throw std::bad_alloc if system has no memory for a new arena, or the new arena or block would
+     * exceed the limit
+     */
+    void *alloc(size_t size);
+
+    /**
+     * Returns chunk back to the thread that allocated it. Noop for nullptr
+     */
+    void free(void *p);
+
+    /**
+     * Bytes the allocation of the given size takes: size of the chunk it gets, or the mapping for the
+     * blocks bigger than MAX_CHUNK
+     */
+    size_t chunk_size(size_t size) const;
+
+    /**
+     * Number of size classes, classes are numbered from the smallest chunk
+     */
+    size_t classes() const { return _n_classes; }
+
+    /**
+     * Class of the chunk allocation of the given size gets, classes() for the blocks bigger than MAX_CHUNK
+     */
+    size_t class_of(size_t size) const { return size > MAX_CHUNK ? _n_classes : ClassOf(size); }
+
+    /**
+     * Address of the page chunk belongs to, or of the mapping for the blocks bigger than MAX_CHUNK
+     */
+    static const void *page_of(const void *p) {
+        return reinterpret_cast<const void *>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(PAGE_SIZE) - 1));
+    }
+
+    /**
+     * Current usage of the given class, summed over the thread caches
+     */
+    ClassStats stats(size_t cls) const;
+
+    /**
+     * Bytes mapped from the system: arenas and blocks bigger than MAX_CHUNK
+     */
+    size_t mapped() const { return _mapped.load(std::memory_order_relaxed); }
+
+    /**
+     * Bytes of the free pages released to the system: mapped, but not resident
+     */
+    size_t released() const { return _released.load(std::memory_order_relaxed); }
+
+    /**
+     * Resident bytes allocated to nobody: free chunks of the pages caches hold and free pages system didn't
+     * take back. Allocations could take them without process growing
+     */
+    size_t unused() const;
+
+    /**
+     * Bytes allocator could map, 0 if there is no limit. Memory mapped already stays when limit goes
+     * down, it only stops allocator from mapping more
+     */
+    size_t limit() const { return _limit.load(std::memory_order_relaxed); }
+    void set_limit(size_t limit) { _limit.store(limit, std::memory_order_relaxed); }
+
+    /**
+     * Whether memory mapped from now on is backed by the huge pages
+     */
+    bool huge_pages() const { return _huge_pages.load(std::memory_order_relaxed); }
+    void set_huge_pages(bool huge_pages) { _huge_pages.store(huge_pages, std::memory_order_relaxed); }
+
+    /**
+     * Bytes of the arenas mapped from the explicit huge pages, and advised to use the transparent ones
+     */
+    size_t hugetlb_bytes() const { return _hugetlb_bytes.load(std::memory_order_relaxed); }
+    size_t thp_bytes() const { return _thp_bytes.load(std::memory_order_relaxed); }
+
+    /**
+     * Number and bytes of blocks bigger than MAX_CHUNK
+     */
+    size_t huge() const { return _huge.load(std::memory_order_relaxed); }
+    size_t huge_bytes() const { return _huge_bytes.load(std::memory_order_relaxed); }
+
+private:
+    struct Page;
+    struct Cache;
+
+    // Class of the chunks big enough for the given size, which must be at most MAX_CHUNK
+    size_t ClassOf(size_t size) const;
+
+    // Cache of the calling thread, takes cache of some exited thread or creates a new one
+    Cache *Local();
+    static void Leave(void *cache);
+
+    // Returns chunk to the page of the calling thread cache
+    void FreeLocal(Cache *cache, Page *page, void *p);
+
+    // Frees chunks other threads returned to the cache
+    void Collect(Cache *cache);
+
+    // Takes free page from the arena, maps new arena if there is none
+    Page *TakePage();
+    void GivePage(Page *page);
+
+    void *AllocHuge(size_t size);
+    void FreeHuge(Page *page);
+
+    // Maps length bytes aligned to PAGE_SIZE, counts them as mapped. Only arenas could take explicit
+    // huge pages: those can't be partially unmapped
+    void *Map(size_t length, bool arena);
+
+    static constexpr size_t MAX_CLASSES = 64;
+    size_t _sizes[MAX_CLASSES];
+    size_t _n_classes;
+
+    // Caches are never deleted before allocator, exited thread leaves its cache for the next one
+    pthread_key_t _local;
+    std::atomic<Cache *> _caches;
+
+    // Guards pages that belong to no cache
+    std::mutex _lock;
+    Page *_free_pages;
+
+    // Part of the last arena pages were never taken from
+    char *_fresh;
+    char *_end;
+
+    std::vector<char *> _arenas;
+
+    std::atomic<size_t> _limit;
+    std::atomic<bool> _huge_pages;
+    std::atomic<size_t> _hugetlb_bytes;
+    std::atomic<size_t> _thp_bytes;
+    std::atomic<size_t> _mapped;
+    std::atomic<size_t> _released;
+    std::atomic<size_t> _retained;
+    std::atomic<size_t> _huge;
+    std::atomic<size_t> _huge_bytes;
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_SLAB_H
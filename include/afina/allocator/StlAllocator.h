@@ -0,0 +1,78 @@
+#ifndef AFINA_ALLOCATOR_STL_ALLOCATOR_H
+#define AFINA_ALLOCATOR_STL_ALLOCATOR_H
+
+#include <cstddef>
+#include <new>
+#include <type_traits>
+
+#include <afina/allocator/Slab.h>
+
+namespace Afina {
+namespace Allocator {
+
+/**
+ * Arena default constructed StlAllocator draws from: the process arena unless changed, nullptr means
+ * the global heap. Process arena is a Slab that is never destroyed, so memory could be freed by the
+ * static objects as well
+ */
+Slab *DefaultArena();
+
+/**
+ * Changes arena default constructed allocators draw from. Memory must be freed to the arena it came
+ * from, so that could be done only while nothing allocated by the default constructed allocators is
+ * alive, that is before storage is built
+ */
+void SetDefaultArena(Slab *arena);
+
+/**
+ * # Standard allocator over Slab
+ * Makes Slab usable by the standard containers: strings, deques, vectors and so on. Allocator is
+ * stateful, it keeps the arena it draws from, copies and rebound copies share it. Containers of
+ * different arenas compare unequal, so their memory never gets mixed up on swap or move. Arena
+ * could be nullptr, memory comes from the global heap then.
+ *
+ * Simple is not adapted: its blocks are reached through handles and move on defrag, while standard
+ * containers keep raw pointers
+ */
+template <typename T> class StlAllocator {
+public:
+    using value_type = T;
+
+    // Arena follows the container contents
+    using propagate_on_container_copy_assignment = std::true_type;
+    using propagate_on_container_move_assignment = std::true_type;
+    using propagate_on_container_swap = std::true_type;
+
+    StlAllocator() : _arena(DefaultArena()) {}
+
+    explicit StlAllocator(Slab *arena) : _arena(arena) {}
+
+    template <typename U> StlAllocator(const StlAllocator<U> &other) : _arena(other.arena()) {}
+
+    T *allocate(size_t n) {
+        size_t size = n * sizeof(T);
+        return static_cast<T *>(_arena != nullptr ? _arena->alloc(size) : ::operator new(size));
+    }
+
+    void deallocate(T *p, size_t) {
+        if (_arena != nullptr) {
+            _arena->free(p);
+        } else {
+            ::operator delete(p);
+        }
+    }
+
+    Slab *arena() const { return _arena; }
+
+    template <typename U> bool operator==(const StlAllocator<U> &other) const { return _arena == other.arena(); }
+
+    template <typename U> bool operator!=(const StlAllocator<U> &other) const { return _arena != other.arena(); }
+
+private:
+    Slab *_arena;
+};
+
+} // namespace Allocator
+} // namespace Afina
+
+#endif // AFINA_ALLOCATOR_STL_ALLOCATOR_H
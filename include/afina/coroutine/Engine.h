@@ -1,20 +1,54 @@
 #ifndef AFINA_COROUTINE_ENGINE_H
 #define AFINA_COROUTINE_ENGINE_H
 
+#include <cstddef>
 #include <cstdint>
+#include <functional>
 #include <iostream>
 #include <map>
 #include <setjmp.h>
+#include <stdexcept>
 #include <tuple>
+#include <utility>
+
+#include <sys/socket.h>
+#include <sys/types.h>
+
+#include <afina/coroutine/StackPool.h>
 
 namespace Afina {
 namespace Coroutine {
 
 /**
  * # Entry point of coroutine library
- * Allows to run coroutine and schedule its execution. Not threadsafe
+ * Allows to run coroutine and schedule its execution. Not threadsafe.
+ *
+ * Engine works in one of two modes. With StackCopy all the coroutines run on the stack of the start()
+ * caller: switch copies the stack of the suspended coroutine into the heap and copies the stack of the
+ * resumed one back, so it costs as much as the stacks are deep. With Dedicated each coroutine gets its
+ * own stack of the fixed size and switch only saves callee-saved registers and the stack pointer of
+ * one coroutine and loads those of the other. Hand-written switch is used on x86-64 and aarch64,
+ * ucontext elsewhere. Stacks come from the StackPool of the engine and are guarded against overflow,
+ * context of the routine is kept on top of its stack, so starting a routine takes no allocation once
+ * the pool is warm.
+ *
+ * Dedicated mode also lets routines wait for I/O and time: read, write, accept and sleep block the
+ * calling routine until file descriptor gets ready or time comes, others run meanwhile. Once every
+ * routine is blocked, engine waits on its epoll, where descriptors and timerfd for sleeps are
+ * registered, and unblocks those ready
  */
 class Engine final {
+public:
+    enum class Mode {
+        // Coroutines share the stack, it is copied on each switch
+        StackCopy,
+        // Each coroutine has a stack of its own, switch is O(1)
+        Dedicated
+    };
+
+    // Stack each coroutine gets in the Dedicated mode
+    static constexpr size_t DEFAULT_STACK_SIZE = 256 * 1024;
+
 private:
     /**
      * A single coroutine instance which could be scheduled for execution
@@ -34,6 +68,19 @@ private:
         // Saved coroutine context (registers)
         jmp_buf Environment;
 
+        // Dedicated mode: stack pointer the switch saved registers at, Low and High bound the stack, body
+        // is the routine along with its arguments
+        void *SP = nullptr;
+        std::function<void()> Body;
+
+        // Dedicated mode: routine is in the blocked list
+        bool Blocked = false;
+
+        // Dedicated mode: what blocked routine waits for, descriptor in epoll or its place among sleepers
+        int WaitFd = -1;
+        bool Sleeping = false;
+        std::multimap<uint64_t, struct context *>::iterator Sleep;
+
         // To include routine in the different lists, such as "alive", "blocked", e.t.c
         struct context *prev = nullptr;
         struct context *next = nullptr;
@@ -59,6 +106,36 @@ private:
      */
     context *idle_ctx;
 
+    const Mode mode;
+
+    /**
+     * Dedicated mode: stacks of the routines
+     */
+    StackPool pool;
+
+    /**
+     * Dedicated mode: routine that has completed, its stack is freed once control leaves it
+     */
+    context *finished;
+
+    /**
+     * Dedicated mode: routines that wait to be unblocked
+     */
+    context *blocked;
+
+    /**
+     * Dedicated mode: epoll of routines waiting for I/O and timerfd for sleeping ones, created once
+     * needed
+     */
+    int epoll_fd;
+    int timer_fd;
+
+    // Routines waiting on epoll
+    size_t io_waiting;
+
+    // Sleeping routines by the CLOCK_MONOTONIC nanoseconds they wake up at
+    std::multimap<uint64_t, context *> sleepers;
+
 protected:
     /**
      * Save stack of the current coroutine in the given context
@@ -75,8 +152,77 @@ protected:
      */
     // void Enter(context& ctx);
 
+    /**
+     * Dedicated mode: takes stack from the pool and places new routine context on its top, so that the
+     * first switch to it calls Body
+     */
+    context *Spawn();
+
+    /**
+     * Dedicated mode: destroys context of the completed routine and gives its stack back to the pool
+     */
+    void Recycle(context *ctx);
+
+    /**
+     * Dedicated mode: saves registers of the running routine and resumes the given one
+     */
+    void Switch(context &ctx);
+
+    /**
+     * Dedicated mode: first function routine runs on its stack, never returns
+     */
+    static void Entry(void *engine);
+
+    /**
+     * Dedicated mode: runs routines until all are done, or blocked with nothing to wake them up. Routines
+     * blocked for good are dropped then
+     */
+    void Loop();
+
+    // Moves routine into the head of the list or out of it
+    static void Link(context *&list, context *ctx);
+    static void Unlink(context *&list, context *ctx);
+
+    /**
+     * Dedicated mode: blocks current routine until fd gets one of the events, false if routine can't wait
+     * and errno is set then
+     */
+    bool Await(int fd, uint32_t events);
+
+    /**
+     * Dedicated mode: waits on epoll until some blocked routine gets ready and unblocks it
+     */
+    void Poll();
+
+    // Creates epoll and timerfd once needed
+    void Reactor();
+
+    // Arms timerfd to the earliest sleeper
+    void Arm();
+
+    // Forgets what routine waits for, so that reactor never wakes it up for that later
+    void Cancel(context *ctx);
+
+    // Calls function with the arguments kept in a tuple
+    template <size_t... I> struct Indices {};
+    template <size_t N, size_t... I> struct MakeIndices : MakeIndices<N - 1, N - 1, I...> {};
+    template <size_t... I> struct MakeIndices<0, I...> {
+        using type = Indices<I...>;
+    };
+
+    template <typename... Ta> struct Call {
+        void (*func)(Ta...);
+        std::tuple<Ta...> args;
+
+        void operator()() { Apply(typename MakeIndices<sizeof...(Ta)>::type()); }
+
+        template <size_t... I> void Apply(Indices<I...>) { func(std::forward<Ta>(std::get<I>(args))...); }
+    };
+
 public:
-    Engine() : StackBottom(0), cur_routine(nullptr), alive(nullptr) {}
+    Engine(Mode mode = Mode::StackCopy, size_t stack_size = DEFAULT_STACK_SIZE)
+        : StackBottom(0), cur_routine(nullptr), alive(nullptr), mode(mode), pool(stack_size), finished(nullptr),
+          blocked(nullptr), epoll_fd(-1), timer_fd(-1), io_waiting(0) {}
     Engine(Engine &&) = delete;
     Engine(const Engine &) = delete;
 
@@ -99,6 +245,38 @@ public:
      */
     void sched(void *routine);
 
+    /**
+     * Dedicated mode: blocks routine, current one if nullptr is given, until unblock is called for it.
+     * Blocked routine is never picked by yield. Once current routine is blocked control goes to the other
+     * one ready to run or to the engine, if there are none
+     */
+    void block(void *routine = nullptr);
+
+    /**
+     * Dedicated mode: makes blocked routine ready to run again, noop for the one which is not blocked.
+     * Wait for I/O or time is cancelled then: sleep returns early, read, write and accept try again. sched
+     * of the blocked routine unblocks it the same way
+     */
+    void unblock(void *routine);
+
+    /**
+     * Same as the system calls, but once fd is not ready the calling routine is blocked until it gets
+     * ready, instead of getting EAGAIN. File descriptor must be in the non-blocking mode, only one routine
+     * could wait for the given fd at a time. Accepted sockets are non-blocking as well.
+     *
+     * Routines wait only in the Dedicated mode, otherwise or outside of the routines these are just the
+     * non-blocking system calls
+     */
+    ssize_t read(int fd, void *buf, size_t count);
+    ssize_t write(int fd, const void *buf, size_t count);
+    int accept(int fd, struct sockaddr *addr = nullptr, socklen_t *addrlen = nullptr);
+
+    /**
+     * Blocks the calling routine for ms milliseconds at least. Outside of the Dedicated mode routines
+     * whole thread sleeps
+     */
+    void sleep(uint64_t ms);
+
     /**
      * Entry point into the engine. Prepare all internal mechanics and starts given function which is
      * considered as main.
@@ -110,6 +288,22 @@ public:
      * @param arguments to be passed to the main coroutine
      */
     template <typename... Ta> void start(void (*main)(Ta...), Ta &&... args) {
+        if (mode == Mode::Dedicated) {
+            // Routines never touch this stack, it only marks engine as started
+            char StackStartsHere;
+            this->StackBottom = &StackStartsHere;
+            idle_ctx = new context();
+
+            void *pc = run(main, std::forward<Ta>(args)...);
+            if (pc != nullptr) {
+                Loop();
+            }
+
+            delete idle_ctx;
+            this->StackBottom = 0;
+            return;
+        }
+
         if (get_stack_dir(nullptr) != -1) {
             throw std::runtime_error("Implementation does not support stack which grows up");
         }
@@ -145,6 +339,20 @@ public:
             return nullptr;
         }
 
+        if (mode == Mode::Dedicated) {
+            context *pc = Spawn();
+
+            // Arguments are kept the way function takes them: references stay references, values are copied
+            pc->Body = Call<Ta...>{func, std::tuple<Ta...>(std::forward<Ta>(args)...)};
+
+            pc->next = alive;
+            alive = pc;
+            if (pc->next != nullptr) {
+                pc->next->prev = pc;
+            }
+            return pc;
+        }
+
         // New coroutine context that carries around all information enough to call function
         context *pc = new context();
 
@@ -177,7 +385,7 @@ public:
             // current coroutine finished, and the pointer is not relevant now
             cur_routine = nullptr;
             pc->prev = pc->next = nullptr;
-            delete std::get<0>(pc->Stack);
+            delete[] std::get<0>(pc->Stack);
             delete pc;
 
             // We cannot return here, as this function "returned" once already, so here we must select some other
@@ -203,7 +411,24 @@ public:
 
 
 
-    int get_stack_dir(char* ptr) {
+    /**
+     * Routine running now, so that it could be scheduled back by the other one later. Outside of the
+     * routines returns nullptr
+     */
+    void *current() const { return cur_routine; }
+
+    /**
+     * Size of the stack each routine gets in the Dedicated mode
+     */
+    size_t stack_size() const { return pool.stack_size(); }
+
+    /**
+     * Pool routine stacks come from in the Dedicated mode
+     */
+    const StackPool &stacks() const { return pool; }
+
+    // Must not be inlined, otherwise both calls could share a frame
+    __attribute__((noinline)) int get_stack_dir(char* ptr) {
         char here;
         char *p = &here;
         if (ptr == nullptr) {
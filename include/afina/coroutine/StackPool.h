@@ -0,0 +1,60 @@
+#ifndef AFINA_COROUTINE_STACK_POOL_H
+#define AFINA_COROUTINE_STACK_POOL_H
+
+#include <cstddef>
+#include <vector>
+
+namespace Afina {
+namespace Coroutine {
+
+/**
+ * # Pool of coroutine stacks
+ * Each stack is mapped separately with a guard page below it, so the coroutine that overflows its stack
+ * faults on the guard page instead of corrupting memory of the neighbour. Stack size is rounded up to
+ * the system page, memory is committed by the system as the stack grows.
+ *
+ * Stacks given back are kept in the free list and handed out again, so taking a stack is a pop unless
+ * the list is empty. At most max_free stacks are kept, the rest are unmapped at once. Not threadsafe,
+ * just like Engine it is used by
+ */
+class StackPool {
+public:
+    explicit StackPool(size_t stack_size, size_t max_free = 1024);
+    ~StackPool();
+
+    StackPool(const StackPool &) = delete;
+    StackPool &operator=(const StackPool &) = delete;
+
+    /**
+     * Returns lowest address of the stack of stack_size() bytes, throws std::bad_alloc if system has no
+     * memory left
+     */
+    char *Get();
+
+    /**
+     * Gives back the stack Get returned
+     */
+    void Put(char *stack);
+
+    size_t stack_size() const { return _stack_size; }
+
+    // Stacks kept in the free list
+    size_t free() const { return _free.size(); }
+
+    // Stacks mapped, both in use and free
+    size_t mapped() const { return _mapped; }
+
+private:
+    size_t _page_size;
+    size_t _stack_size;
+    size_t _max_free;
+    size_t _mapped;
+    std::vector<char *> _free;
+
+    void Unmap(char *stack);
+};
+
+} // namespace Coroutine
+} // namespace Afina
+
+#endif // AFINA_COROUTINE_STACK_POOL_H
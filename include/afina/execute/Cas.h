@@ -0,0 +1,42 @@
+#ifndef AFINA_EXECUTE_CAS_H
+#define AFINA_EXECUTE_CAS_H
+
+#include <cstdint>
+#include <string>
+
+#include "InsertCommand.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Check and set value for the key
+ * Stores given data only if no one else has updated the key since client last
+ * fetched it with "gets" command
+ *
+ * Command must write result to the output, which could be:
+ * - "STORED", to indicate success.
+ * - "NOT_STORED" to indicate the data was not stored, but not because of an
+ * error.
+ * - "EXISTS" to indicate that the item has been modified since client last
+ * fetched it.
+ * - "NOT_FOUND" to indicate that the item did not exist or has been deleted.
+ */
+class Cas : public InsertCommand {
+public:
+    Cas(const std::string &key, uint32_t flags, int32_t expire, uint64_t cas)
+        : InsertCommand(key, flags, expire), _cas(cas) {}
+    ~Cas() {}
+
+    inline uint64_t cas() const { return _cas; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    const uint64_t _cas;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_CAS_H
@@ -3,6 +3,8 @@
 
 #include <string>
 
+#include "Response.h"
+
 namespace Afina {
 
 class Storage;
@@ -19,6 +21,16 @@ public:
     virtual ~Command() {}
 
     virtual void Execute(Storage &storage, const std::string &args, std::string &out) = 0;
+
+    /**
+     * Same as above, but result is appended to the chunked response. Commands that return
+     * values override it to pass them out without copy
+     */
+    virtual void Execute(Storage &storage, const std::string &args, Response &out) {
+        std::string result;
+        Execute(storage, args, result);
+        out.Append(result);
+    }
 };
 
 } // namespace Execute
@@ -0,0 +1,41 @@
+#ifndef AFINA_EXECUTE_DECR_H
+#define AFINA_EXECUTE_DECR_H
+
+#include <cstdint>
+#include <string>
+
+#include "Command.h"
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Decrement value for the key
+ * Treats value as decimal 64-bit unsigned integer and decreases it by the given
+ * amount, value never goes below zero. If key wasn't found then command does
+ * nothing
+ *
+ * Command must write result to the output, which could be:
+ * - new value of the item, to indicate success.
+ * - "NOT_FOUND" to indicate that the item with this key was not found
+ * - "CLIENT_ERROR ..." if value isn't a number
+ */
+class Decr : public Command {
+public:
+    Decr(const std::string &key, uint64_t value) : _key(key), _value(value) {}
+    ~Decr() {}
+
+    inline const std::string &key() const { return _key; }
+    inline uint64_t value() const { return _value; }
+
+    void Execute(Storage &storage, const std::string &args, std::string &out) override;
+
+private:
+    const std::string _key;
+    const uint64_t _value;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_DECR_H
@@ -2,8 +2,11 @@
 #define AFINA_EXECUTE_INSERT_COMMAND_H
 
 #include <cstdint>
+#include <ctime>
 #include <string>
 
+#include <afina/Metadata.h>
+
 #include "Command.h"
 
 namespace Afina {
@@ -22,7 +25,30 @@ public:
     inline const uint32_t flags() const { return _flags; }
     inline const int32_t expire() const { return _expire; }
 
+    /**
+     * Unix time item expires at, 0 if it never does. According to memcached protocol exptime
+     * is either relative number of seconds if it doesn't exceed 30 days or absolute unix time,
+     * negative exptime means item is expired immediately
+     */
+    time_t expire_time() const {
+        if (_expire == 0) {
+            return 0;
+        } else if (_expire < 0) {
+            return 1;
+        } else if (_expire <= MAX_RELATIVE_EXPIRE) {
+            return time(nullptr) + _expire;
+        }
+        return _expire;
+    }
+
+    /**
+     * Metadata to store along with the value
+     */
+    Metadata metadata() const { return Metadata(_flags, expire_time()); }
+
 protected:
+    static const int32_t MAX_RELATIVE_EXPIRE = 60 * 60 * 24 * 30;
+
     const std::string _key;
     const uint32_t _flags;
     const int32_t _expire;
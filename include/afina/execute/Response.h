@@ -0,0 +1,68 @@
+#ifndef AFINA_EXECUTE_RESPONSE_H
+#define AFINA_EXECUTE_RESPONSE_H
+
+#include <string>
+#include <vector>
+
+#include <afina/Value.h>
+
+namespace Afina {
+namespace Execute {
+
+/**
+ * # Command execution result
+ * Response is a sequence of chunks to be sent to the client one after another. Protocol text
+ * is copied into response, while values could be appended as handles to the bytes owned by
+ * storage, so that network layer could send them out using scatter/gather IO without copy
+ */
+class Response {
+public:
+    Response() : _size(0) {}
+    ~Response() {}
+
+    /**
+     * Appends copy of the given text
+     */
+    void Append(const std::string &text);
+
+    /**
+     * Appends value without copy, response keeps reference to the value until cleared
+     */
+    void Append(const Value &value);
+
+    /**
+     * Chunks to be sent out, no more appends allowed after that call
+     */
+    const std::vector<Value> &Chunks();
+
+    /**
+     * Total number of bytes in the response
+     */
+    size_t size() const { return _size; }
+
+    /**
+     * Copy of the whole response as a single string
+     */
+    std::string str() const;
+
+    /**
+     * Drops all chunks, so that response could be used again
+     */
+    void Clear();
+
+private:
+    void Flush();
+
+    // Chunks that are ready to be sent
+    std::vector<Value> _chunks;
+
+    // Text appended after the last chunk, it becomes a separate chunk once value appended
+    std::string _text;
+
+    size_t _size;
+};
+
+} // namespace Execute
+} // namespace Afina
+
+#endif // AFINA_EXECUTE_RESPONSE_H
@@ -2,6 +2,7 @@
 #define AFINA_NETWORK_SERVER_H
 
 #include <memory>
+#include <string>
 #include <vector>
 
 namespace Afina {
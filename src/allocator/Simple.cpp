@@ -1,40 +1,362 @@
 #include <afina/allocator/Simple.h>
 
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <sstream>
+
+#include <afina/allocator/Error.h>
 #include <afina/allocator/Pointer.h>
 
 namespace Afina {
 namespace Allocator {
 
-Simple::Simple(void *base, size_t size) : _base(base), _base_len(size) {}
+namespace {
 
-/**
- * TODO: semantics
- * @param N size_t
- */
-Pointer Simple::alloc(size_t N) { return Pointer(); }
+constexpr size_t ALIGN = 16;
 
-/**
- * TODO: semantics
- * @param p Pointer
- * @param N size_t
- */
-void Simple::realloc(Pointer &p, size_t N) {}
+// Low bits of the block size are used as flags
+constexpr size_t USED = 1;
+constexpr size_t PREV_USED = 2;
+constexpr size_t FLAGS = USED | PREV_USED;
 
-/**
- * TODO: semantics
- * @param p Pointer
- */
-void Simple::free(Pointer &p) {}
+size_t AlignUp(size_t n) { return (n + ALIGN - 1) & ~(ALIGN - 1); }
 
-/**
- * TODO: semantics
- */
-void Simple::defrag() {}
+// Lists split each power of two into 2^SUB_BITS ranges of equal width
+constexpr size_t SUB_BITS = 3;
+
+size_t Log2(size_t n) { return 63 - __builtin_clzll(n); }
+
+// List for the block of the given size, size must be at least 2^SUB_BITS
+size_t Bin(size_t size) {
+    size_t log = Log2(size);
+    return (log << SUB_BITS) + ((size >> (log - SUB_BITS)) & ((1 << SUB_BITS) - 1));
+}
+
+} // namespace
 
 /**
- * TODO: semantics
+ * Header of the block, payload follows it. Free block keeps list links in place of the handle
+ * and at the start of its payload, and its size in the last word, so the block after it could
+ * find where it starts. Block before the free one is always in use, blocks are merged otherwise
  */
-std::string Simple::dump() const { return ""; }
+struct Simple::Block {
+    size_t tag;
+    union {
+        void **handle;
+        Block *next;
+    };
+
+    size_t size() const { return tag & ~FLAGS; }
+    bool used() const { return (tag & USED) != 0; }
+
+    char *payload() { return reinterpret_cast<char *>(this) + sizeof(Block); }
+    Block *following() { return reinterpret_cast<Block *>(reinterpret_cast<char *>(this) + size()); }
+    Block *&prev() { return *reinterpret_cast<Block **>(payload()); }
+    size_t &footer() { return *reinterpret_cast<size_t *>(reinterpret_cast<char *>(this) + size() - sizeof(size_t)); }
+
+    static Block *Of(void *payload) { return reinterpret_cast<Block *>(static_cast<char *>(payload) - sizeof(Block)); }
+};
+
+namespace {
+
+// Free block has to fit header, link to the previous one and footer
+constexpr size_t MIN_BLOCK = 32;
+
+// Blocks of the list tried when none of the bigger lists has any
+constexpr size_t SCAN_LIMIT = 16;
+
+} // namespace
+
+constexpr size_t Simple::BINS;
+
+Simple::Simple(void *base, size_t size)
+    : _base(base), _base_len(size), _free_handles(nullptr), _used(0), _free_bytes(0) {
+    static_assert(sizeof(Block) == ALIGN, "payload must stay aligned");
+    std::fill(_free, _free + BINS, nullptr);
+    std::fill(_bins, _bins + BINS / 64, 0);
+
+    uintptr_t begin = AlignUp(reinterpret_cast<uintptr_t>(base));
+    uintptr_t end = (reinterpret_cast<uintptr_t>(base) + size) & ~(sizeof(void *) - 1);
+    if (end < begin) {
+        end = begin;
+    }
+
+    _begin = _brk = reinterpret_cast<char *>(begin);
+    _handles = _handles_end = reinterpret_cast<void **>(end);
+}
+
+// See Simple.h
+Pointer Simple::alloc(size_t N) {
+    if (N > _base_len) {
+        throw AllocError(AllocErrorType::NoMemory, "Block is bigger than the area");
+    }
+
+    void **handle = TakeHandle();
+    Block *b = Reserve(std::max(AlignUp(N + sizeof(Block)), MIN_BLOCK));
+    if (b == nullptr) {
+        ReleaseHandle(handle);
+        throw AllocError(AllocErrorType::NoMemory, "No free block big enough");
+    }
+
+    b->handle = handle;
+    *handle = b->payload();
+    return Pointer(handle);
+}
+
+// See Simple.h
+void Simple::realloc(Pointer &p, size_t N) {
+    if (p.get() == nullptr) {
+        p = alloc(N);
+        return;
+    }
+    if (N > _base_len) {
+        throw AllocError(AllocErrorType::NoMemory, "Block is bigger than the area");
+    }
+
+    Block *b = Block::Of(p.get());
+    size_t size = std::max(AlignUp(N + sizeof(Block)), MIN_BLOCK);
+    if (size <= b->size()) {
+        Shrink(b, size);
+        return;
+    }
+
+    // The last block grows into never used space
+    Block *next = b->following();
+    if (reinterpret_cast<char *>(next) == _brk) {
+        if (reinterpret_cast<char *>(_handles) - reinterpret_cast<char *>(b) >= ptrdiff_t(size)) {
+            _used += size - b->size();
+            b->tag = size | (b->tag & FLAGS);
+            _brk = reinterpret_cast<char *>(b) + size;
+            return;
+        }
+    } else if (!next->used() && b->size() + next->size() >= size) {
+        // Free neighbour is taken as a whole and the excess is given back
+        Unlink(next);
+        _used += next->size();
+        b->tag = (b->size() + next->size()) | (b->tag & FLAGS);
+        b->following()->tag |= PREV_USED;
+        Shrink(b, size);
+        return;
+    }
+
+    Block *moved = Reserve(size);
+    if (moved == nullptr) {
+        throw AllocError(AllocErrorType::NoMemory, "No free block big enough");
+    }
+
+    std::memcpy(moved->payload(), b->payload(), b->size() - sizeof(Block));
+    moved->handle = b->handle;
+    *moved->handle = moved->payload();
+    Release(b);
+}
+
+// See Simple.h
+void Simple::free(Pointer &p) {
+    void **handle = p._handle;
+    if (handle == nullptr) {
+        return;
+    }
+
+    char *payload = static_cast<char *>(*handle);
+    if (handle < _handles || handle >= _handles_end || payload < _begin + sizeof(Block) || payload >= _brk ||
+        !Block::Of(payload)->used() || Block::Of(payload)->handle != handle) {
+        throw AllocError(AllocErrorType::InvalidFree, "Pointer doesn't refer to a block in use");
+    }
+
+    Release(Block::Of(payload));
+    ReleaseHandle(handle);
+    p._handle = nullptr;
+}
+
+// See Simple.h
+void Simple::defrag() {
+    char *dst = _begin;
+    for (char *src = _begin; src < _brk;) {
+        Block *b = reinterpret_cast<Block *>(src);
+        size_t size = b->size();
+        if (b->used()) {
+            if (dst != src) {
+                std::memmove(dst, src, size);
+                b = reinterpret_cast<Block *>(dst);
+                *b->handle = b->payload();
+            }
+            // Nothing free is left behind the moved block
+            b->tag |= PREV_USED;
+            dst += size;
+        }
+        src += size;
+    }
+
+    _brk = dst;
+    std::fill(_free, _free + BINS, nullptr);
+    std::fill(_bins, _bins + BINS / 64, 0);
+    _free_bytes = 0;
+}
+
+// See Simple.h
+std::string Simple::dump() const {
+    std::stringstream out;
+    for (char *p = _begin; p < _brk;) {
+        Block *b = reinterpret_cast<Block *>(p);
+        out << (p - _begin) << " " << b->size() << " " << (b->used() ? "used" : "free") << "\n";
+        p += b->size();
+    }
+    out << (_brk - _begin) << " " << (reinterpret_cast<char *>(_handles) - _brk) << " unused\n";
+
+    size_t free_handles = 0;
+    for (void **h = _free_handles; h != nullptr; h = static_cast<void **>(*h)) {
+        free_handles++;
+    }
+    out << "handles " << (_handles_end - _handles) << " free " << free_handles << "\n";
+    return out.str();
+}
+
+// See Simple.h
+size_t Simple::largest_free() const {
+    size_t result = reinterpret_cast<char *>(_handles) - _brk;
+    for (size_t word = BINS / 64; word-- > 0;) {
+        if (_bins[word] != 0) {
+            for (Block *b = _free[word * 64 + Log2(_bins[word])]; b != nullptr; b = b->next) {
+                result = std::max(result, b->size());
+            }
+            break;
+        }
+    }
+    return result;
+}
+
+Simple::Block *Simple::FindFree(size_t size) const {
+    // Size is rounded up to the next list boundary, so that any block from that list on fits
+    size_t bin = Bin(size + (size_t(1) << (Log2(size) - SUB_BITS)) - 1);
+    for (size_t word = bin / 64; word < BINS / 64; word++) {
+        uint64_t mask = _bins[word];
+        if (word == bin / 64) {
+            mask &= ~uint64_t(0) << (bin % 64);
+        }
+        if (mask != 0) {
+            return _free[word * 64 + __builtin_ctzll(mask)];
+        }
+    }
+
+    // Only the list of the size itself is left, some of its blocks could be big enough. Failed
+    // allocation must not walk all of them though
+    Block *b = _free[Bin(size)];
+    for (size_t i = 0; b != nullptr && i < SCAN_LIMIT; b = b->next, i++) {
+        if (b->size() >= size) {
+            return b;
+        }
+    }
+    return nullptr;
+}
+
+Simple::Block *Simple::Reserve(size_t size) {
+    Block *b = FindFree(size);
+    if (b != nullptr) {
+        Unlink(b);
+        b->tag |= USED;
+        b->following()->tag |= PREV_USED;
+        _used += b->size();
+        Shrink(b, size);
+        return b;
+    }
+
+    if (reinterpret_cast<char *>(_handles) - _brk < ptrdiff_t(size)) {
+        return nullptr;
+    }
+
+    // Block before never used space is always in use
+    b = reinterpret_cast<Block *>(_brk);
+    b->tag = size | USED | PREV_USED;
+    _brk += size;
+    _used += size;
+    return b;
+}
+
+void Simple::Release(Block *b) {
+    _used -= b->size();
+    size_t size = b->size();
+
+    Block *next = b->following();
+    if (reinterpret_cast<char *>(next) < _brk && !next->used()) {
+        Unlink(next);
+        size += next->size();
+    }
+    if ((b->tag & PREV_USED) == 0) {
+        size_t prev_size = *(reinterpret_cast<size_t *>(b) - 1);
+        b = reinterpret_cast<Block *>(reinterpret_cast<char *>(b) - prev_size);
+        Unlink(b);
+        size += prev_size;
+    }
+
+    // Free space at the end goes back to never used one, so the last block is always in use
+    if (reinterpret_cast<char *>(b) + size == _brk) {
+        _brk = reinterpret_cast<char *>(b);
+        return;
+    }
+
+    b->tag = size | PREV_USED;
+    b->footer() = size;
+    b->following()->tag &= ~PREV_USED;
+    Link(b);
+}
+
+void Simple::Shrink(Block *b, size_t size) {
+    if (b->size() - size < MIN_BLOCK) {
+        return;
+    }
+
+    Block *rest = reinterpret_cast<Block *>(reinterpret_cast<char *>(b) + size);
+    rest->tag = (b->size() - size) | USED | PREV_USED;
+    b->tag = size | (b->tag & FLAGS);
+    Release(rest);
+}
+
+void Simple::Link(Block *b) {
+    size_t bin = Bin(b->size());
+    b->next = _free[bin];
+    b->prev() = nullptr;
+    if (_free[bin] != nullptr) {
+        _free[bin]->prev() = b;
+    }
+    _free[bin] = b;
+    _bins[bin / 64] |= uint64_t(1) << (bin % 64);
+    _free_bytes += b->size();
+}
+
+void Simple::Unlink(Block *b) {
+    size_t bin = Bin(b->size());
+    if (b->prev() != nullptr) {
+        b->prev()->next = b->next;
+    } else {
+        _free[bin] = b->next;
+    }
+    if (b->next != nullptr) {
+        b->next->prev() = b->prev();
+    }
+    if (_free[bin] == nullptr) {
+        _bins[bin / 64] &= ~(uint64_t(1) << (bin % 64));
+    }
+    _free_bytes -= b->size();
+}
+
+void **Simple::TakeHandle() {
+    if (_free_handles != nullptr) {
+        void **handle = _free_handles;
+        _free_handles = static_cast<void **>(*handle);
+        return handle;
+    }
+
+    if (reinterpret_cast<char *>(_handles) - _brk < ptrdiff_t(sizeof(void *))) {
+        throw AllocError(AllocErrorType::NoMemory, "No space for the handle");
+    }
+    return --_handles;
+}
+
+void Simple::ReleaseHandle(void **handle) {
+    *handle = _free_handles;
+    _free_handles = handle;
+}
 
 } // namespace Allocator
 } // namespace Afina
@@ -0,0 +1,453 @@
+#include <afina/allocator/Slab.h>
+
+#include <algorithm>
+#include <new>
+
+#include <sys/mman.h>
+
+namespace Afina {
+namespace Allocator {
+
+namespace {
+
+constexpr size_t ALIGN = 8;
+
+size_t AlignUp(size_t n, size_t align) { return (n + align - 1) & ~(align - 1); }
+
+// Mappings are made of system pages
+constexpr size_t SYSTEM_PAGE = 4096;
+
+// Class of the separately mapped block
+constexpr uint32_t HUGE = UINT32_MAX;
+
+// Counters are changed by the owner thread only, so there is no need in atomic read-modify-write
+void Increment(std::atomic<size_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+}
+
+void Decrement(std::atomic<size_t> &counter) {
+    counter.store(counter.load(std::memory_order_relaxed) - 1, std::memory_order_relaxed);
+}
+
+} // namespace
+
+/**
+ * Header at the beginning of each page and of each separately mapped block
+ */
+struct Slab::Page {
+    // Size class page belongs to, HUGE for the separately mapped block
+    uint32_t cls;
+
+    // Chunks in use
+    uint32_t used;
+
+    // Whether page is in the list of the class pages with free chunks
+    bool partial;
+
+    // Whether memory of the free page was given back to the system
+    bool released;
+
+    // Length of the separately mapped block
+    size_t length;
+
+    // Chain of freed chunks, each one keeps address of the next
+    void *free;
+
+    // Chunks from here to the end of the page were never allocated
+    char *fresh;
+
+    // Links in the list of the class pages with free chunks or in the list of free pages
+    Page *next;
+    Page *prev;
+
+    // Cache of the thread page belongs to
+    Cache *owner;
+
+    char *end() { return reinterpret_cast<char *>(this) + PAGE_SIZE; }
+
+    void LinkTo(Page *&head) {
+        next = head;
+        prev = nullptr;
+        if (head != nullptr) {
+            head->prev = this;
+        }
+        head = this;
+        partial = true;
+    }
+
+    void UnlinkFrom(Page *&head) {
+        if (prev != nullptr) {
+            prev->next = next;
+        } else {
+            head = next;
+        }
+        if (next != nullptr) {
+            next->prev = prev;
+        }
+        partial = false;
+    }
+
+    static Page *Of(void *p) {
+        return reinterpret_cast<Page *>(reinterpret_cast<uintptr_t>(p) & ~(uintptr_t(PAGE_SIZE) - 1));
+    }
+};
+
+/**
+ * Pages and counters of a single thread. Everything but the remote frees is touched by the owner only,
+ * counters are read by stats as well
+ */
+struct Slab::Cache {
+    // Pages with free chunks of each class
+    Page *partial[MAX_CLASSES];
+
+    std::atomic<size_t> pages[MAX_CLASSES];
+    std::atomic<size_t> used[MAX_CLASSES];
+
+    // Whether some thread owns the cache now
+    std::atomic<bool> in_use;
+    Cache *next;
+
+    // Remote frees are pushed by the other threads, keep them away from the owner state
+    char padding[64];
+
+    // Chunks freed by the other threads, each keeps address of the next
+    std::atomic<void *> remote;
+};
+
+constexpr size_t Slab::PAGE_SIZE;
+constexpr size_t Slab::ARENA_SIZE;
+constexpr size_t Slab::HEADER;
+constexpr size_t Slab::HUGE_PAGE_SIZE;
+constexpr size_t Slab::MIN_CHUNK;
+constexpr size_t Slab::MAX_CHUNK;
+constexpr size_t Slab::MAX_CLASSES;
+
+Slab::Slab(size_t limit, bool huge_pages)
+    : _caches(nullptr), _free_pages(nullptr), _fresh(nullptr), _end(nullptr), _limit(limit), _huge_pages(huge_pages),
+      _hugetlb_bytes(0), _thp_bytes(0), _mapped(0), _released(0), _retained(0), _huge(0), _huge_bytes(0) {
+    static_assert(sizeof(Page) <= HEADER, "page header must fit");
+    static_assert(MAX_CHUNK % ALIGN == 0, "chunks must stay aligned");
+    static_assert(ARENA_SIZE % HUGE_PAGE_SIZE == 0 && HUGE_PAGE_SIZE % PAGE_SIZE == 0,
+                  "arena must be made of whole huge pages");
+
+    _n_classes = 0;
+    for (size_t size = MIN_CHUNK; size < MAX_CHUNK; size = std::max(AlignUp(size * 5 / 4, ALIGN), size + ALIGN)) {
+        _sizes[_n_classes++] = size;
+    }
+    _sizes[_n_classes++] = MAX_CHUNK;
+
+    pthread_key_create(&_local, Leave);
+}
+
+Slab::~Slab() {
+    // Once key is deleted Leave won't be called for the threads still holding caches
+    pthread_key_delete(_local);
+
+    Cache *cache = _caches.load(std::memory_order_acquire);
+    while (cache != nullptr) {
+        Cache *next = cache->next;
+        delete cache;
+        cache = next;
+    }
+
+    for (char *arena : _arenas) {
+        munmap(arena, ARENA_SIZE);
+    }
+}
+
+// See Slab.h
+void *Slab::alloc(size_t size) {
+    if (size > MAX_CHUNK) {
+        return AllocHuge(size);
+    }
+
+    size_t cls = ClassOf(size);
+    Cache *cache = Local();
+
+    Page *page = cache->partial[cls];
+    if (page == nullptr) {
+        // Chunks other threads freed could be enough to go without a new page
+        Collect(cache);
+        page = cache->partial[cls];
+    }
+    if (page == nullptr) {
+        page = TakePage();
+        page->cls = cls;
+        page->used = 0;
+        page->free = nullptr;
+        page->fresh = reinterpret_cast<char *>(page) + HEADER;
+        page->owner = cache;
+        page->LinkTo(cache->partial[cls]);
+        Increment(cache->pages[cls]);
+    }
+
+    void *chunk;
+    if (page->free != nullptr) {
+        chunk = page->free;
+        page->free = *static_cast<void **>(chunk);
+    } else {
+        chunk = page->fresh;
+        page->fresh += _sizes[cls];
+    }
+    page->used++;
+    Increment(cache->used[cls]);
+
+    if (page->free == nullptr && page->fresh + _sizes[cls] > page->end()) {
+        page->UnlinkFrom(cache->partial[cls]);
+    }
+    return chunk;
+}
+
+// See Slab.h
+void Slab::free(void *p) {
+    if (p == nullptr) {
+        return;
+    }
+
+    Page *page = Page::Of(p);
+    if (page->cls == HUGE) {
+        FreeHuge(page);
+        return;
+    }
+
+    // Thread that never allocated has no cache and owns no pages
+    Cache *cache = static_cast<Cache *>(pthread_getspecific(_local));
+    if (page->owner == cache) {
+        FreeLocal(cache, page, p);
+        return;
+    }
+
+    // Page stays with the owner until the chunk is collected, so the owner couldn't change meanwhile
+    Cache *owner = page->owner;
+    void *head = owner->remote.load(std::memory_order_relaxed);
+    do {
+        *static_cast<void **>(p) = head;
+    } while (!owner->remote.compare_exchange_weak(head, p, std::memory_order_release, std::memory_order_relaxed));
+}
+
+// See Slab.h
+size_t Slab::chunk_size(size_t size) const {
+    if (size > MAX_CHUNK) {
+        return AlignUp(HEADER + size, SYSTEM_PAGE);
+    }
+    return _sizes[ClassOf(size)];
+}
+
+// See Slab.h
+Slab::ClassStats Slab::stats(size_t cls) const {
+    ClassStats result = {};
+    result.chunk_size = _sizes[cls];
+    for (Cache *cache = _caches.load(std::memory_order_acquire); cache != nullptr; cache = cache->next) {
+        result.pages += cache->pages[cls].load(std::memory_order_relaxed);
+        result.used += cache->used[cls].load(std::memory_order_relaxed);
+    }
+
+    // Counters are read while owners change them, so they could be a bit out of sync
+    size_t total = result.pages * ((PAGE_SIZE - HEADER) / _sizes[cls]);
+    result.free = total > result.used ? total - result.used : 0;
+    return result;
+}
+
+// See Slab.h
+size_t Slab::unused() const {
+    size_t result = _retained.load(std::memory_order_relaxed);
+    for (size_t cls = 0; cls < _n_classes; cls++) {
+        ClassStats s = stats(cls);
+        result += s.free * s.chunk_size;
+    }
+    return result;
+}
+
+size_t Slab::ClassOf(size_t size) const {
+    size_t lo = 0, hi = _n_classes - 1;
+    while (lo < hi) {
+        size_t mid = (lo + hi) / 2;
+        if (_sizes[mid] < size) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
+        }
+    }
+    return lo;
+}
+
+Slab::Cache *Slab::Local() {
+    Cache *result = static_cast<Cache *>(pthread_getspecific(_local));
+    if (result != nullptr) {
+        return result;
+    }
+
+    // Take cache left by some exited thread or add a new one
+    for (Cache *c = _caches.load(std::memory_order_acquire); c != nullptr; c = c->next) {
+        bool expected = false;
+        if (!c->in_use.load(std::memory_order_relaxed) &&
+            c->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            result = c;
+            break;
+        }
+    }
+
+    if (result == nullptr) {
+        result = new Cache();
+        for (size_t cls = 0; cls < MAX_CLASSES; cls++) {
+            result->partial[cls] = nullptr;
+            result->pages[cls].store(0, std::memory_order_relaxed);
+            result->used[cls].store(0, std::memory_order_relaxed);
+        }
+        result->in_use.store(true, std::memory_order_relaxed);
+        result->remote.store(nullptr, std::memory_order_relaxed);
+        result->next = _caches.load(std::memory_order_relaxed);
+        while (!_caches.compare_exchange_weak(result->next, result, std::memory_order_release,
+                                              std::memory_order_relaxed)) {
+        }
+    }
+
+    pthread_setspecific(_local, result);
+    return result;
+}
+
+void Slab::Leave(void *cache) { static_cast<Cache *>(cache)->in_use.store(false, std::memory_order_release); }
+
+void Slab::FreeLocal(Cache *cache, Page *page, void *p) {
+    *static_cast<void **>(p) = page->free;
+    page->free = p;
+    page->used--;
+    Decrement(cache->used[page->cls]);
+
+    Page *&partial = cache->partial[page->cls];
+    if (!page->partial) {
+        page->LinkTo(partial);
+    }
+
+    // Cache keeps one page with free chunks anyway, so that single chunk allocated and freed over and over
+    // doesn't take and give the page each time
+    if (page->used == 0 && (partial != page || page->next != nullptr)) {
+        page->UnlinkFrom(partial);
+        Decrement(cache->pages[page->cls]);
+        GivePage(page);
+    }
+}
+
+void Slab::Collect(Cache *cache) {
+    void *chunk = cache->remote.exchange(nullptr, std::memory_order_acquire);
+    while (chunk != nullptr) {
+        void *next = *static_cast<void **>(chunk);
+        FreeLocal(cache, Page::Of(chunk), chunk);
+        chunk = next;
+    }
+}
+
+Slab::Page *Slab::TakePage() {
+    std::lock_guard<std::mutex> lock(_lock);
+    if (_free_pages != nullptr) {
+        Page *page = _free_pages;
+        _free_pages = page->next;
+        if (page->released) {
+            _released.fetch_sub(PAGE_SIZE - SYSTEM_PAGE, std::memory_order_relaxed);
+        } else {
+            _retained.fetch_sub(PAGE_SIZE, std::memory_order_relaxed);
+        }
+        return page;
+    }
+
+    if (_fresh == _end) {
+        _arenas.reserve(_arenas.size() + 1);
+        _fresh = static_cast<char *>(Map(ARENA_SIZE, true));
+        _end = _fresh + ARENA_SIZE;
+        _arenas.push_back(_fresh);
+    }
+
+    Page *page = reinterpret_cast<Page *>(_fresh);
+    _fresh += PAGE_SIZE;
+    return page;
+}
+
+void Slab::GivePage(Page *page) {
+    page->owner = nullptr;
+
+    // Page goes back to the system but the header, which keeps the list of free pages. Explicit huge pages
+    // can't be released in part, those stay resident
+    char *body = reinterpret_cast<char *>(page) + SYSTEM_PAGE;
+    page->released = madvise(body, PAGE_SIZE - SYSTEM_PAGE, MADV_DONTNEED) == 0;
+    if (page->released) {
+        _released.fetch_add(PAGE_SIZE - SYSTEM_PAGE, std::memory_order_relaxed);
+    } else {
+        _retained.fetch_add(PAGE_SIZE, std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(_lock);
+    page->next = _free_pages;
+    _free_pages = page;
+}
+
+void *Slab::AllocHuge(size_t size) {
+    size_t length = chunk_size(size);
+    Page *page = static_cast<Page *>(Map(length, false));
+    page->cls = HUGE;
+    page->length = length;
+
+    _huge.fetch_add(1, std::memory_order_relaxed);
+    _huge_bytes.fetch_add(length, std::memory_order_relaxed);
+    return reinterpret_cast<char *>(page) + HEADER;
+}
+
+void Slab::FreeHuge(Page *page) {
+    size_t length = page->length;
+    _mapped.fetch_sub(length, std::memory_order_relaxed);
+    _huge.fetch_sub(1, std::memory_order_relaxed);
+    _huge_bytes.fetch_sub(length, std::memory_order_relaxed);
+    munmap(page, length);
+}
+
+void *Slab::Map(size_t length, bool arena) {
+    // Concurrent huge blocks could take allocator a bit over the limit, that is the price of not taking a lock
+    size_t limit = _limit.load(std::memory_order_relaxed);
+    if (limit != 0 && _mapped.load(std::memory_order_relaxed) + length > limit) {
+        throw std::bad_alloc();
+    }
+
+    bool huge_pages = _huge_pages.load(std::memory_order_relaxed);
+#ifdef MAP_HUGETLB
+    // Explicit huge pages come from the pool system administrator reserves, mapping fails once it is empty.
+    // Such mapping is aligned to the huge page already
+    if (huge_pages && arena) {
+        void *p = mmap(nullptr, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+        if (p != MAP_FAILED) {
+            _hugetlb_bytes.fetch_add(length, std::memory_order_relaxed);
+            _mapped.fetch_add(length, std::memory_order_relaxed);
+            return p;
+        }
+    }
+#endif
+
+    // System aligns mappings to its own pages only, so one more alignment unit is mapped and the excess is
+    // cut off from both sides. Transparent huge pages back aligned regions only
+    size_t align = huge_pages && length >= HUGE_PAGE_SIZE ? HUGE_PAGE_SIZE : PAGE_SIZE;
+    size_t mapped = length + align;
+    void *p = mmap(nullptr, mapped, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    char *begin = static_cast<char *>(p);
+    char *aligned = reinterpret_cast<char *>(AlignUp(reinterpret_cast<uintptr_t>(begin), align));
+    if (aligned != begin) {
+        munmap(begin, aligned - begin);
+    }
+    if (begin + mapped != aligned + length) {
+        munmap(aligned + length, begin + mapped - aligned - length);
+    }
+
+#ifdef MADV_HUGEPAGE
+    // Advice fails if kernel has no transparent huge pages, memory stays on the regular ones then
+    if (align == HUGE_PAGE_SIZE && madvise(aligned, length, MADV_HUGEPAGE) == 0 && arena) {
+        _thp_bytes.fetch_add(length, std::memory_order_relaxed);
+    }
+#endif
+
+    _mapped.fetch_add(length, std::memory_order_relaxed);
+    return aligned;
+}
+
+} // namespace Allocator
+} // namespace Afina
@@ -0,0 +1,25 @@
+#include <afina/allocator/StlAllocator.h>
+
+#include <atomic>
+
+namespace Afina {
+namespace Allocator {
+
+namespace {
+
+std::atomic<Slab *> &Default() {
+    // Never destroyed: memory could be freed by the static objects of the process
+    static std::atomic<Slab *> *arena = new std::atomic<Slab *>(new Slab());
+    return *arena;
+}
+
+} // namespace
+
+// See StlAllocator.h
+Slab *DefaultArena() { return Default().load(std::memory_order_acquire); }
+
+// See StlAllocator.h
+void SetDefaultArena(Slab *arena) { Default().store(arena, std::memory_order_release); }
+
+} // namespace Allocator
+} // namespace Afina
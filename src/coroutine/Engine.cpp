@@ -1,12 +1,197 @@
 #include <afina/coroutine/Engine.h>
 
+#include <errno.h>
+#include <new>
 #include <setjmp.h>
+#include <stdint.h>
 #include <stdio.h>
 #include <string.h>
+#include <sys/epoll.h>
+#include <sys/timerfd.h>
+#include <time.h>
+#include <unistd.h>
+
+#if defined(__x86_64__) || defined(__aarch64__)
+#define AFINA_COROUTINE_SWITCH 1
+#else
+#include <ucontext.h>
+#endif
+
+#ifdef AFINA_COROUTINE_SWITCH
+/**
+ * Saves callee-saved registers on the current stack, stores stack pointer into *from and loads the
+ * registers from the stack pointed by to. Everything else is either saved by the caller or not
+ * preserved across calls by the ABI
+ */
+extern "C" void afina_coroutine_switch(void **from, void *to);
+
+/**
+ * Where the first switch to the new stack returns to: calls entry(arg) kept in callee-saved registers
+ */
+extern "C" void afina_coroutine_trampoline();
+
+#if defined(__x86_64__)
+asm(R"(
+	.text
+	.globl afina_coroutine_switch
+	.hidden afina_coroutine_switch
+	.type afina_coroutine_switch, @function
+afina_coroutine_switch:
+	pushq %rbp
+	pushq %rbx
+	pushq %r12
+	pushq %r13
+	pushq %r14
+	pushq %r15
+	subq $8, %rsp
+	stmxcsr (%rsp)
+	fnstcw 4(%rsp)
+	movq %rsp, (%rdi)
+	movq %rsi, %rsp
+	ldmxcsr (%rsp)
+	fldcw 4(%rsp)
+	addq $8, %rsp
+	popq %r15
+	popq %r14
+	popq %r13
+	popq %r12
+	popq %rbx
+	popq %rbp
+	ret
+	.size afina_coroutine_switch, .-afina_coroutine_switch
+
+	.globl afina_coroutine_trampoline
+	.hidden afina_coroutine_trampoline
+	.type afina_coroutine_trampoline, @function
+afina_coroutine_trampoline:
+	movq %r12, %rdi
+	callq *%r13
+	ud2
+	.size afina_coroutine_trampoline, .-afina_coroutine_trampoline
+)");
+#else
+asm(R"(
+	.text
+	.globl afina_coroutine_switch
+	.hidden afina_coroutine_switch
+	.type afina_coroutine_switch, %function
+afina_coroutine_switch:
+	sub sp, sp, #160
+	stp x19, x20, [sp, #0]
+	stp x21, x22, [sp, #16]
+	stp x23, x24, [sp, #32]
+	stp x25, x26, [sp, #48]
+	stp x27, x28, [sp, #64]
+	stp x29, x30, [sp, #80]
+	stp d8, d9, [sp, #96]
+	stp d10, d11, [sp, #112]
+	stp d12, d13, [sp, #128]
+	stp d14, d15, [sp, #144]
+	mov x2, sp
+	str x2, [x0]
+	mov sp, x1
+	ldp x19, x20, [sp, #0]
+	ldp x21, x22, [sp, #16]
+	ldp x23, x24, [sp, #32]
+	ldp x25, x26, [sp, #48]
+	ldp x27, x28, [sp, #64]
+	ldp x29, x30, [sp, #80]
+	ldp d8, d9, [sp, #96]
+	ldp d10, d11, [sp, #112]
+	ldp d12, d13, [sp, #128]
+	ldp d14, d15, [sp, #144]
+	add sp, sp, #160
+	ret
+	.size afina_coroutine_switch, .-afina_coroutine_switch
+
+	.globl afina_coroutine_trampoline
+	.hidden afina_coroutine_trampoline
+	.type afina_coroutine_trampoline, %function
+afina_coroutine_trampoline:
+	mov x0, x19
+	blr x20
+	brk #0
+	.size afina_coroutine_trampoline, .-afina_coroutine_trampoline
+)");
+#endif
+#endif // AFINA_COROUTINE_SWITCH
 
 namespace Afina {
 namespace Coroutine {
 
+namespace {
+
+/**
+ * Lays out stack [low, high) the way the switch leaves it, so that switching to the returned stack pointer
+ * calls entry(arg)
+ */
+void *MakeStack(char *low, char *high, void (*entry)(void *), void *arg) {
+	uintptr_t top = reinterpret_cast<uintptr_t>(high) & ~uintptr_t(15);
+
+#if defined(__x86_64__)
+	// mxcsr and x87 control word at their defaults, r15, r14, r13, r12, rbx, rbp, return address. Trampoline
+	// starts with the stack aligned the way call expects
+	(void)low;
+	void **frame = reinterpret_cast<void **>(top) - 8;
+	memset(frame, 0, 8 * sizeof(void *));
+	uint32_t csr[2] = {0x1F80, 0x037F};
+	memcpy(&frame[0], csr, sizeof(csr));
+	frame[3] = reinterpret_cast<void *>(entry);
+	frame[4] = arg;
+	frame[7] = reinterpret_cast<void *>(&afina_coroutine_trampoline);
+	return frame;
+#elif defined(__aarch64__)
+	// x19-x30 then d8-d15, switch returns to x30
+	(void)low;
+	void **frame = reinterpret_cast<void **>(top) - 20;
+	memset(frame, 0, 20 * sizeof(void *));
+	frame[0] = arg;
+	frame[1] = reinterpret_cast<void *>(entry);
+	frame[11] = reinterpret_cast<void *>(&afina_coroutine_trampoline);
+	return frame;
+#else
+	// ucontext lives on the top of the stack it describes, makecontext passes int arguments only
+	ucontext_t *uc = reinterpret_cast<ucontext_t *>((top - sizeof(ucontext_t)) & ~uintptr_t(15));
+	getcontext(uc);
+	uc->uc_stack.ss_sp = low;
+	uc->uc_stack.ss_size = reinterpret_cast<char *>(uc) - low;
+	uc->uc_link = nullptr;
+
+	struct Start {
+		static void Run(unsigned entry_hi, unsigned entry_lo, unsigned arg_hi, unsigned arg_lo) {
+			uintptr_t e = (uintptr_t(entry_hi) << 16 << 16) | entry_lo;
+			uintptr_t a = (uintptr_t(arg_hi) << 16 << 16) | arg_lo;
+			reinterpret_cast<void (*)(void *)>(e)(reinterpret_cast<void *>(a));
+		}
+	};
+	uintptr_t e = reinterpret_cast<uintptr_t>(entry);
+	uintptr_t a = reinterpret_cast<uintptr_t>(arg);
+	makecontext(uc, reinterpret_cast<void (*)()>(&Start::Run), 4, unsigned(e >> 16 >> 16), unsigned(e),
+	            unsigned(a >> 16 >> 16), unsigned(a));
+	return uc;
+#endif
+}
+
+/**
+ * Suspends the running stack, saving where it stopped into *from, and resumes the one to points at
+ */
+inline void SwapStacks(void **from, void *to) {
+#ifdef AFINA_COROUTINE_SWITCH
+	afina_coroutine_switch(from, to);
+#else
+	swapcontext(static_cast<ucontext_t *>(*from), static_cast<ucontext_t *>(to));
+#endif
+}
+
+// CLOCK_MONOTONIC time in nanoseconds, the one timerfd is set in
+uint64_t Now() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return uint64_t(ts.tv_sec) * 1000000000 + ts.tv_nsec;
+}
+
+} // namespace
+
 void Engine::Store(context &ctx) {
 	char stack_pos;
 	char *top = &stack_pos;
@@ -16,7 +201,7 @@ void Engine::Store(context &ctx) {
 	size_t size = ctx.High - ctx.Low;
 
 	if (size > std::get<1>(ctx.Stack)) {
-		delete std::get<0>(ctx.Stack);
+		delete[] std::get<0>(ctx.Stack);
 		std::get<0>(ctx.Stack) = new char[size];
 		std::get<1>(ctx.Stack) = size;
 	}
@@ -50,6 +235,16 @@ void Engine::yield() {
 void Engine::sched(void *routine_) {
 	context *ctx = (context*) routine_;
 
+	if (mode == Mode::Dedicated) {
+		if (ctx == nullptr) {
+			yield();
+		} else if (ctx != cur_routine) {
+			unblock(ctx);
+			Switch(*ctx);
+		}
+		return;
+	}
+
 	if (cur_routine != nullptr) {
 		if (setjmp(cur_routine->Environment) > 0) {
 			return;
@@ -61,5 +256,333 @@ void Engine::sched(void *routine_) {
 	Restore(*cur_routine);
 }
 
+// See Engine.h
+Engine::context *Engine::Spawn() {
+	char *low = pool.Get();
+	uintptr_t top = reinterpret_cast<uintptr_t>(low + pool.stack_size()) - sizeof(context);
+	context *ctx = new (reinterpret_cast<void *>(top & ~uintptr_t(63))) context();
+
+	// Stack of the routine ends where its context starts
+	ctx->Low = low;
+	ctx->High = reinterpret_cast<char *>(ctx);
+	ctx->SP = MakeStack(ctx->Low, ctx->High, &Engine::Entry, this);
+	return ctx;
+}
+
+// See Engine.h
+void Engine::Recycle(context *ctx) {
+	char *low = ctx->Low;
+	ctx->~context();
+	pool.Put(low);
+}
+
+// See Engine.h
+void Engine::Switch(context &ctx) {
+	// Idle context is the stack start() has been called on
+	context *from = cur_routine != nullptr ? cur_routine : idle_ctx;
+	cur_routine = &ctx != idle_ctx ? &ctx : nullptr;
+	SwapStacks(&from->SP, ctx.SP);
+}
+
+// See Engine.h
+void Engine::Entry(void *engine_) {
+	Engine *engine = static_cast<Engine *>(engine_);
+	context *pc = engine->cur_routine;
+	pc->Body();
+
+	// Routine is still on its stack, so loop frees it once got control back
+	Unlink(engine->alive, pc);
+	engine->finished = pc;
+	engine->cur_routine = nullptr;
+	SwapStacks(&pc->SP, engine->idle_ctx->SP);
+}
+
+// See Engine.h
+void Engine::Loop() {
+#ifndef AFINA_COROUTINE_SWITCH
+	ucontext_t idle;
+	idle_ctx->SP = &idle;
+#endif
+
+	while (alive != nullptr || blocked != nullptr) {
+		if (alive == nullptr) {
+			if (io_waiting == 0 && sleepers.empty()) {
+				// Nothing could wake up the routines left
+				break;
+			}
+			Poll();
+			continue;
+		}
+
+		sched(alive);
+
+		if (finished != nullptr) {
+			Recycle(finished);
+			finished = nullptr;
+		}
+	}
+
+	while (blocked != nullptr) {
+		context *ctx = blocked;
+		Unlink(blocked, ctx);
+		Recycle(ctx);
+	}
+
+	if (epoll_fd != -1) {
+		close(epoll_fd);
+		close(timer_fd);
+		epoll_fd = timer_fd = -1;
+	}
+	io_waiting = 0;
+	sleepers.clear();
+}
+
+// See Engine.h
+void Engine::Link(context *&list, context *ctx) {
+	ctx->prev = nullptr;
+	ctx->next = list;
+	if (list != nullptr) {
+		list->prev = ctx;
+	}
+	list = ctx;
+}
+
+// See Engine.h
+void Engine::Unlink(context *&list, context *ctx) {
+	if (ctx->prev != nullptr) {
+		ctx->prev->next = ctx->next;
+	}
+
+	if (ctx->next != nullptr) {
+		ctx->next->prev = ctx->prev;
+	}
+
+	if (list == ctx) {
+		list = ctx->next;
+	}
+	ctx->prev = ctx->next = nullptr;
+}
+
+// See Engine.h
+void Engine::block(void *routine) {
+	if (mode != Mode::Dedicated) {
+		throw std::logic_error("Routines could be blocked in the Dedicated mode only");
+	}
+
+	context *ctx = routine != nullptr ? static_cast<context *>(routine) : cur_routine;
+	if (ctx == nullptr || ctx->Blocked) {
+		return;
+	}
+
+	Unlink(alive, ctx);
+	Link(blocked, ctx);
+	ctx->Blocked = true;
+
+	if (ctx == cur_routine) {
+		Switch(alive != nullptr ? *alive : *idle_ctx);
+	}
+}
+
+// See Engine.h
+void Engine::unblock(void *routine) {
+	context *ctx = static_cast<context *>(routine);
+	if (ctx == nullptr || !ctx->Blocked) {
+		return;
+	}
+
+	Cancel(ctx);
+	Unlink(blocked, ctx);
+	Link(alive, ctx);
+	ctx->Blocked = false;
+}
+
+// See Engine.h
+void Engine::Cancel(context *ctx) {
+	if (ctx->WaitFd != -1) {
+		// Routine may have closed descriptor already, epoll drops it along then
+		epoll_ctl(epoll_fd, EPOLL_CTL_DEL, ctx->WaitFd, nullptr);
+		ctx->WaitFd = -1;
+		io_waiting--;
+	}
+
+	if (ctx->Sleeping) {
+		bool earliest = ctx->Sleep == sleepers.begin();
+		sleepers.erase(ctx->Sleep);
+		ctx->Sleeping = false;
+		if (earliest) {
+			Arm();
+		}
+	}
+}
+
+// See Engine.h
+void Engine::Reactor() {
+	if (epoll_fd != -1) {
+		return;
+	}
+
+	epoll_fd = epoll_create1(EPOLL_CLOEXEC);
+	if (epoll_fd == -1) {
+		throw std::runtime_error("Engine failed to create epoll");
+	}
+
+	timer_fd = timerfd_create(CLOCK_MONOTONIC, TFD_NONBLOCK | TFD_CLOEXEC);
+	if (timer_fd == -1) {
+		close(epoll_fd);
+		epoll_fd = -1;
+		throw std::runtime_error("Engine failed to create timerfd");
+	}
+
+	// Timer has nullptr as identifier, descriptors have the routines waiting for them
+	struct epoll_event event;
+	event.events = EPOLLIN;
+	event.data.ptr = nullptr;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_ADD, timer_fd, &event) == -1) {
+		close(epoll_fd);
+		close(timer_fd);
+		epoll_fd = timer_fd = -1;
+		throw std::runtime_error("Engine failed to assign timerfd to epoll");
+	}
+}
+
+// See Engine.h
+void Engine::Arm() {
+	struct itimerspec spec;
+	memset(&spec, 0, sizeof(spec));
+	if (!sleepers.empty()) {
+		// Monotonic time is never zero, which would disarm the timer
+		uint64_t at = sleepers.begin()->first;
+		spec.it_value.tv_sec = at / 1000000000;
+		spec.it_value.tv_nsec = at % 1000000000;
+	}
+	timerfd_settime(timer_fd, TFD_TIMER_ABSTIME, &spec, nullptr);
+}
+
+// See Engine.h
+bool Engine::Await(int fd, uint32_t events) {
+	if (mode != Mode::Dedicated || cur_routine == nullptr) {
+		errno = EAGAIN;
+		return false;
+	}
+	Reactor();
+
+	// One shot: once reported, descriptor stays in epoll disarmed until the next wait
+	struct epoll_event event;
+	event.events = events | EPOLLONESHOT;
+	event.data.ptr = cur_routine;
+	if (epoll_ctl(epoll_fd, EPOLL_CTL_MOD, fd, &event) == -1) {
+		if (errno != ENOENT || epoll_ctl(epoll_fd, EPOLL_CTL_ADD, fd, &event) == -1) {
+			return false;
+		}
+	}
+
+	cur_routine->WaitFd = fd;
+	io_waiting++;
+	block();
+	return true;
+}
+
+// See Engine.h
+void Engine::Poll() {
+	struct epoll_event events[64];
+	int n = epoll_wait(epoll_fd, events, 64, -1);
+	if (n == -1) {
+		if (errno == EINTR) {
+			return;
+		}
+		throw std::runtime_error("Engine failed to do epoll_wait");
+	}
+
+	for (int i = 0; i < n; i++) {
+		if (events[i].data.ptr != nullptr) {
+			// One shot event has fired, descriptor stays in epoll disarmed
+			context *ctx = static_cast<context *>(events[i].data.ptr);
+			ctx->WaitFd = -1;
+			io_waiting--;
+			unblock(ctx);
+			continue;
+		}
+
+		uint64_t expirations;
+		if (::read(timer_fd, &expirations, sizeof(expirations)) < 0 && errno != EAGAIN) {
+			throw std::runtime_error("Engine failed to read timerfd");
+		}
+
+		uint64_t now = Now();
+		while (!sleepers.empty() && sleepers.begin()->first <= now) {
+			context *ctx = sleepers.begin()->second;
+			sleepers.erase(sleepers.begin());
+			ctx->Sleeping = false;
+			unblock(ctx);
+		}
+		Arm();
+	}
+}
+
+// See Engine.h
+ssize_t Engine::read(int fd, void *buf, size_t count) {
+	for (;;) {
+		ssize_t n = ::read(fd, buf, count);
+		if (n >= 0) {
+			return n;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || !Await(fd, EPOLLIN)) {
+			return -1;
+		}
+	}
+}
+
+// See Engine.h
+ssize_t Engine::write(int fd, const void *buf, size_t count) {
+	for (;;) {
+		ssize_t n = ::write(fd, buf, count);
+		if (n >= 0) {
+			return n;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || !Await(fd, EPOLLOUT)) {
+			return -1;
+		}
+	}
+}
+
+// See Engine.h
+int Engine::accept(int fd, struct sockaddr *addr, socklen_t *addrlen) {
+	for (;;) {
+		int client = accept4(fd, addr, addrlen, SOCK_NONBLOCK);
+		if (client >= 0) {
+			return client;
+		}
+		if (errno == EINTR) {
+			continue;
+		}
+		if ((errno != EAGAIN && errno != EWOULDBLOCK) || !Await(fd, EPOLLIN)) {
+			return -1;
+		}
+	}
+}
+
+// See Engine.h
+void Engine::sleep(uint64_t ms) {
+	if (mode != Mode::Dedicated || cur_routine == nullptr) {
+		usleep(ms * 1000);
+		return;
+	}
+	Reactor();
+
+	auto it = sleepers.emplace(Now() + ms * 1000000, cur_routine);
+	cur_routine->Sleep = it;
+	cur_routine->Sleeping = true;
+	if (it == sleepers.begin()) {
+		Arm();
+	}
+	block();
+}
+
 } // namespace Coroutine
 } // namespace Afina
@@ -0,0 +1,67 @@
+#include <afina/coroutine/StackPool.h>
+
+#include <new>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+namespace Afina {
+namespace Coroutine {
+
+// See StackPool.h
+StackPool::StackPool(size_t stack_size, size_t max_free)
+    : _page_size(sysconf(_SC_PAGESIZE)), _max_free(max_free), _mapped(0) {
+    _stack_size = (stack_size + _page_size - 1) / _page_size * _page_size;
+    if (_stack_size == 0) {
+        _stack_size = _page_size;
+    }
+}
+
+// See StackPool.h
+StackPool::~StackPool() {
+    for (char *stack : _free) {
+        Unmap(stack);
+    }
+}
+
+// See StackPool.h
+char *StackPool::Get() {
+    if (!_free.empty()) {
+        char *stack = _free.back();
+        _free.pop_back();
+        return stack;
+    }
+
+    // Whole mapping is inaccessible at first, then everything but the guard page is opened
+    size_t length = _page_size + _stack_size;
+    void *p = mmap(nullptr, length, PROT_NONE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_NORESERVE | MAP_STACK, -1, 0);
+    if (p == MAP_FAILED) {
+        throw std::bad_alloc();
+    }
+
+    char *stack = static_cast<char *>(p) + _page_size;
+    if (mprotect(stack, _stack_size, PROT_READ | PROT_WRITE) != 0) {
+        munmap(p, length);
+        throw std::bad_alloc();
+    }
+
+    _mapped++;
+    return stack;
+}
+
+// See StackPool.h
+void StackPool::Put(char *stack) {
+    if (_free.size() < _max_free) {
+        _free.push_back(stack);
+    } else {
+        Unmap(stack);
+    }
+}
+
+void StackPool::Unmap(char *stack) {
+    munmap(stack - _page_size, _page_size + _stack_size);
+    _mapped--;
+}
+
+} // namespace Coroutine
+} // namespace Afina
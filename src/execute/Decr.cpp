@@ -0,0 +1,27 @@
+#include <afina/Storage.h>
+#include <afina/execute/Decr.h>
+
+#include <iostream>
+
+namespace Afina {
+namespace Execute {
+
+// memcached protocol: "decr" decrements numeric value of existing item in place
+void Decr::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::cout << "Decr(" << _key << ", " << _value << ")" << std::endl;
+    uint64_t result;
+    switch (storage.Decrement(_key, _value, result)) {
+    case Storage::ArithmeticResult::Stored:
+        out = std::to_string(result);
+        break;
+    case Storage::ArithmeticResult::NotFound:
+        out = "NOT_FOUND";
+        break;
+    default:
+        out = "CLIENT_ERROR cannot increment or decrement non-numeric value";
+        break;
+    }
+}
+
+} // namespace Execute
+} // namespace Afina
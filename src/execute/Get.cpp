@@ -12,7 +12,7 @@ namespace Execute {
 
 Each item sent by the server looks like this:
 
-VALUE <key> <flags> <bytes>\r\n
+VALUE <key> <flags> <bytes> [<cas unique>]\r\n
 <data block>\r\n
 
 After all the items have been transmitted, the server sends the string
@@ -22,22 +22,31 @@ to indicate the end of response.
 */
 
 void Get::Execute(Storage &storage, const std::string &args, std::string &out) {
+    Response response;
+    Execute(storage, args, response);
+    out = response.str();
+}
+
+void Get::Execute(Storage &storage, const std::string &args, Response &out) {
     std::stringstream keyStream;
     copy(_keys.begin(), _keys.end(), std::ostream_iterator<std::string>(keyStream, " "));
     std::cout << "Get(" << keyStream.str() << ")" << std::endl;
 
-    std::stringstream outStream;
-
-    std::string value;
+    // Values are passed as is, only headers are formatted
+    Value value;
+    Metadata meta;
     for (auto &key : _keys) {
-        if (!storage.Get(key, value))
+        if (!storage.Get(key, value, meta))
             continue;
-        outStream << "VALUE " << key << " 0 " << value.size() << "\r\n";
-        outStream << value << "\r\n";
+        std::string header = "VALUE " + key + " " + std::to_string(meta.flags) + " " + std::to_string(value.size());
+        if (_with_cas) {
+            header += " " + std::to_string(meta.cas);
+        }
+        out.Append(header + "\r\n");
+        out.Append(value);
+        out.Append("\r\n");
     }
-    outStream << "END"; // networking layer should add the last \r\n
-
-    out = outStream.str();
+    out.Append("END"); // networking layer should add the last \r\n
 }
 
 } // namespace Execute
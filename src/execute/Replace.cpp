@@ -11,13 +11,7 @@ namespace Execute {
 
 void Replace::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Replace(" << _key << "): " << args << std::endl;
-    std::string value;
-    if (storage.Get(_key, value)) {
-        storage.Set(_key, args);
-        out = "STORED";
-    } else {
-        out = "NOT_STORED";
-    }
+    out = storage.Set(_key, args, metadata()) ? "STORED" : "NOT_STORED";
 }
 
 } // namespace Execute
@@ -0,0 +1,59 @@
+#include <afina/execute/Response.h>
+
+#include <memory>
+
+namespace Afina {
+namespace Execute {
+
+// See Response.h
+void Response::Append(const std::string &text) {
+    _text.append(text);
+    _size += text.size();
+}
+
+// See Response.h
+void Response::Append(const Value &value) {
+    if (value.empty()) {
+        return;
+    }
+
+    Flush();
+    _chunks.push_back(value);
+    _size += value.size();
+}
+
+// See Response.h
+const std::vector<Value> &Response::Chunks() {
+    Flush();
+    return _chunks;
+}
+
+// See Response.h
+std::string Response::str() const {
+    std::string result;
+    result.reserve(_size);
+    for (auto &chunk : _chunks) {
+        result.append(chunk.data(), chunk.size());
+    }
+    result.append(_text);
+    return result;
+}
+
+// See Response.h
+void Response::Clear() {
+    _chunks.clear();
+    _text.clear();
+    _size = 0;
+}
+
+void Response::Flush() {
+    if (_text.empty()) {
+        return;
+    }
+
+    _chunks.push_back(Value(std::make_shared<const std::string>(std::move(_text))));
+    _text.clear();
+}
+
+} // namespace Execute
+} // namespace Afina
@@ -13,7 +13,7 @@ namespace Execute {
 void Set::Execute(Storage &storage, const std::string &args, std::string &out) {
     std::cout << "Set(" << _key << "): " << args << std::endl;
     // std::this_thread::sleep_for(std::chrono::milliseconds(5000));
-    storage.Put(_key, args);
+    storage.Put(_key, args, metadata());
     out = "STORED";
 }
 
@@ -1,6 +1,9 @@
 #include <afina/Storage.h>
+#include <afina/allocator/StlAllocator.h>
 #include <afina/execute/Stats.h>
 
+#include "storage/MemoryLimit.h"
+
 #include <iostream>
 #include <iterator>
 #include <sstream>
@@ -8,7 +11,48 @@
 namespace Afina {
 namespace Execute {
 
-void Stats::Execute(Storage &storage, const std::string &args, std::string &out) { out.assign("END"); }
+// memcached protocol: each metric is sent as "STAT <name> <value>\r\n", list is terminated
+// by "END"
+void Stats::Execute(Storage &storage, const std::string &args, std::string &out) {
+    std::vector<std::pair<std::string, std::string>> stats;
+
+    // Process memory goes along with the bytes storage accounts, so they could be compared
+    stats.emplace_back("rss", std::to_string(Backend::MemoryLimit::Resident()));
+    storage.Stats(stats);
+
+    // Items of all the storages share the arena, so it is reported once per process. Classes that never
+    // had a page are skipped, there is nothing to report if memory comes from the heap
+    Allocator::Slab *slab = Allocator::DefaultArena();
+    if (slab != nullptr) {
+        stats.emplace_back("slab_mapped", std::to_string(slab->mapped()));
+        stats.emplace_back("slab_released_bytes", std::to_string(slab->released()));
+        stats.emplace_back("slab_unused_bytes", std::to_string(slab->unused()));
+        stats.emplace_back("slab_limit", std::to_string(slab->limit()));
+        stats.emplace_back("slab_hugetlb_bytes", std::to_string(slab->hugetlb_bytes()));
+        stats.emplace_back("slab_thp_bytes", std::to_string(slab->thp_bytes()));
+        stats.emplace_back("slab_huge_chunks", std::to_string(slab->huge()));
+        stats.emplace_back("slab_huge_bytes", std::to_string(slab->huge_bytes()));
+        for (size_t cls = 0; cls < slab->classes(); cls++) {
+            Allocator::Slab::ClassStats s = slab->stats(cls);
+            if (s.pages == 0) {
+                continue;
+            }
+            std::string prefix = "slab_" + std::to_string(cls) + ":";
+            stats.emplace_back(prefix + "chunk_size", std::to_string(s.chunk_size));
+            stats.emplace_back(prefix + "total_pages", std::to_string(s.pages));
+            stats.emplace_back(prefix + "used_chunks", std::to_string(s.used));
+            stats.emplace_back(prefix + "free_chunks", std::to_string(s.free));
+        }
+    }
+
+    std::stringstream outStream;
+    for (auto &stat : stats) {
+        outStream << "STAT " << stat.first << " " << stat.second << "\r\n";
+    }
+    outStream << "END"; // networking layer should add the last \r\n
+
+    out = outStream.str();
+}
 
 } // namespace Execute
 } // namespace Afina
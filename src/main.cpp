@@ -1,3 +1,4 @@
+#include <cctype>
 #include <chrono>
 #include <iostream>
 #include <memory>
@@ -7,17 +8,23 @@
 
 #include <afina/Storage.h>
 #include <afina/Version.h>
+#include <afina/allocator/StlAllocator.h>
 #include <afina/network/Server.h>
 
 #include "network/blocking/ServerImpl.h"
+#include "network/coroutine/ServerImpl.h"
 #include "network/nonblocking/ServerImpl.h"
 #include "network/uv/ServerImpl.h"
 #include "storage/MapBasedGlobalLockImpl.h"
 #include "storage/MapBasedFlatCombineImpl.h"
+#include "storage/MapBasedLockFreeImpl.h"
+#include "storage/MapBasedShardedImpl.h"
+#include "storage/MemoryLimit.h"
 
 typedef struct {
     std::shared_ptr<Afina::Storage> storage;
     std::shared_ptr<Afina::Network::Server> server;
+    std::shared_ptr<Afina::Backend::MemoryLimit> memory_limit;
 } Application;
 
 // Handle all signals catched
@@ -34,6 +41,36 @@ void timer_handler(uv_timer_t *handle) {
     std::cout << "Start passive metrics collection" << std::endl;
 }
 
+// Called when it is time to check process memory against the limit
+void memory_handler(uv_timer_t *handle) {
+    Application *pApp = static_cast<Application *>(handle->data);
+    pApp->memory_limit->Sample();
+}
+
+// Parses number of bytes with optional k, m or g suffix
+size_t parse_bytes(const std::string &str) {
+    size_t pos = 0;
+    unsigned long long bytes = std::stoull(str, &pos);
+    if (pos + 1 == str.size()) {
+        switch (std::tolower(str[pos])) {
+        case 'g':
+            bytes <<= 10;
+            // fallthrough
+        case 'm':
+            bytes <<= 10;
+            // fallthrough
+        case 'k':
+            bytes <<= 10;
+            break;
+        default:
+            throw std::runtime_error("Unknown size suffix");
+        }
+    } else if (pos != str.size()) {
+        throw std::runtime_error("Malformed size");
+    }
+    return bytes;
+}
+
 int main(int argc, char **argv) {
     // Build version
     // TODO: move into Version.h as a function
@@ -49,7 +86,19 @@ int main(int argc, char **argv) {
         // TODO: use custom cxxopts::value to print options possible values in help message
         // and simplify validation below
         options.add_options()("s,storage", "Type of storage service to use", cxxopts::value<std::string>());
-        options.add_options()("n,network", "Type of network service to use", cxxopts::value<std::string>());
+        options.add_options()("n,network", "Network service: uv, blocking, nonblocking or coroutine",
+                              cxxopts::value<std::string>());
+        options.add_options()("e,eviction", "Eviction policy: lru, slru, clock or slab", cxxopts::value<std::string>());
+        options.add_options()("a,admission", "Admission filter: none or tinylfu", cxxopts::value<std::string>());
+        options.add_options()("promotion", "How sharded storage moves entries on read: immediate or batched",
+                              cxxopts::value<std::string>());
+        options.add_options()("memory-limit",
+                              "Bytes process could keep resident, k, m or g suffix could be used. Storage size "
+                              "follows it",
+                              cxxopts::value<std::string>());
+        options.add_options()("hugepages",
+                              "Back storage memory by the huge pages: explicit ones if system has them reserved, "
+                              "transparent ones otherwise");
         options.add_options()("r,readfifo", "Fifo read channel", cxxopts::value<std::string>());
         options.add_options()("w,writefifo", "Fifo read channel", cxxopts::value<std::string>());
         options.add_options()("h,help", "Print usage info");
@@ -74,13 +123,62 @@ int main(int argc, char **argv) {
         storage_type = options["storage"].as<std::string>();
     }
 
+    auto eviction = Afina::Backend::EvictionPolicy::Type::Lru;
+    if (options.count("eviction") > 0) {
+        eviction = Afina::Backend::EvictionPolicy::ParseType(options["eviction"].as<std::string>());
+    }
+
+    bool admission = false;
+    if (options.count("admission") > 0) {
+        std::string admission_type = options["admission"].as<std::string>();
+        if (admission_type == "tinylfu") {
+            admission = true;
+        } else if (admission_type != "none") {
+            throw std::runtime_error("Unknown admission filter");
+        }
+    }
+
+    bool batch_promotions = false;
+    if (options.count("promotion") > 0) {
+        std::string promotion = options["promotion"].as<std::string>();
+        if (promotion == "batched") {
+            batch_promotions = true;
+        } else if (promotion != "immediate") {
+            throw std::runtime_error("Unknown promotion mode");
+        }
+    }
+
+    // Without the limit storage gets fixed budget
+    size_t max_size = 1048576;
+    if (options.count("memory-limit") > 0) {
+        max_size = parse_bytes(options["memory-limit"].as<std::string>());
+    }
+
+    // Arena must know that before storage maps anything
+    if (options.count("hugepages") > 0) {
+        Afina::Allocator::DefaultArena()->set_huge_pages(true);
+    }
+
     if (storage_type == "map_global") {
         // app.storage = std::make_shared<Afina::Backend::MapBasedGlobalLockImpl>();
-        app.storage = std::make_shared<Afina::Backend::MapBasedFlatCombineImpl>();
+        app.storage = std::make_shared<Afina::Backend::MapBasedFlatCombineImpl>(
+            max_size, Afina::Backend::MapBasedFlatCombineImpl::Options(), eviction, admission);
+    } else if (storage_type == "lock_free") {
+        if (admission) {
+            throw std::runtime_error("Admission filter isn't supported by lock_free storage");
+        }
+        app.storage = std::make_shared<Afina::Backend::MapBasedLockFreeImpl>(max_size, eviction);
+    } else if (storage_type == "sharded") {
+        app.storage = std::make_shared<Afina::Backend::MapBasedShardedImpl>(max_size, 16, eviction, admission,
+                                                                            batch_promotions);
     } else {
         throw std::runtime_error("Unknown storage type");
     }
 
+    if (options.count("memory-limit") > 0) {
+        app.memory_limit = std::make_shared<Afina::Backend::MemoryLimit>(*app.storage, max_size);
+    }
+
     // Build  & start network layer
     std::string network_type = "uv";
     if (options.count("network") > 0) {
@@ -93,6 +191,8 @@ int main(int argc, char **argv) {
         app.server = std::make_shared<Afina::Network::Blocking::ServerImpl>(app.storage);
     } else if (network_type == "nonblocking") {
         app.server = std::make_shared<Afina::Network::NonBlocking::ServerImpl>(app.storage);
+    } else if (network_type == "coroutine") {
+        app.server = std::make_shared<Afina::Network::Coroutine::ServerImpl>(app.storage);
     } else {
         throw std::runtime_error("Unknown network type");
     }
@@ -128,6 +228,14 @@ int main(int argc, char **argv) {
     timer.data = &app;
     uv_timer_start(&timer, timer_handler, 0, 5000);
 
+    // RSS is sampled more often than the rest of metrics, storage has to react before process grows too much
+    uv_timer_t memory_timer;
+    uv_timer_init(&loop, &memory_timer);
+    memory_timer.data = &app;
+    if (app.memory_limit) {
+        uv_timer_start(&memory_timer, memory_handler, 1000, 1000);
+    }
+
     // Start services
     try {
         app.storage->Start();
@@ -0,0 +1,101 @@
+#include "ServerImpl.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+
+#include <arpa/inet.h>
+#include <netinet/in.h>
+#include <signal.h>
+#include <sys/socket.h>
+#include <sys/types.h>
+#include <unistd.h>
+
+#include <afina/Storage.h>
+
+#include "Worker.h"
+
+namespace Afina {
+namespace Network {
+namespace Coroutine {
+
+// See Server.h
+ServerImpl::ServerImpl(std::shared_ptr<Afina::Storage> ps) : Server(ps), server_socket(-1) {}
+
+// See Server.h
+ServerImpl::~ServerImpl() {}
+
+// See Server.h
+void ServerImpl::Start(uint32_t port, uint16_t n_workers) {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+
+    // If a client closes a connection, this will generally produce a SIGPIPE
+    // signal that will kill the process. We want to ignore this signal, so send()
+    // just returns -1 when this happens.
+    sigset_t sig_mask;
+    sigemptyset(&sig_mask);
+    sigaddset(&sig_mask, SIGPIPE);
+    if (pthread_sigmask(SIG_BLOCK, &sig_mask, NULL) != 0) {
+        throw std::runtime_error("Unable to mask SIGPIPE");
+    }
+
+    // Create server socket
+    struct sockaddr_in server_addr;
+    std::memset(&server_addr, 0, sizeof(server_addr));
+    server_addr.sin_family = AF_INET;         // IPv4
+    server_addr.sin_port = htons(port);       // TCP port number
+    server_addr.sin_addr.s_addr = INADDR_ANY; // Bind to any address
+
+    // Each worker accepts from its own epoll, so socket must not block
+    server_socket = socket(PF_INET, SOCK_STREAM | SOCK_NONBLOCK, IPPROTO_TCP);
+    if (server_socket == -1) {
+        throw std::runtime_error("Failed to open socket");
+    }
+
+    int opts = 1;
+    if (setsockopt(server_socket, SOL_SOCKET, SO_REUSEADDR, &opts, sizeof(opts)) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket setsockopt() failed");
+    }
+
+    if (bind(server_socket, (struct sockaddr *)&server_addr, sizeof(server_addr)) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket bind() failed");
+    }
+
+    if (listen(server_socket, SOMAXCONN) == -1) {
+        close(server_socket);
+        throw std::runtime_error("Socket listen() failed");
+    }
+
+    for (int i = 0; i < n_workers; i++) {
+        workers.emplace_back(new Worker(pStorage));
+        workers.back()->Start(server_socket);
+    }
+}
+
+// See Server.h
+void ServerImpl::Stop() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    for (auto &worker : workers) {
+        worker->Stop();
+    }
+}
+
+// See Server.h
+void ServerImpl::Join() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    for (auto &worker : workers) {
+        worker->Join();
+    }
+    workers.clear();
+
+    if (server_socket != -1) {
+        close(server_socket);
+        server_socket = -1;
+    }
+}
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
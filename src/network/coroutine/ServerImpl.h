@@ -0,0 +1,46 @@
+#ifndef AFINA_NETWORK_COROUTINE_SERVER_H
+#define AFINA_NETWORK_COROUTINE_SERVER_H
+
+#include <memory>
+#include <vector>
+
+#include <afina/network/Server.h>
+
+namespace Afina {
+namespace Network {
+namespace Coroutine {
+
+// Forward declaration, see Worker.h
+class Worker;
+
+/**
+ * # Network resource manager implementation
+ * Epoll based server that serves each connection by a coroutine, so connection code is written just like
+ * in the blocking server while one thread keeps lots of connections
+ */
+class ServerImpl : public Server {
+public:
+    ServerImpl(std::shared_ptr<Afina::Storage> ps);
+    ~ServerImpl();
+
+    // See Server.h
+    void Start(uint32_t port, uint16_t workers) override;
+
+    // See Server.h
+    void Stop() override;
+
+    // See Server.h
+    void Join() override;
+
+private:
+    int server_socket;
+
+    // Threads running coroutines
+    std::vector<std::unique_ptr<Worker>> workers;
+};
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_COROUTINE_SERVER_H
@@ -0,0 +1,174 @@
+#include "Worker.h"
+
+#include <cstring>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
+#include <errno.h>
+#include <sys/socket.h>
+#include <unistd.h>
+
+#include <afina/Storage.h>
+#include <afina/execute/Command.h>
+#include <protocol/Parser.h>
+
+namespace Afina {
+namespace Network {
+namespace Coroutine {
+
+// See Worker.h
+Worker::Worker(std::shared_ptr<Afina::Storage> ps)
+    : pStorage(ps), server_socket(-1), running(false), engine(nullptr) {}
+
+// See Worker.h
+Worker::~Worker() {}
+
+// See Worker.h
+void Worker::Start(int server_socket) {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    this->server_socket.store(server_socket);
+    running.store(true);
+    if (pthread_create(&thread, NULL, OnRun, this) != 0) {
+        throw std::runtime_error("Worker failed to start");
+    }
+}
+
+// See Worker.h
+void Worker::Stop() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    running.store(false);
+
+    // Wakes up acceptors of all the workers, accept fails from now on
+    shutdown(server_socket, SHUT_RDWR);
+}
+
+// See Worker.h
+void Worker::Join() {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    pthread_join(thread, NULL);
+}
+
+// See Worker.h
+void *Worker::OnRun(void *args) {
+    std::cout << "network debug: " << __PRETTY_FUNCTION__ << std::endl;
+    Worker &worker = *static_cast<Worker *>(args);
+
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+    worker.engine = &engine;
+    try {
+        engine.start(Acceptor, worker);
+    } catch (std::runtime_error &ex) {
+        std::cerr << "Worker fails: " << ex.what() << std::endl;
+    }
+    worker.engine = nullptr;
+    return nullptr;
+}
+
+// See Worker.h
+void Worker::Acceptor(Worker &worker) {
+    while (worker.running.load()) {
+        int client_socket = worker.engine->accept(worker.server_socket.load());
+        if (client_socket == -1) {
+            if (worker.running.load()) {
+                // Out of descriptors or alike, give connections some time to close
+                std::cerr << "Worker failed to accept: " << strerror(errno) << std::endl;
+                worker.engine->sleep(100);
+            }
+            continue;
+        }
+
+        // Coroutine gets control once this one waits for the next connection
+        worker.clients.insert(client_socket);
+        worker.engine->run(RunConnection, worker, int(client_socket));
+    }
+
+    // Coroutines blocked on their sockets wake up with an error and close
+    for (int client_socket : worker.clients) {
+        shutdown(client_socket, SHUT_RDWR);
+    }
+}
+
+// See Worker.h
+void Worker::RunConnection(Worker &worker, int client_socket) {
+    Afina::Coroutine::Engine &engine = *worker.engine;
+
+    char buffer[BUFFER_CAPACITY];
+    Protocol::Parser parser;
+    bool error = false;
+    ssize_t position = 0;
+
+    while (worker.running.load() && !error) {
+        std::string out;
+        try {
+            size_t parsed;
+            while (!parser.Parse(buffer, position, parsed)) {
+                std::memmove(buffer, buffer + parsed, position - parsed);
+                position -= parsed;
+
+                ssize_t bytes_read = engine.read(client_socket, buffer + position, BUFFER_CAPACITY - position);
+                if (bytes_read <= 0) {
+                    worker.Close(client_socket);
+                    return;
+                }
+                position += bytes_read;
+            }
+            std::memmove(buffer, buffer + parsed, position - parsed);
+            position -= parsed;
+
+            uint32_t body_size;
+            auto cmd = parser.Build(body_size);
+            parser.Reset();
+
+            std::string body;
+            if (body_size) {
+                body_size += 2; // trailing '\r\n'
+
+                while (body_size > position) {
+                    body_size -= position;
+                    body.append(buffer, position);
+                    position = engine.read(client_socket, buffer, BUFFER_CAPACITY);
+                    if (position <= 0) {
+                        worker.Close(client_socket);
+                        return;
+                    }
+                }
+
+                body.append(buffer, body_size);
+                std::memmove(buffer, buffer + body_size, position - body_size);
+                position -= body_size;
+
+                body = body.substr(0, body.length() - 2);
+            }
+
+            cmd->Execute(*worker.pStorage, body, out);
+            out.append("\r\n");
+        } catch (std::runtime_error &e) {
+            out = std::string("SERVER_ERROR ") + e.what() + std::string("\r\n");
+            error = true;
+        }
+
+        // Command with nothing to answer leaves only the line end
+        size_t bytes_sent_total = out.size() > 2 ? 0 : out.size();
+        while (bytes_sent_total < out.size()) {
+            ssize_t bytes_sent =
+                engine.write(client_socket, out.data() + bytes_sent_total, out.size() - bytes_sent_total);
+            if (bytes_sent <= 0) {
+                worker.Close(client_socket);
+                return;
+            }
+            bytes_sent_total += bytes_sent;
+        }
+    }
+    worker.Close(client_socket);
+}
+
+// See Worker.h
+void Worker::Close(int client_socket) {
+    clients.erase(client_socket);
+    close(client_socket);
+}
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
@@ -0,0 +1,84 @@
+#ifndef AFINA_NETWORK_COROUTINE_WORKER_H
+#define AFINA_NETWORK_COROUTINE_WORKER_H
+
+#include <atomic>
+#include <memory>
+#include <pthread.h>
+#include <unordered_set>
+
+#include <afina/coroutine/Engine.h>
+
+namespace Afina {
+
+// Forward declaration, see afina/Storage.h
+class Storage;
+
+namespace Network {
+namespace Coroutine {
+
+/**
+ * # Thread running coroutines
+ * On Start spawns background thread with its own coroutine engine. Main coroutine accepts connections
+ * from the given server socket and starts a coroutine for each. Connection coroutine reads and writes its
+ * socket as if it was blocking, through the engine: once socket has nothing to read or no room to write,
+ * coroutine is blocked and the others run, engine waits on epoll when all of them are blocked
+ */
+class Worker {
+public:
+    Worker(std::shared_ptr<Afina::Storage> ps);
+    ~Worker();
+
+    /**
+     * Spawns new background thread that accepts connections from the given server socket and processes
+     * them in coroutines
+     */
+    void Start(int server_socket);
+
+    /**
+     * Signal background thread to stop. Thread stops to accept new connections, connections stop to read
+     * new commands and get closed, then thread exits
+     */
+    void Stop();
+
+    /**
+     * Blocks calling thread until background one for this worker is actually been destroyed
+     */
+    void Join();
+
+protected:
+    /**
+     * Method executing by background thread
+     */
+    static void *OnRun(void *args);
+
+    /**
+     * Main coroutine: accepts connections until worker is stopped, then shuts connections left down
+     */
+    static void Acceptor(Worker &worker);
+
+    /**
+     * Coroutine for each connection, same sequential code as in the blocking server
+     */
+    static void RunConnection(Worker &worker, int client_socket);
+
+private:
+    // Closes connection socket
+    void Close(int client_socket);
+
+    pthread_t thread;
+    std::shared_ptr<Afina::Storage> pStorage;
+    std::atomic<int> server_socket;
+    std::atomic<bool> running;
+
+    // Live on the background thread only
+    Afina::Coroutine::Engine *engine;
+    std::unordered_set<int> clients;
+
+    static const size_t BUFFER_CAPACITY = 2048;
+};
+
+} // namespace Coroutine
+} // namespace Network
+} // namespace Afina
+
+#endif // AFINA_NETWORK_COROUTINE_WORKER_H
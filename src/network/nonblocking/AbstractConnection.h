@@ -5,6 +5,8 @@
 #include <string>
 #include <cstring>
 
+#include <sys/uio.h>
+
 #include <protocol/Parser.h>
 #include <afina/execute/Command.h>
 #include <stdexcept>
@@ -42,6 +44,12 @@ public:
 
     virtual int send_body(int fd, const char *buf, size_t len, int flags) = 0;
 
+    /**
+     * Gather version of send_body: sends out as much as possible from the given chunks
+     * and returns number of bytes sent
+     */
+    virtual int send_chunks(int fd, const struct iovec *iov, int iovcnt) = 0;
+
     int Read() {
         bool error = false;
 
@@ -90,19 +98,40 @@ public:
                         body = body.substr(0, body.length() - 2);
                     }
                     
+                    out.Clear();
                     cmd->Execute(*pStorage, body, out);
-                    out.append("\r\n");
+                    out.Append("\r\n");
                     state = State::Response;
                 }
             } catch (std::runtime_error &e) {
-                out = std::string("SERVER_ERROR ") + e.what() + std::string("\r\n");
+                out.Clear();
+                out.Append(std::string("SERVER_ERROR ") + e.what() + std::string("\r\n"));
                 error = true;
                 state = State::Response;
             }
             if (state == State::Response) {
                 if (out.size() > 2) {
                     while (bytes_sent_total < out.size()) {
-                        ssize_t bytes_sent = send_body(fd, out.data() + bytes_sent_total, out.size() - bytes_sent_total, 0);
+                        // Values are sent right from the storage owned buffers, so here
+                        // we just need to skip bytes sent already
+                        struct iovec iov[MAX_IOV];
+                        int iovcnt = 0;
+                        size_t skip = bytes_sent_total;
+                        for (auto &chunk : out.Chunks()) {
+                            if (skip >= chunk.size()) {
+                                skip -= chunk.size();
+                                continue;
+                            }
+                            if (iovcnt == MAX_IOV) {
+                                break;
+                            }
+                            iov[iovcnt].iov_base = const_cast<char *>(chunk.data() + skip);
+                            iov[iovcnt].iov_len = chunk.size() - skip;
+                            iovcnt++;
+                            skip = 0;
+                        }
+
+                        ssize_t bytes_sent = send_chunks(fd, iov, iovcnt);
                         if (bytes_sent <= 0) {
                             return ret_val;
                         }
@@ -110,6 +139,7 @@ public:
                     }
                 }
                 bytes_sent_total = 0;
+                out.Clear();
                 state = State::Parsing;
             }
         }
@@ -128,6 +158,9 @@ private:
     State state = State::Parsing;
 
     static const size_t BUFFER_CAPACITY = 2048;
+
+    // Max number of chunks passed to a single send_chunks call
+    static const int MAX_IOV = 64;
     char buffer[BUFFER_CAPACITY];
 
     const int finish;
@@ -136,7 +169,7 @@ private:
     size_t bytes_sent_total = 0;
 
     std::string body;
-    std::string out;
+    Execute::Response out;
 };
 
 } // namespace NonBlocking
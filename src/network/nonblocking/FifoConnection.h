@@ -3,6 +3,7 @@
 
 #include <string>
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <errno.h>
@@ -41,6 +42,18 @@ public:
         return bytes_sent;
     }
 
+    int send_chunks(int fd, const struct iovec *iov, int iovcnt) override {
+        ssize_t bytes_sent = writev(fd, iov, iovcnt);
+        if (bytes_sent < 0) {
+            if ((errno == EWOULDBLOCK || errno == EAGAIN) && running.load()) {
+                ret_val = 0;
+            } else {
+                ret_val = -1;
+            }
+        }
+        return bytes_sent;
+    }
+
     void close_connection() {
         close(fd);
         unlink(fifo_read.c_str());
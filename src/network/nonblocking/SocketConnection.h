@@ -2,6 +2,7 @@
 #define AFINA_NETWORK_NONBLOCKING_SOCKET_CONNECTION_H
 
 #include <sys/socket.h>
+#include <sys/uio.h>
 #include <unistd.h>
 
 #include <errno.h>
@@ -60,6 +61,18 @@ public:
         return bytes_sent;
     }
 
+    int send_chunks(int fd, const struct iovec *iov, int iovcnt) override {
+        ssize_t bytes_sent = writev(fd, iov, iovcnt);
+        if (bytes_sent < 0) {
+            if ((errno == EWOULDBLOCK || errno == EAGAIN) && running.load()) {
+                ret_val = 0;
+            } else {
+                ret_val = -1;
+            }
+        }
+        return bytes_sent;
+    }
+
     void close_connection() {
         close(fd);
     }
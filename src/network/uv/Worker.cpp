@@ -297,8 +297,13 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         while (pconn->input_parsed < pconn->input_used) {
             // Read header or body if needs
             if (pconn->state == ConnectionState::sRecvHeader) {
-                // Try to parse command out
-                if (!pconn->parser.Parse(pconn->input, pconn->input_used, pconn->input_parsed)) {
+                // Try to parse command out, parser reports number of bytes it consumed from the
+                // unparsed part of the input
+                size_t parsed = 0;
+                bool complete = pconn->parser.Parse(pconn->input + pconn->input_parsed,
+                                                    pconn->input_used - pconn->input_parsed, parsed);
+                pconn->input_parsed += parsed;
+                if (!complete) {
                     continue;
                 }
 
@@ -352,20 +357,13 @@ void Worker::OnRead(uv_stream_t *conn, ssize_t nread, const uv_buf_t *buf) {
         std::stringstream ss;
         ss << "CLIENT_ERROR " << ex.what();
 
-        std::string output = ss.str();
-
         ExecuteTask *ptask = new ExecuteTask();
         ptask->connection = pconn;
         uv_async_init(&uvLoop, &ptask->done, delegate<Worker>::callback<&Worker::OnExecutionDone>);
         ptask->done.data = this;
 
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        ptask->response.Append(ss.str());
+        ptask->PrepareResult();
 
         pconn->runningTasks++;
         pconn->state = ConnectionState::sClosed;
@@ -393,25 +391,19 @@ void Worker::Execute(Connection &pconn) {
 
     // TODO: That should be in another thread
     {
-        std::string output;
         try {
-            ptask->cmd->Execute(*pStorage, ptask->argument, output);
+            ptask->cmd->Execute(*pStorage, ptask->argument, ptask->response);
         } catch (std::runtime_error &ex) {
             std::cerr << "Failed to execute command: " << ex.what() << std::endl;
 
             std::stringstream ss;
             ss << "SERVER_ERROR " << ex.what();
-            output = ss.str();
+            ptask->response.Clear();
+            ptask->response.Append(ss.str());
         }
 
-        // Prepare output
-        size_t size = output.size() + 2;
-        ptask->result.base = new char[size];
-        ptask->result.len = size;
-
-        std::memcpy(ptask->result.base, &output[0], size - 2);
-        ptask->result.base[size - 2] = '\r';
-        ptask->result.base[size - 1] = '\n';
+        // Prepare output, values are written right from the storage buffers
+        ptask->PrepareResult();
 
         // Notify event loop about task completition
         uv_async_send(&ptask->done);
@@ -431,7 +423,7 @@ void Worker::OnExecutionDone(uv_async_t *handle) {
 
     // Send buffer to socket. Even if connection is already closed we are still try to write data out,
     // that would lead to possible write error which is ok and will be handled in the OnWriteDone
-    int rc = uv_write(&task->handler, &task->connection->handler, &task->result, 1,
+    int rc = uv_write(&task->handler, &task->connection->handler, task->result.data(), task->result.size(),
                       delegate<Worker, int>::callback<&Worker::OnWriteDone>);
     if (rc != 0) {
         throw std::runtime_error("Failed to write request");
@@ -450,7 +442,7 @@ void Worker::OnWriteDone(uv_write_t *req, int status) {
         uv_close((uv_handle_t *)(task->connection), delegate<Worker>::callback<&Worker::OnConnectionClosed>);
     }
 
-    delete[] task->result.base;
+    // Releases references to the values sent
     delete task;
 }
 
@@ -140,8 +140,24 @@ protected:
         // Argument for the command
         std::string argument;
 
-        // Execution result
-        uv_buf_t result;
+        // Execution result, values in it are referenced rather than copied
+        Execute::Response response;
+
+        // Buffers pointing to the response chunks, passed to uv_write as is
+        std::vector<uv_buf_t> result;
+
+        /**
+         * Prepare response to be written out by libuv
+         */
+        void PrepareResult() {
+            response.Append("\r\n");
+
+            const std::vector<Value> &chunks = response.Chunks();
+            result.resize(chunks.size());
+            for (size_t i = 0; i < chunks.size(); i++) {
+                result[i] = uv_buf_init(const_cast<char *>(chunks[i].data()), chunks[i].size());
+            }
+        }
     } ExecuteTask;
 
     /**
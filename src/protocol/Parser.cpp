@@ -6,9 +6,14 @@
 
 #include <afina/execute/Add.h>
 #include <afina/execute/Append.h>
+#include <afina/execute/Cas.h>
 #include <afina/execute/Command.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Delete.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Replace.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -27,7 +32,8 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
         case State::sName: {
             if (c == ' ' || c == '\r') {
                 // std::cout << "parser debug: name='" << name << "'" << std::endl;
-                if (name == "set" || name == "add" || name == "append" || name == "prepend") {
+                if (name == "set" || name == "add" || name == "replace" || name == "append" || name == "prepend" ||
+                    name == "cas" || name == "incr" || name == "decr") {
                     state = State::spKey;
                 } else if (name == "get" || name == "gets") {
                     state = State::sgKey;
@@ -45,7 +51,7 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
 
         case State::spKey: {
             if (c == ' ') {
-                state = State::spFlags;
+                state = (name == "incr" || name == "decr") ? State::saDelta : State::spFlags;
                 keys.push_back(curKey);
                 // std::cout << "parser debug: key[" << keys.size() - 1 << "]='" << curKey << "'" << std::endl;
             } else {
@@ -108,19 +114,16 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
                 state = State::spBytes;
                 // std::cout << "parser debug: ExprTime='" << exprtime << "'" << std::endl;
             } else if (c >= '0' && c <= '9') {
-                int32_t et = exprtime;
+                int64_t et = int64_t(exprtime) * 10;
                 if (negative) {
                     et -= (c - '0');
-                    if (et > exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
                 } else {
                     et += (c - '0');
-                    if (et < exprtime) {
-                        throw std::runtime_error("Expire time field overflow");
-                    }
                 }
-                exprtime = et;
+                if (et < INT32_MIN || et > INT32_MAX) {
+                    throw std::runtime_error("Expire time field overflow");
+                }
+                exprtime = int32_t(et);
             }
             break;
         }
@@ -129,6 +132,8 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             if (c == '\r') {
                 state = State::sLF;
                 // std::cout << "parser debug: bytes='" << bytes << "'" << std::endl;
+            } else if (c == ' ' && name == "cas") {
+                state = State::spCasUnique;
             } else if (c >= '0' && c <= '9') {
                 uint32_t b = (bytes * 10) + (c - '0');
                 if (b < bytes) {
@@ -140,6 +145,34 @@ bool Parser::Parse(const char *input, const size_t size, size_t &parsed) {
             break;
         }
 
+        case State::spCasUnique: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t u = (casUnique * 10) + (c - '0');
+                if (u / 10 != casUnique) {
+                    // Overflow
+                    throw std::runtime_error("Cas unique field overflow");
+                }
+                casUnique = u;
+            }
+            break;
+        }
+
+        case State::saDelta: {
+            if (c == '\r') {
+                state = State::sLF;
+            } else if (c >= '0' && c <= '9') {
+                uint64_t d = (delta * 10) + (c - '0');
+                if (d / 10 != delta) {
+                    // Overflow
+                    throw std::runtime_error("Value field overflow");
+                }
+                delta = d;
+            }
+            break;
+        }
+
         case State::sLF: {
             if (c == '\n') {
                 parse_complete = true;
@@ -171,10 +204,22 @@ std::unique_ptr<Execute::Command> Parser::Build(uint32_t &body_size) const {
         return std::unique_ptr<Execute::Command>(new Execute::Set(keys[0], flags, exprtime));
     } else if (name == "add") {
         return std::unique_ptr<Execute::Command>(new Execute::Add(keys[0], flags, exprtime));
+    } else if (name == "replace") {
+        return std::unique_ptr<Execute::Command>(new Execute::Replace(keys[0], flags, exprtime));
     } else if (name == "append") {
         return std::unique_ptr<Execute::Command>(new Execute::Append(keys[0], flags, exprtime));
+    } else if (name == "prepend") {
+        return std::unique_ptr<Execute::Command>(new Execute::Prepend(keys[0], flags, exprtime));
+    } else if (name == "incr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Incr(keys[0], delta));
+    } else if (name == "decr") {
+        return std::unique_ptr<Execute::Command>(new Execute::Decr(keys[0], delta));
+    } else if (name == "cas") {
+        return std::unique_ptr<Execute::Command>(new Execute::Cas(keys[0], flags, exprtime, casUnique));
     } else if (name == "get") {
         return std::unique_ptr<Execute::Command>(new Execute::Get(keys));
+    } else if (name == "gets") {
+        return std::unique_ptr<Execute::Command>(new Execute::Get(keys, true));
     } else if (name == "stats") {
         return std::unique_ptr<Execute::Command>(new Execute::Stats());
     } else {
@@ -192,6 +237,8 @@ void Parser::Reset() {
     flags = 0;
     bytes = 0;
     exprtime = 0;
+    casUnique = 0;
+    delta = 0;
 }
 
 } // namespace Protocol
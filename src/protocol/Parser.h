@@ -61,8 +61,21 @@ private:
      * - s: state for PUT and GET commands
      * - sp: for PUT commands only
      * - sg: for GET commands only
+     * - sa: for INCR/DECR commands only
      */
-    enum State : uint16_t { sCR, sLF, sName, spKey, spFlags, spExprTimeStart, spExprTime, spBytes, sgKey };
+    enum State : uint16_t {
+        sCR,
+        sLF,
+        sName,
+        spKey,
+        spFlags,
+        spExprTimeStart,
+        spExprTime,
+        spBytes,
+        spCasUnique,
+        sgKey,
+        saDelta
+    };
 
     // Current parser state
     State state;
@@ -88,6 +101,14 @@ private:
     // it's followed by an empty data block).
     uint32_t bytes;
 
+    // <cas unique> is a unique 64-bit value of an existing entry. Clients should use the value returned from
+    // the "gets" command when issuing "cas" updates.
+    uint64_t casUnique;
+
+    // <value> of incr/decr is the decimal representation of a 64-bit unsigned integer by which the item is
+    // changed
+    uint64_t delta;
+
     bool negative;
     std::string curKey;
     bool parse_complete;
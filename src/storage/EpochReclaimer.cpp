@@ -0,0 +1,90 @@
+#include "EpochReclaimer.h"
+
+#include <algorithm>
+
+namespace Afina {
+namespace Backend {
+
+EpochReclaimer::EpochReclaimer() : _epoch(1), _participants(nullptr), _local(nullptr, Leave) {}
+
+// See EpochReclaimer.h
+EpochReclaimer::~EpochReclaimer() {
+    for (auto &retired : _retired) {
+        retired.deleter(retired.ptr);
+    }
+
+    Participant *p = _participants.load(std::memory_order_acquire);
+    while (p != nullptr) {
+        Participant *next = p->next;
+        delete p;
+        p = next;
+    }
+}
+
+// See EpochReclaimer.h
+void EpochReclaimer::Retire(void *ptr, void (*deleter)(void *)) {
+    // Readers pinned the current epoch or the one before could still see the object. New readers
+    // pin the next epoch and couldn't find it anymore
+    uint64_t epoch = _epoch.fetch_add(1, std::memory_order_seq_cst);
+    _retired.push_back(Retired{ptr, deleter, epoch});
+}
+
+// See EpochReclaimer.h
+size_t EpochReclaimer::Reclaim() {
+    uint64_t oldest = UINT64_MAX;
+    for (Participant *p = _participants.load(std::memory_order_acquire); p != nullptr; p = p->next) {
+        uint64_t epoch = p->epoch.load(std::memory_order_seq_cst);
+        if (epoch != 0) {
+            oldest = std::min(oldest, epoch);
+        }
+    }
+
+    size_t freed = 0;
+    while (!_retired.empty() && _retired.front().epoch < oldest) {
+        _retired.front().deleter(_retired.front().ptr);
+        _retired.pop_front();
+        freed++;
+    }
+    return freed;
+}
+
+EpochReclaimer::Participant *EpochReclaimer::Local() {
+    Participant *result = _local.get();
+    if (result != nullptr) {
+        return result;
+    }
+
+    // Take participant left by some exited thread or add a new one
+    for (Participant *p = _participants.load(std::memory_order_acquire); p != nullptr; p = p->next) {
+        bool expected = false;
+        if (!p->in_use.load(std::memory_order_relaxed) &&
+            p->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            result = p;
+            break;
+        }
+    }
+
+    if (result == nullptr) {
+        result = new Participant();
+        result->epoch.store(0, std::memory_order_relaxed);
+        result->depth = 0;
+        result->in_use.store(true, std::memory_order_relaxed);
+        result->next = _participants.load(std::memory_order_relaxed);
+        while (!_participants.compare_exchange_weak(result->next, result, std::memory_order_release,
+                                                    std::memory_order_relaxed)) {
+        }
+    }
+
+    _local.set(result);
+    return result;
+}
+
+void EpochReclaimer::Leave(void *participant) {
+    Participant *p = static_cast<Participant *>(participant);
+    p->depth = 0;
+    p->epoch.store(0, std::memory_order_release);
+    p->in_use.store(false, std::memory_order_release);
+}
+
+} // namespace Backend
+} // namespace Afina
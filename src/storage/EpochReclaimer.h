@@ -0,0 +1,113 @@
+#ifndef AFINA_STORAGE_EPOCH_RECLAIMER_H
+#define AFINA_STORAGE_EPOCH_RECLAIMER_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+
+#include "ThreadLocal.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Epoch based memory reclamation
+ * Lets readers walk shared data structure without any locks while writers unlink objects from it.
+ * Reader pins current global epoch for the time it accesses the structure. Writer doesn't free
+ * unlinked object right away but retires it along with the epoch it happened in. Object is freed
+ * once every pinned reader has entered after its retirement, so no one could hold a pointer to it.
+ *
+ * Guard could be taken by any thread at any time, Retire and Reclaim must be serialized by the
+ * caller, usually they are called under the same lock writers take
+ */
+class EpochReclaimer {
+public:
+    class Guard;
+
+    EpochReclaimer();
+
+    /**
+     * Frees everything retired. No thread could hold a guard at this point
+     */
+    ~EpochReclaimer();
+
+    /**
+     * Schedules object to be freed by deleter once no reader could access it. Object must be
+     * already unreachable for the new readers
+     */
+    void Retire(void *ptr, void (*deleter)(void *));
+
+    /**
+     * Frees retired objects no reader could access anymore
+     *
+     * @return number of objects freed
+     */
+    size_t Reclaim();
+
+    /**
+     * Number of retired objects waiting to be freed
+     */
+    size_t pending() const { return _retired.size(); }
+
+private:
+    // Per thread state, participants are never deleted before reclaimer, exited thread leaves its
+    // participant for the next thread to come
+    struct Participant {
+        // Epoch pinned by the thread, 0 if it isn't accessing structure
+        std::atomic<uint64_t> epoch;
+
+        // Nesting level of the guards, touched by the owner thread only
+        unsigned depth;
+
+        std::atomic<bool> in_use;
+        Participant *next;
+    };
+
+    struct Retired {
+        void *ptr;
+        void (*deleter)(void *);
+        uint64_t epoch;
+    };
+
+    Participant *Local();
+    static void Leave(void *participant);
+
+    std::atomic<uint64_t> _epoch;
+    std::atomic<Participant *> _participants;
+    ThreadLocal<Participant> _local;
+
+    // Retired objects in the order of retirement, thus of epochs
+    std::deque<Retired> _retired;
+};
+
+/**
+ * Pins epoch for the calling thread for the time of guard existence. Guards could be nested
+ */
+class EpochReclaimer::Guard {
+public:
+    explicit Guard(EpochReclaimer &reclaimer) : _participant(reclaimer.Local()) {
+        if (_participant->depth++ == 0) {
+            // Object unlinked before the epoch advanced past the value read here could be seen by this
+            // thread, so retirement epoch of such object is never less than the pinned one
+            _participant->epoch.store(reclaimer._epoch.load(std::memory_order_acquire), std::memory_order_seq_cst);
+        }
+    }
+
+    ~Guard() {
+        if (--_participant->depth == 0) {
+            _participant->epoch.store(0, std::memory_order_release);
+        }
+    }
+
+    Guard(const Guard &) = delete;
+    Guard &operator=(const Guard &) = delete;
+
+private:
+    Participant *_participant;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_EPOCH_RECLAIMER_H
@@ -0,0 +1,300 @@
+#include "EvictionPolicy.h"
+
+#include <stdexcept>
+
+#include <afina/allocator/Slab.h>
+
+namespace Afina {
+namespace Backend {
+
+// See EvictionPolicy.h
+std::unique_ptr<EvictionPolicy> EvictionPolicy::Create(Type type) {
+    switch (type) {
+    case Type::SegmentedLru:
+        return std::unique_ptr<EvictionPolicy>(new SegmentedLruPolicy());
+    case Type::Clock:
+        return std::unique_ptr<EvictionPolicy>(new ClockPolicy());
+    case Type::SlabLru:
+        return std::unique_ptr<EvictionPolicy>(new SlabLruPolicy());
+    default:
+        return std::unique_ptr<EvictionPolicy>(new LruPolicy());
+    }
+}
+
+// See EvictionPolicy.h
+EvictionPolicy::Type EvictionPolicy::ParseType(const std::string &name) {
+    if (name == "lru") {
+        return Type::Lru;
+    } else if (name == "slru") {
+        return Type::SegmentedLru;
+    } else if (name == "clock") {
+        return Type::Clock;
+    } else if (name == "slab") {
+        return Type::SlabLru;
+    }
+    throw std::invalid_argument("Unknown eviction policy: " + name);
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *SegmentedLruPolicy::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+    LinkedList::Entry *e = _probation.Put(key, value, meta);
+    e->state = Probation;
+    _probation_size++;
+    return e;
+}
+
+// See EvictionPolicy.h
+void SegmentedLruPolicy::Up(LinkedList::Entry *e) {
+    if (e->state == Protected) {
+        _protected.Up(e);
+        return;
+    }
+
+    _probation.Unlink(e);
+    _probation_size--;
+    _protected.Link(e);
+    _protected_size++;
+    e->state = Protected;
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *SegmentedLruPolicy::Tail() {
+    // Storage is full once it asks for a victim, so that is the time to bring protected segment
+    // back to its share of entries. Least recently used protected entries get one more chance in
+    // the probation segment
+    size_t limit = (_probation_size + _protected_size) * _protected_percent / 100;
+    while (_protected_size > limit) {
+        LinkedList::Entry *demoted = _protected.Tail();
+        _protected.Unlink(demoted);
+        _protected_size--;
+        _probation.Link(demoted);
+        _probation_size++;
+        demoted->state = Probation;
+    }
+
+    if (!_probation.Empty()) {
+        return _probation.Tail();
+    }
+    return _protected.Tail();
+}
+
+// See EvictionPolicy.h
+void SegmentedLruPolicy::Release(LinkedList::Entry *e) {
+    if (e->state == Protected) {
+        _protected_size--;
+        _protected.Unlink(e);
+    } else {
+        _probation_size--;
+        _probation.Unlink(e);
+    }
+}
+
+// See EvictionPolicy.h
+void SegmentedLruPolicy::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    EvictionPolicy::Stats(stats);
+    stats.emplace_back("slru_probation_items", std::to_string(_probation_size));
+    stats.emplace_back("slru_protected_items", std::to_string(_protected_size));
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *ClockPolicy::Tail() {
+    LinkedList::Entry *e = _hand != nullptr ? _hand : _list.Tail();
+
+    // Terminates in at most one full turn, as all the reference bits are cleared by then
+    while (e->state != 0) {
+        e->state = 0;
+        e = _list.Prev(e);
+        if (e == nullptr) {
+            e = _list.Tail();
+        }
+    }
+
+    _hand = e;
+    return e;
+}
+
+// See EvictionPolicy.h
+void ClockPolicy::Release(LinkedList::Entry *e) {
+    if (_hand == e) {
+        _hand = _list.Prev(e);
+    }
+    _list.Unlink(e);
+}
+
+constexpr time_t SlabLruPolicy::WINDOW;
+constexpr unsigned SlabLruPolicy::STREAK;
+constexpr size_t SlabLruPolicy::SCAN_LIMIT;
+
+SlabLruPolicy::SlabLruPolicy()
+    : _n_classes(LinkedList::Memory() != nullptr ? LinkedList::Memory()->classes() + 1 : 1), _classes(new Class[_n_classes]), _pressure(0),
+      _victim(nullptr), _window_end(0), _scan_time(0), _scanned(0), _move_class(0), _move_page(nullptr),
+      _cursor(nullptr), _pages_moved(0) {
+    for (size_t cls = 0; cls + 1 < _n_classes; cls++) {
+        _classes[cls].chunk = LinkedList::Memory()->stats(cls).chunk_size;
+    }
+    // Blocks bigger than slab chunks take at least that much
+    _classes[_n_classes - 1].chunk = Allocator::Slab::MAX_CHUNK;
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *SlabLruPolicy::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+    LinkedList::Entry *e = LinkedList::Entry::Create(key, value, meta);
+    e->state = e->chunk_class();
+    _classes[e->state].list.Link(e);
+    _classes[e->state].items++;
+    _pressure = e->state;
+    return e;
+}
+
+// See EvictionPolicy.h
+void SlabLruPolicy::Up(LinkedList::Entry *e) {
+    size_t cls = e->chunk_class();
+    if (cls == e->state) {
+        if (e == _cursor) {
+            _cursor = _classes[cls].list.Prev(e);
+        }
+        _classes[cls].list.Up(e);
+        return;
+    }
+
+    // Value has been changed and moved to the chunk of another class
+    Unlink(e);
+    e->state = cls;
+    _classes[cls].list.Link(e);
+    _classes[cls].items++;
+    _pressure = cls;
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *SlabLruPolicy::Tail() {
+    // Entry just put is the head of its class, it is evicted only if there is nothing else at all
+    Class &pressure = _classes[_pressure];
+    if (pressure.items > 1) {
+        _victim = pressure.list.Tail();
+        return _victim;
+    }
+
+    // Class has nothing to give yet, the one holding the most memory gives its oldest entry
+    Class *richest = &pressure;
+    for (size_t cls = 0; cls < _n_classes; cls++) {
+        Class &c = _classes[cls];
+        if (cls != _pressure && c.items * c.chunk > richest->items * richest->chunk) {
+            richest = &c;
+        }
+    }
+    _victim = richest->list.Tail();
+    return _victim;
+}
+
+// See EvictionPolicy.h
+void SlabLruPolicy::Release(LinkedList::Entry *e) {
+    if (e == _victim) {
+        _classes[e->state].window_evicted++;
+        _classes[e->state].evicted++;
+        _victim = nullptr;
+    }
+    Unlink(e);
+}
+
+// See EvictionPolicy.h
+LinkedList::Entry *SlabLruPolicy::Rebalance(time_t now) {
+    if (now != _scan_time) {
+        _scan_time = now;
+        _scanned = 0;
+    }
+    if (now >= _window_end) {
+        if (_window_end != 0) {
+            CloseWindow();
+        }
+        _window_end = now + WINDOW;
+    }
+
+    while (_move_page != nullptr && _scanned < SCAN_LIMIT) {
+        LinkedList::Entry *e = _cursor;
+        if (e == nullptr) {
+            // Whole class is scanned, page is free unless some new entry took its chunk after the cursor
+            _move_page = nullptr;
+            _pages_moved++;
+            break;
+        }
+
+        _cursor = _classes[_move_class].list.Prev(e);
+        _scanned++;
+        if (Allocator::Slab::page_of(e->chunk()) == _move_page) {
+            return e;
+        }
+    }
+    return nullptr;
+}
+
+// See EvictionPolicy.h
+void SlabLruPolicy::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    EvictionPolicy::Stats(stats);
+    stats.emplace_back("slab_lru_pages_moved", std::to_string(_pages_moved));
+    for (size_t cls = 0; cls < _n_classes; cls++) {
+        const Class &c = _classes[cls];
+        if (c.items == 0 && c.evicted == 0) {
+            continue;
+        }
+        std::string prefix = "slab_lru_" + std::to_string(cls) + ":";
+        stats.emplace_back(prefix + "items", std::to_string(c.items));
+        stats.emplace_back(prefix + "evicted", std::to_string(c.evicted));
+    }
+}
+
+void SlabLruPolicy::Unlink(LinkedList::Entry *e) {
+    Class &c = _classes[e->state];
+    if (e == _cursor) {
+        _cursor = c.list.Prev(e);
+    }
+    c.list.Unlink(e);
+    c.items--;
+}
+
+void SlabLruPolicy::CloseWindow() {
+    // Blocks bigger than slab chunks are mapped one by one, there are no pages to move
+    size_t slab_classes = _n_classes - 1;
+
+    size_t top = slab_classes;
+    size_t most = 0;
+    for (size_t cls = 0; cls < slab_classes; cls++) {
+        if (_classes[cls].window_evicted > most) {
+            most = _classes[cls].window_evicted;
+            top = cls;
+        }
+    }
+
+    for (size_t cls = 0; cls < slab_classes; cls++) {
+        Class &c = _classes[cls];
+        c.idle = c.window_evicted == 0 ? c.idle + 1 : 0;
+        c.streak = cls == top ? c.streak + 1 : 0;
+        c.window_evicted = 0;
+    }
+    _classes[slab_classes].window_evicted = 0;
+
+    if (top == slab_classes || _classes[top].streak < STREAK || _move_page != nullptr) {
+        return;
+    }
+
+    // Page is taken from the idle class holding the most memory
+    size_t from = slab_classes;
+    size_t bytes = 0;
+    for (size_t cls = 0; cls < slab_classes; cls++) {
+        Class &c = _classes[cls];
+        if (c.idle >= STREAK && c.items * c.chunk > bytes) {
+            bytes = c.items * c.chunk;
+            from = cls;
+        }
+    }
+    if (from == slab_classes) {
+        return;
+    }
+
+    _classes[top].streak = 0;
+    _move_class = from;
+    _cursor = _classes[from].list.Tail();
+    _move_page = Allocator::Slab::page_of(_cursor->chunk());
+}
+
+} // namespace Backend
+} // namespace Afina
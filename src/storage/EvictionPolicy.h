@@ -0,0 +1,304 @@
+#ifndef AFINA_STORAGE_EVICTION_POLICY_H
+#define AFINA_STORAGE_EVICTION_POLICY_H
+
+#include <ctime>
+#include <memory>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <afina/Metadata.h>
+
+#include "LinkedList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Eviction policy
+ * Owns storage entries and decides which one goes away once storage runs out of space.
+ * Interface mirrors LinkedList one, so storage tells policy about every entry created,
+ * accessed and deleted and asks for the victim. Policy is never called concurrently, storage
+ * serializes access the same way it does for its index
+ */
+class EvictionPolicy {
+public:
+    enum class Type {
+        // Strict LRU: every access moves entry to the head of the list
+        Lru,
+        // Segmented LRU: new entries go to the probation segment and get promoted to the
+        // protected one on the second access, so single scan can't flush hot entries
+        SegmentedLru,
+        // CLOCK: access only sets the reference bit, victim is searched by the hand moving
+        // over the entries and giving referenced ones second chance
+        Clock,
+        // LRU per slab class, memory is moved between classes by pages, see SlabLruPolicy
+        SlabLru
+    };
+
+    virtual ~EvictionPolicy() {}
+
+    /**
+     * Creates new entry and starts tracking it
+     */
+    virtual LinkedList::Entry *Put(const std::string &key, const std::string &value, const Metadata &meta) = 0;
+
+    /**
+     * Entry has been read or updated
+     */
+    virtual void Up(LinkedList::Entry *e) = 0;
+
+    /**
+     * Entry that should be evicted next. Storage must have at least one entry
+     */
+    virtual LinkedList::Entry *Tail() = 0;
+
+    /**
+     * Stops tracking entry without destroying it, caller owns the entry then
+     */
+    virtual void Release(LinkedList::Entry *e) = 0;
+
+    /**
+     * Stops tracking entry and destroys it
+     */
+    void Delete(LinkedList::Entry *e) {
+        Release(e);
+        delete e;
+    }
+
+    /**
+     * Entry to delete so that memory moves to where it is needed, nullptr if there is nothing to move
+     * right now. Storage calls it in background once a second and deletes entries returned by small
+     * batches until it gets nullptr, policy limits the work done per call of each second, so requests
+     * never wait for a big move to complete
+     */
+    virtual LinkedList::Entry *Rebalance(time_t /*now*/) { return nullptr; }
+
+    /**
+     * Short name of the policy, the one ParseType accepts
+     */
+    virtual const char *Name() const = 0;
+
+    /**
+     * Policy specific metrics, see Afina::Storage::Stats
+     */
+    virtual void Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+        stats.emplace_back("eviction_policy", Name());
+    }
+
+    /**
+     * Builds policy of the given type
+     */
+    static std::unique_ptr<EvictionPolicy> Create(Type type);
+
+    /**
+     * Parses policy type name: "lru", "slru", "clock" or "slab". Throws std::invalid_argument if
+     * name is unknown
+     */
+    static Type ParseType(const std::string &name);
+};
+
+/**
+ * # Strict LRU
+ */
+class LruPolicy : public EvictionPolicy {
+public:
+    // See EvictionPolicy.h
+    LinkedList::Entry *Put(const std::string &key, const std::string &value, const Metadata &meta) override {
+        return _list.Put(key, value, meta);
+    }
+
+    // See EvictionPolicy.h
+    void Up(LinkedList::Entry *e) override { _list.Up(e); }
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Tail() override { return _list.Tail(); }
+
+    // See EvictionPolicy.h
+    void Release(LinkedList::Entry *e) override { _list.Unlink(e); }
+
+    // See EvictionPolicy.h
+    const char *Name() const override { return "lru"; }
+
+private:
+    LinkedList _list;
+};
+
+/**
+ * # Segmented LRU
+ * Entries live in one of two LRU lists. New entries get to the probation list, entries accessed
+ * again are promoted to the protected one. Once storage is full protected list holds at most
+ * protected_percent of all entries, its tail is demoted back to the probation head on overflow.
+ * Victims are taken from the probation list first, so keys touched once by a scan are evicted
+ * before the hot ones
+ */
+class SegmentedLruPolicy : public EvictionPolicy {
+public:
+    SegmentedLruPolicy(unsigned protected_percent = 80)
+        : _protected_percent(protected_percent), _probation_size(0), _protected_size(0) {}
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // See EvictionPolicy.h
+    void Up(LinkedList::Entry *e) override;
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Tail() override;
+
+    // See EvictionPolicy.h
+    void Release(LinkedList::Entry *e) override;
+
+    // See EvictionPolicy.h
+    const char *Name() const override { return "slru"; }
+
+    // See EvictionPolicy.h
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+private:
+    enum Segment : uint8_t { Probation = 0, Protected = 1 };
+
+    const unsigned _protected_percent;
+
+    LinkedList _probation;
+    size_t _probation_size;
+
+    LinkedList _protected;
+    size_t _protected_size;
+};
+
+/**
+ * # CLOCK
+ * Entries are kept in a ring in the insertion order. Access only sets reference bit of the entry,
+ * so reads don't touch list pointers at all. Hand walks the ring from the oldest entries to the
+ * newest ones, clears reference bits on its way and stops at the first entry that hasn't been
+ * referenced since the previous turn
+ */
+class ClockPolicy : public EvictionPolicy {
+public:
+    ClockPolicy() : _hand(nullptr) {}
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Put(const std::string &key, const std::string &value, const Metadata &meta) override {
+        return _list.Put(key, value, meta);
+    }
+
+    // See EvictionPolicy.h
+    void Up(LinkedList::Entry *e) override { e->state = 1; }
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Tail() override;
+
+    // See EvictionPolicy.h
+    void Release(LinkedList::Entry *e) override;
+
+    // See EvictionPolicy.h
+    const char *Name() const override { return "clock"; }
+
+private:
+    // Next entry to be examined, nullptr means the oldest one
+    LinkedList::Entry *_hand;
+    LinkedList _list;
+};
+
+/**
+ * # LRU per slab class
+ * Entries are sorted into the LRU lists by the slab class of their largest chunk, see
+ * LinkedList::Entry::chunk_class. Victim is taken from the class of the entry put or grown last, so
+ * the class that needs memory pays for it with its own old entries. Thus pages slab gave to the class
+ * stay with it no matter how the sizes of the values change, that is what Rebalance is for.
+ *
+ * Evictions are counted per class over windows of WINDOW seconds. Once some class is evicted the most
+ * for STREAK windows in a row, and some other class had no evictions for that long, page of the idle
+ * class is cleared: entries with chunks in the page of its LRU tail are deleted, so the page goes back
+ * to the slab and could be taken by the class under pressure. Class list is scanned from the tail,
+ * SCAN_LIMIT entries a second at most, entries that were put into the page meanwhile are cleared as
+ * long as the scan hasn't passed them
+ */
+class SlabLruPolicy : public EvictionPolicy {
+public:
+    // Evictions are counted over windows of this many seconds
+    static constexpr time_t WINDOW = 10;
+
+    // Windows in a row class must be evicted the most to get a page, and the other class must have no
+    // evictions to give it
+    static constexpr unsigned STREAK = 3;
+
+    // Entries looked through by Rebalance each second
+    static constexpr size_t SCAN_LIMIT = 4096;
+
+    SlabLruPolicy();
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // See EvictionPolicy.h
+    void Up(LinkedList::Entry *e) override;
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Tail() override;
+
+    // See EvictionPolicy.h
+    void Release(LinkedList::Entry *e) override;
+
+    // See EvictionPolicy.h
+    LinkedList::Entry *Rebalance(time_t now) override;
+
+    // See EvictionPolicy.h
+    const char *Name() const override { return "slab"; }
+
+    // See EvictionPolicy.h
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+private:
+    struct Class {
+        Class() : chunk(0), items(0), window_evicted(0), evicted(0), streak(0), idle(0) {}
+
+        LinkedList list;
+
+        // Chunk size, so that items * chunk is the memory class holds
+        size_t chunk;
+        size_t items;
+
+        // Evictions in the current window and overall
+        size_t window_evicted;
+        size_t evicted;
+
+        // Windows in a row class was evicted the most, and had no evictions at all
+        unsigned streak;
+        unsigned idle;
+    };
+
+    // Entry is kept in the list of its class, class number is stored in the entry state
+    void Unlink(LinkedList::Entry *e);
+
+    // Counts evictions of the closed window and starts a page move if one is due
+    void CloseWindow();
+
+    // Slab classes and one more for the blocks bigger than slab chunks, those are never moved
+    const size_t _n_classes;
+    std::unique_ptr<Class[]> _classes;
+
+    // Class of the entry put or grown last
+    size_t _pressure;
+
+    // Entry returned by Tail, evicted unless storage decides otherwise
+    LinkedList::Entry *_victim;
+
+    time_t _window_end;
+
+    // Second the scan budget is counted for and entries scanned during it
+    time_t _scan_time;
+    size_t _scanned;
+
+    // Class and page being cleared, next entry to look at. Page is nullptr if there is no move going on
+    size_t _move_class;
+    const void *_move_page;
+    LinkedList::Entry *_cursor;
+    size_t _pages_moved;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_EVICTION_POLICY_H
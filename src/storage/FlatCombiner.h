@@ -1,9 +1,18 @@
 #pragma once
 
-#include <functional>
+#include <algorithm>
 #include <atomic>
 #include <cassert>
-#include <iostream>
+#include <cstdint>
+#include <functional>
+#include <mutex>
+#include <unordered_set>
+#include <vector>
+
+#include <linux/futex.h>
+#include <sched.h>
+#include <sys/syscall.h>
+#include <unistd.h>
 
 #include "ThreadLocal.h"
 
@@ -11,17 +20,15 @@
  * Create new flat combine synchronizaion primitive
  *
  * @template_param OpNode
- * Class for a single pending operation descriptor. Must provides following API:
- * - complete() returns true is operation gets completed and false otherwise
- * - error(const std::exception &ex) set operation as failed. After this call return,
- *   subsequent calls to complete() method must return true
- *
- * @template_param QMS
- * Maximum array size that could be passed to a single Combine function call
+ * Class for a single pending operation descriptor. Combine function receives array of slots
+ * with pending operations, once it returns all passed operations are considered as complete
+ * and owning threads get released. OpNode must be a plain object which could be default
+ * constructed
  */
-template <typename OpNode, std::size_t QMS = 64> class FlatCombiner {
-    struct Slot;
+template <typename OpNode> class FlatCombiner {
 public:
+    struct Slot;
+
     // User defined type for the pending operations description, must be plain object without
     // virtual functions
     using pending_operation = OpNode;
@@ -29,18 +36,80 @@ public:
     // Function that combine multiple operations and apply it onto data structure
     using combiner = std::function<void(Slot **, Slot **)>;
 
-    // Maximum number of pernding operations could be passed to a single Combine call
-    static const std::size_t max_call_size = QMS;
-    
+    /**
+     * Runtime parameters of the flat combine algorithm
+     */
+    struct Options {
+        // Maximum number of pending operations could be passed to a single Combine call
+        std::size_t max_call_size;
+
+        // Number of combine passes slot could stay unused in the queue before it gets
+        // removed from there. Thread will put slot back on the next operation
+        uint64_t cleanup_horizon;
+
+        // How many times waiting thread checks its slot in a busy loop before give CPU up
+        std::size_t spin_iterations;
+
+        // How many times waiting thread calls sched_yield before park on futex
+        std::size_t yield_iterations;
+
+        Options() : max_call_size(64), cleanup_horizon(5), spin_iterations(512), yield_iterations(4) {}
+    };
+
+    /**
+     * Counters collected since flat combiner creation
+     */
+    struct Stats {
+        // Number of Combine calls
+        uint64_t passes;
+
+        // Total number of operations passed to Combine calls
+        uint64_t operations;
+
+        // Biggest number of operations passed to a single Combine call
+        uint64_t max_pass;
+
+        // How many times combiner role was handed over to a parked thread
+        uint64_t handoffs;
+
+        // How many times waiting thread was parked on futex
+        uint64_t parks;
+    };
+
     /**
      * @param Combine function that aplly pending operations onto some data structure. It accepts array
      * of pending ops and allowed to modify it in any way except delete pointers
+     * @param options tuning parameters, see Options
      */
-    FlatCombiner(std::function<void(Slot **, Slot **)> combine) : _slot(nullptr, Destructor), _combine(combine) {
-        _header.next_and_alive.store((uint64_t) &_header, std::memory_order_relaxed);
+    FlatCombiner(combiner combine, const Options &options = Options())
+        : _options(options), _combine(combine), _combine_shot(std::max<std::size_t>(options.max_call_size, 1)),
+          _slot(nullptr, Destructor), _parked(0), _passes(0), _operations(0), _max_pass(0), _handoffs(0),
+          _parks(0) {
+        _header.next_and_alive.store((uint64_t)&_header, std::memory_order_relaxed);
+        _header.state.store(kDone, std::memory_order_relaxed);
         _lock.store(0);
     }
-    ~FlatCombiner() { /* dequeue all slot, think about slot deletition */ }
+
+    /**
+     * Combiner must not be used by any thread once destruction begins. Slots of the threads which
+     * are still alive are deleted here as well, the thread local key is released right after that
+     * so exiting threads don't touch them anymore
+     */
+    ~FlatCombiner() {
+        std::unordered_set<Slot *> slots;
+        {
+            std::lock_guard<std::mutex> lock(_slots_mutex);
+            slots.swap(_slots);
+        }
+
+        for (Slot *current = _header.next(); current != &_header; current = current->next()) {
+            slots.insert(current);
+        }
+
+        for (Slot *slot : slots) {
+            delete slot;
+        }
+    }
 
     /**
      * Return pending operation slot to the calling thread, object stays valid as long
@@ -50,8 +119,15 @@ public:
         Slot *result = _slot.get();
         if (result == nullptr) {
             result = new Slot();
-            // TODO: setup usage bit in the pointer
-            // result->next_and_alive.store(LCK_BIT_MASK);
+            result->owner = this;
+            result->generation = 0;
+            result->next_and_alive.store(Slot::ALV_MASK, std::memory_order_relaxed);
+            result->state.store(kDone, std::memory_order_relaxed);
+
+            {
+                std::lock_guard<std::mutex> lock(_slots_mutex);
+                _slots.insert(result);
+            }
             _slot.set(result);
         }
 
@@ -60,60 +136,51 @@ public:
 
     /**
      * Put pending operation in the queue and try to execute it. Method gets blocked until
-     * slot gets complete, in other words until slot.complete() returns false
+     * operation in the slot gets complete, either by the calling thread or by some other
+     * thread that has been acquired combiner role
      */
     void apply_slot(Slot &slot) {
-        // TODO: assert slot params
-        // TODO: enqueue slot if needs
-        // TODO: try to become executor (cquire lock)
-        // TODO: scan qeue, dequeue stale nodes, prepare array to be passed
-        // to Combine call
-        // TODO: call Combine function
-        // TODO: unlock
-        // TODO: if lock fails, do thread_yeild and goto 3 TODO
-        
-        slot.done.store(false, std::memory_order_release);
-
-        while (!slot.done.load(std::memory_order_acquire)) {
+        assert(slot.owner == this);
+
+        // Cleanup could be removing slot from the queue right now, wait until it finishes so
+        // that the check below sees the final queue membership
+        uint32_t expected = kDone;
+        while (!slot.state.compare_exchange_weak(expected, kPending, std::memory_order_acq_rel,
+                                                 std::memory_order_relaxed)) {
+            expected = kDone;
+            cpu_relax();
+        }
+
+        std::size_t spins = 0;
+        std::size_t yields = 0;
+        while (slot.state.load(std::memory_order_acquire) != kDone) {
+            // Slot could be removed from the queue by cleanup, put it back
             if (!(slot.next_and_alive.load(std::memory_order_relaxed) & Slot::PTR_MASK)) {
-                auto head = _header.next_and_alive.load(std::memory_order_relaxed);
-                do {
-                    slot.next_and_alive.store((uint64_t)head | Slot::ALV_MASK, std::memory_order_relaxed);
-                } while(!_header.next_and_alive.compare_exchange_weak(head, (uint64_t) &slot,
-                    std::memory_order_release, std::memory_order_relaxed));
+                enqueue_slot(slot);
             }
 
             uint64_t gen = try_lock(std::memory_order_acquire, std::memory_order_relaxed);
             if (gen) {
-                gen++;
-                size_t combine_size = 0;
-                auto current_slot = _header.next();
-                while (current_slot != &_header) {
-                    if ((!current_slot->done.load(std::memory_order_acquire)) && (combine_size < QMS)) { // even consume would work
-                        _combine_shot[combine_size++] = current_slot;
-                        current_slot->generation = gen;
-                    }
-                    current_slot = current_slot->next();
-                }
+                combine_pass(slot, gen);
+                unlock_and_handoff();
+                continue;
+            }
 
-                _combine(&_combine_shot.front(), &_combine_shot.front() + combine_size);
-
-                // cleanup
-                auto parent = _header.next();
-                current_slot = parent->next();
-                while (current_slot != &_header) {
-                    if ((current_slot->generation + 5) < gen) {
-                        auto next = current_slot->next();
-                        dequeue_slot(parent, current_slot);
-                        current_slot = next;
-                    } else {
-                        parent = current_slot;
-                        current_slot = current_slot->next();
-                    }
-                }
-                unlock(std::memory_order_release, std::memory_order_relaxed);
+            // Some other thread is the combiner now and most likely will complete our operation
+            // soon, wait for it: spin first, then give CPU up, park on futex at the end
+            if (spins < _options.spin_iterations) {
+                spins++;
+                cpu_relax();
+            } else if (yields < _options.yield_iterations) {
+                yields++;
+                sched_yield();
             } else {
-                pthread_yield();
+                if (park(slot)) {
+                    // Combiner role has been handed over along with the lock
+                    combine_pass(slot, (_lock.load(std::memory_order_relaxed) & GEN_VAL_MASK) + 1);
+                    unlock_and_handoff();
+                }
+                spins = yields = 0;
             }
         }
     }
@@ -123,16 +190,29 @@ public:
      * destroy thread slot in the queue
      */
     void detach() {
-        pending_operation *result = _slot.get();
-        if (result != nullptr) { // do we really need check this
+        Slot *result = _slot.get();
+        if (result != nullptr) {
             _slot.set(nullptr);
+            orphan_slot(result);
         }
-        orphan_slot(result);
+    }
+
+    /**
+     * Snapshot of the flat combiner counters
+     */
+    Stats stats() const {
+        Stats result;
+        result.passes = _passes.load(std::memory_order_relaxed);
+        result.operations = _operations.load(std::memory_order_relaxed);
+        result.max_pass = _max_pass.load(std::memory_order_relaxed);
+        result.handoffs = _handoffs.load(std::memory_order_relaxed);
+        result.parks = _parks.load(std::memory_order_relaxed);
+        return result;
     }
 
     // Extend user provided pending operation type with fields required for the
     // flat combine algorithm to work
-    using Slot = struct Slot {
+    struct Slot {
         static constexpr uint64_t ALV_MASK = uint64_t(1) << 63L;
         static constexpr uint64_t PTR_MASK = uint64_t(-1) >> 16L;
         static constexpr uint64_t DAT_MASK = ~(PTR_MASK);
@@ -142,6 +222,9 @@ public:
         // When last time this slot was detected as been in use
         uint64_t generation;
 
+        // Combiner this slot belongs to
+        FlatCombiner *owner;
+
         // Pointer to the next slot. One bit of pointer is stolen to
         // mark if owner thread is still alive, based on this information
         // combiner/thread_local destructor able to take decission about
@@ -153,20 +236,33 @@ public:
         // link left and slot could be deleted
         std::atomic<uint64_t> next_and_alive;
 
-        std::atomic<bool> done;
+        // Operation state, one of kPending, kParked, kHandoff, kDone or kRemoving. Also used as a
+        // futex word by parked owner
+        std::atomic<uint32_t> state;
 
         /**
          * Remove alive bit from the next_and_alive pointer and return
          * only correct pointer to the next slot
          */
-        Slot *next() {
-            // TODO: implement
-            Slot *res = (Slot*)(next_and_alive.load(std::memory_order_relaxed) & PTR_MASK);
-            return res;
-        }
+        Slot *next() { return (Slot *)(next_and_alive.load(std::memory_order_relaxed) & PTR_MASK); }
     };
 
 protected:
+    // Operation is waiting in the queue, owner thread is running
+    static constexpr uint32_t kPending = 0;
+
+    // Operation is waiting in the queue, owner thread sleeps on the state futex
+    static constexpr uint32_t kParked = 1;
+
+    // Operation is waiting in the queue, owner thread has been given the lock and must become combiner
+    static constexpr uint32_t kHandoff = 2;
+
+    // Operation has been completed
+    static constexpr uint32_t kDone = 3;
+
+    // Slot is idle and combiner is removing it from the queue
+    static constexpr uint32_t kRemoving = 4;
+
     /**
      * Try to acquire "lock", in case of success returns current generation. If
      * fails the return 0
@@ -174,57 +270,65 @@ protected:
      * @param suc memory barier to set in case of success lock
      * @param fail memory barrier to set in case of failure
      */
-    uint64_t try_lock(std::memory_order suc = std::memory_order_seq_cst, std::memory_order fail = std::memory_order_seq_cst) {
-        // TODO: implements
-        uint64_t exp = 0;
-        uint64_t gen = 0;
-        uint64_t prev = 0;
-        bool succ = 0;
-        do {
-            prev = exp;
-            exp = gen & GEN_VAL_MASK;
-            succ = _lock.compare_exchange_strong(exp, LCK_BIT_MASK | gen, suc, fail);
-            gen = exp & GEN_VAL_MASK;
-        } while (!(succ || (prev == exp)));
-        return succ * (gen + 1);
+    uint64_t try_lock(std::memory_order suc = std::memory_order_seq_cst,
+                      std::memory_order fail = std::memory_order_seq_cst) {
+        uint64_t current = _lock.load(std::memory_order_relaxed);
+        if (current & LCK_BIT_MASK) {
+            return 0;
+        }
+
+        if (!_lock.compare_exchange_strong(current, current | LCK_BIT_MASK, suc, fail)) {
+            return 0;
+        }
+        return (current & GEN_VAL_MASK) + 1;
     }
 
     /**
-     * Try to release "lock". Increase generation number in case of sucess
-     *
-     * @param suc memory barier to set in case of success lock
-     * @param fail memory barrier to set in case of failure
+     * Release "lock". Increase generation number. Always sequentially consistent as parked
+     * threads rely on it to not miss wakeup
+     */
+    void unlock() {
+        uint64_t lock_value = _lock.load(std::memory_order_relaxed);
+        assert(lock_value & LCK_BIT_MASK);
+        _lock.store(((lock_value & GEN_VAL_MASK) + 1) & GEN_VAL_MASK, std::memory_order_seq_cst);
+    }
+
+    /**
+     * Put slot on the top of pending operations queue. Must be called only by the slot owner
+     * and only if slot isn't in the queue yet
      */
-    void unlock(std::memory_order suc = std::memory_order_seq_cst, std::memory_order fail = std::memory_order_seq_cst) {
-        // TODO: implements
-        auto lock_value = _lock.load(std::memory_order_relaxed);
-        auto exp = lock_value & GEN_VAL_MASK | LCK_BIT_MASK;
-        bool res = _lock.compare_exchange_strong(exp, (exp + 1) & GEN_VAL_MASK, suc, fail);
-        assert(res);
+    void enqueue_slot(Slot &slot) {
+        auto head = _header.next_and_alive.load(std::memory_order_relaxed);
+        do {
+            slot.next_and_alive.store((head & Slot::PTR_MASK) | Slot::ALV_MASK, std::memory_order_relaxed);
+        } while (!_header.next_and_alive.compare_exchange_weak(head, (uint64_t)&slot, std::memory_order_release,
+                                                              std::memory_order_relaxed));
     }
 
     /**
      * Remove slot from the queue. Note that method must be called only
      * under "lock" to eliminate concurrent queue modifications
      *
+     * @return true if slot has been deleted as its owner is already dead
      */
-    void dequeue_slot(Slot *parent, Slot *slot2remove) {
-        // TODO: remove node from the queue
-        // TODO: set pointer pare of "next" to null, DO NOT modify usage bit
-        // TODO: if next == 0, delete pointer
-
+    bool dequeue_slot(Slot *parent, Slot *slot2remove) {
         auto parent_naa = parent->next_and_alive.load(std::memory_order_relaxed);
         auto next_naa = slot2remove->next_and_alive.load(std::memory_order_relaxed);
         auto next_ptr = next_naa & Slot::PTR_MASK;
-        while (!parent->next_and_alive.compare_exchange_weak(parent_naa, (parent_naa & Slot::DAT_MASK) | next_ptr, 
-            std::memory_order_relaxed));
-        while (!slot2remove->next_and_alive.compare_exchange_weak(next_naa, next_naa & Slot::DAT_MASK, 
-            std::memory_order_relaxed));
-        if ((next_naa & Slot::DAT_MASK) == 0) {
-            // std::cout << "Slot may be deleted by dequeue_slot (";
-            // std::cout << std::hex << std::setfill('0') << std::setw(16) << next_naa << ")" << std::endl;
+        while (!parent->next_and_alive.compare_exchange_weak(parent_naa, (parent_naa & Slot::DAT_MASK) | next_ptr,
+                                                             std::memory_order_relaxed)) {
+        }
+
+        // Owner thread could concurrently clear alive bit, whoever is the last to
+        // drop its reference must delete slot
+        while (!slot2remove->next_and_alive.compare_exchange_weak(next_naa, next_naa & Slot::DAT_MASK,
+                                                                  std::memory_order_acq_rel)) {
+        }
+        if ((next_naa & Slot::ALV_MASK) == 0) {
             delete slot2remove;
+            return true;
         }
+        return false;
     }
 
     /**
@@ -233,12 +337,175 @@ protected:
      *
      * @param Slot pointer to the slot is being to orphan
      */
-    void orphan_slot(Slot *) {}
+    void orphan_slot(Slot *slot) {
+        {
+            std::lock_guard<std::mutex> lock(_slots_mutex);
+            _slots.erase(slot);
+        }
+
+        // Queue could concurrently drop its reference, whoever is the last must
+        // delete slot
+        auto slot_naa = slot->next_and_alive.load(std::memory_order_relaxed);
+        while (!slot->next_and_alive.compare_exchange_weak(slot_naa, slot_naa & Slot::PTR_MASK,
+                                                           std::memory_order_acq_rel)) {
+        }
+        if ((slot_naa & Slot::PTR_MASK) == 0) {
+            delete slot;
+        }
+    }
 
 private:
     static constexpr uint64_t LCK_BIT_MASK = uint64_t(1) << 63L;
     static constexpr uint64_t GEN_VAL_MASK = ~LCK_BIT_MASK;
 
+    /**
+     * Executed under the "lock": collect pending operations, pass them to the combine function,
+     * release waiters and remove stale slots from the queue. Slot of the calling thread always
+     * goes first, so combiner itself is guaranteed to make progress
+     */
+    void combine_pass(Slot &own, uint64_t gen) {
+        std::size_t combine_size = 0;
+        if (own.state.load(std::memory_order_acquire) != kDone) {
+            _combine_shot[combine_size++] = &own;
+            own.generation = gen;
+        }
+
+        for (Slot *current = _header.next(); current != &_header && combine_size < _combine_shot.size();
+             current = current->next()) {
+            if (current != &own && current->state.load(std::memory_order_acquire) != kDone) {
+                _combine_shot[combine_size++] = current;
+                current->generation = gen;
+            }
+        }
+
+        if (combine_size > 0) {
+            _combine(&_combine_shot.front(), &_combine_shot.front() + combine_size);
+
+            for (std::size_t i = 0; i < combine_size; i++) {
+                complete(_combine_shot[i]);
+            }
+
+            _passes.fetch_add(1, std::memory_order_relaxed);
+            _operations.fetch_add(combine_size, std::memory_order_relaxed);
+            if (combine_size > _max_pass.load(std::memory_order_relaxed)) {
+                _max_pass.store(combine_size, std::memory_order_relaxed);
+            }
+        }
+
+        // Cleanup: slots of dead threads and slots that haven't been used for a while. First slot
+        // is never touched as pushes to the queue head could happen concurrently
+        Slot *parent = _header.next();
+        Slot *current = parent->next();
+        while (current != &_header) {
+            Slot *next = current->next();
+            bool alive = current->next_and_alive.load(std::memory_order_relaxed) & Slot::ALV_MASK;
+            bool stale = (current->generation + _options.cleanup_horizon) < gen;
+            uint32_t expected = kDone;
+            if ((!alive || stale) && current->state.compare_exchange_strong(expected, kRemoving,
+                                                                            std::memory_order_acq_rel)) {
+                if (!dequeue_slot(parent, current)) {
+                    current->state.store(kDone, std::memory_order_release);
+                }
+            } else {
+                parent = current;
+            }
+            current = next;
+        }
+    }
+
+    /**
+     * Mark operation as done and wake owner up if it sleeps
+     */
+    void complete(Slot *slot) {
+        if (slot->state.exchange(kDone, std::memory_order_acq_rel) == kParked) {
+            _parked.fetch_sub(1, std::memory_order_seq_cst);
+            futex_wake(slot->state);
+        }
+    }
+
+    /**
+     * Release "lock". If there are threads parked then no one else would try to acquire lock
+     * on their behalf, so pass combiner role to one of them. The lock itself is passed along
+     * with the role and never gets released in between, so woken thread couldn't miss it
+     */
+    void unlock_and_handoff() {
+        for (;;) {
+            if (_parked.load(std::memory_order_seq_cst) != 0) {
+                for (Slot *current = _header.next(); current != &_header; current = current->next()) {
+                    uint32_t expected = kParked;
+                    if (current->state.compare_exchange_strong(expected, kHandoff, std::memory_order_acq_rel)) {
+                        _parked.fetch_sub(1, std::memory_order_seq_cst);
+                        futex_wake(current->state);
+                        _handoffs.fetch_add(1, std::memory_order_relaxed);
+                        return;
+                    }
+                }
+            }
+
+            unlock();
+            if (_parked.load(std::memory_order_seq_cst) == 0) {
+                return;
+            }
+
+            // Current lock owner will take care about parked threads
+            if (!try_lock()) {
+                return;
+            }
+        }
+    }
+
+    /**
+     * Sleep on the slot futex until operation gets done or thread is asked to become the combiner
+     *
+     * @return true if combiner role has been handed over to the calling thread, lock is held then
+     */
+    bool park(Slot &slot) {
+        // Pairs with unlock_and_handoff: either combiner sees the counter or we see the lock released.
+        // Counter is decremented by whoever takes slot out of the parked state
+        _parked.fetch_add(1, std::memory_order_seq_cst);
+
+        uint32_t expected = kPending;
+        if (!slot.state.compare_exchange_strong(expected, kParked, std::memory_order_seq_cst)) {
+            _parked.fetch_sub(1, std::memory_order_seq_cst);
+            return false;
+        }
+
+        if ((_lock.load(std::memory_order_seq_cst) & LCK_BIT_MASK) == 0) {
+            expected = kParked;
+            if (slot.state.compare_exchange_strong(expected, kPending, std::memory_order_acq_rel)) {
+                _parked.fetch_sub(1, std::memory_order_seq_cst);
+                return false;
+            }
+            return expected == kHandoff;
+        }
+
+        _parks.fetch_add(1, std::memory_order_relaxed);
+        uint32_t state;
+        while ((state = slot.state.load(std::memory_order_acquire)) == kParked) {
+            futex_wait(slot.state, kParked);
+        }
+        return state == kHandoff;
+    }
+
+    static void futex_wait(std::atomic<uint32_t> &word, uint32_t expected) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAIT_PRIVATE, expected, nullptr, nullptr, 0);
+    }
+
+    static void futex_wake(std::atomic<uint32_t> &word) {
+        syscall(SYS_futex, reinterpret_cast<uint32_t *>(&word), FUTEX_WAKE_PRIVATE, 1, nullptr, nullptr, 0);
+    }
+
+    static inline void cpu_relax() {
+#if defined(__x86_64__) || defined(__i386__)
+        __builtin_ia32_pause();
+#elif defined(__aarch64__)
+        asm volatile("yield" ::: "memory");
+#endif
+    }
+
+    // Tuning parameters
+    const Options _options;
+
     // First bit is used to see if lock is acquired already or no. Rest of bits is
     // a counter showing how many "generation" has been passed. One generation is a
     // single call of flat_combine function.
@@ -247,43 +514,41 @@ private:
     // operations queue
     std::atomic<uint64_t> _lock;
 
-    // Pending operations queue. Each operation to be applied to the protected
-    // data structure is ends up in this queue and then executed as a batch by
-    // flat_combine method call
-    // std::atomic<Slot *> _queue;
-    
     // Function to call in order to execute operations
     combiner _combine;
 
     // Usual strategy for the combine flat would be sort operations by some creteria
     // and optimize it somehow. That array is using by executor thread to prepare
     // number of ops to pass to combine
-    std::array<Slot *, QMS> _combine_shot;
+    std::vector<Slot *> _combine_shot;
 
     // Slot of the current thread. If nullptr then cur thread gets access in the
     // first time or after a long period when slot has been deleted already
     ThreadLocal<Slot> _slot;
 
+    // All slots owned by alive threads, whenever they are in the queue or not. Used
+    // to release slots of threads that outlive combiner
+    std::mutex _slots_mutex;
+    std::unordered_set<Slot *> _slots;
+
     // This slot is pointing to the first element in the list of pending operations.
     // Last slot in the list of pending operations should point to this slot
     // instead of having nullptr. Having nullptr means being extracted from the
     // list of pending operation
     Slot _header;
 
-    static void Destructor(void *arg) {
-        Slot* slot = static_cast<Slot*>(arg);
+    // Number of threads parked or about to park on their slots futex
+    std::atomic<uint32_t> _parked;
 
-        auto slot_naa = slot->next_and_alive.load(std::memory_order_relaxed);
-        while (!slot->next_and_alive.compare_exchange_weak(slot_naa, slot_naa & Slot::PTR_MASK), 
-            std::memory_order_relaxed, std::memory_order_relaxed);
-        if ((slot_naa & Slot::PTR_MASK) == 0) {
-            // std::cout << "Slot may be deleted by Destructor (" << std::hex << slot_naa << ")" << std::endl;
-            delete slot;
-        }
+    // Counters, see Stats
+    std::atomic<uint64_t> _passes;
+    std::atomic<uint64_t> _operations;
+    std::atomic<uint64_t> _max_pass;
+    std::atomic<uint64_t> _handoffs;
+    std::atomic<uint64_t> _parks;
+
+    static void Destructor(void *arg) {
+        Slot *slot = static_cast<Slot *>(arg);
+        slot->owner->orphan_slot(slot);
     }
 };
-
-
-
-
-
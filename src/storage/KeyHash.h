@@ -0,0 +1,67 @@
+#ifndef AFINA_STORAGE_KEY_HASH_H
+#define AFINA_STORAGE_KEY_HASH_H
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * Hash of the key bytes, 64-bit MurmurHash2. Entries keep keys as raw bytes, so indexes hash those
+ * and not std::string. All bits are mixed well, indexes could take any of them
+ */
+inline uint64_t KeyHash(const char *data, size_t size) {
+    const uint64_t m = 0xc6a4a7935bd1e995ULL;
+    const int r = 47;
+
+    uint64_t h = 0x5bd1e9955bd1e995ULL ^ (size * m);
+    const char *end = data + (size & ~size_t(7));
+    for (; data != end; data += 8) {
+        uint64_t k;
+        std::memcpy(&k, data, 8);
+        k *= m;
+        k ^= k >> r;
+        k *= m;
+        h ^= k;
+        h *= m;
+    }
+
+    switch (size & 7) {
+    case 7:
+        h ^= uint64_t(uint8_t(data[6])) << 48;
+        // fallthrough
+    case 6:
+        h ^= uint64_t(uint8_t(data[5])) << 40;
+        // fallthrough
+    case 5:
+        h ^= uint64_t(uint8_t(data[4])) << 32;
+        // fallthrough
+    case 4:
+        h ^= uint64_t(uint8_t(data[3])) << 24;
+        // fallthrough
+    case 3:
+        h ^= uint64_t(uint8_t(data[2])) << 16;
+        // fallthrough
+    case 2:
+        h ^= uint64_t(uint8_t(data[1])) << 8;
+        // fallthrough
+    case 1:
+        h ^= uint64_t(uint8_t(data[0]));
+        h *= m;
+    }
+
+    h ^= h >> r;
+    h *= m;
+    h ^= h >> r;
+    return h;
+}
+
+inline uint64_t KeyHash(const std::string &key) { return KeyHash(key.data(), key.size()); }
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_KEY_HASH_H
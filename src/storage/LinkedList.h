@@ -1,8 +1,21 @@
 #ifndef AFINA_STORAGE_LINKED_LIST_H
 #define AFINA_STORAGE_LINKED_LIST_H
 
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <memory>
+#include <new>
 #include <string>
 
+#include <afina/Metadata.h>
+#include <afina/Value.h>
+#include <afina/allocator/StlAllocator.h>
+
+#include "KeyHash.h"
+
 namespace Afina {
 namespace Backend {
 
@@ -29,10 +42,24 @@ public:
         }
     }
 
-    Entry* Put(const std::string& key, const std::string& value) {
-        Entry* e = new Entry(key, value, header.next, &header);
-        header.next->prev = e;
-        header.next = e;
+    /**
+     * Arena entries and their value buffers come from, nullptr for the global heap. Shared by all the
+     * lists of the process, so that memory freed by one storage could be reused by another, see
+     * Allocator::DefaultArena
+     */
+    static Allocator::Slab* Memory() {
+        return Allocator::DefaultArena();
+    }
+
+    template <typename T>
+    using StlAllocator = Allocator::StlAllocator<T>;
+
+    // Bytes of the value kept out of the entry
+    using Buffer = std::basic_string<char, std::char_traits<char>, StlAllocator<char>>;
+
+    Entry* Put(const std::string& key, const std::string& value, const Metadata& meta = Metadata()) {
+        Entry* e = Entry::Create(key, value, meta);
+        Link(e);
         return e;
     }
 
@@ -51,34 +78,363 @@ public:
     }
 
     void Delete(Entry* e) {
+        Unlink(e);
+        delete e;
+    }
+
+    /**
+     * Puts existing entry to the head of the list, entry must not be in any list
+     */
+    void Link(Entry* e) {
+        e->next = header.next;
+        e->prev = &header;
+        header.next->prev = e;
+        header.next = e;
+    }
+
+    /**
+     * Takes entry out of the list without destroying it
+     */
+    void Unlink(Entry* e) {
         e->prev->next = e->next;
         e->next->prev = e->prev;
-        delete e;
     }
 
+    /**
+     * Entry that is closer to the head than the given one, nullptr if it is the head
+     */
+    Entry* Prev(Entry* e) const {
+        return e->prev != &header ? e->prev : nullptr;
+    }
+
+    bool Empty() const {
+        return header.next == &header;
+    }
+
+    /**
+     * Entry is a single chunk of Memory: fixed header followed by the key bytes and the value area. Small
+     * values are kept right in the value area, so the typical item costs one allocation. Values bigger
+     * than SMALL_VALUE live in a separate shared buffer and the value area holds a pointer to it:
+     * copying such a value out under the lock costs more than taking a reference, and readers could
+     * pin the buffer and send it without a copy.
+     *
+     * Value area never grows. Small value that doesn't fit into it anymore is moved into a buffer
+     */
     class Entry {
         friend class LinkedList;
+        friend class TimerWheel;
     public:
-        Entry(const std::string& key, const std::string& value, Entry* next, Entry* prev) : key(key), value(value), next(next), prev(prev) {}
+        // Values up to this size are kept inline
+        static constexpr size_t SMALL_VALUE = 256;
+
+        /**
+         * Allocates entry with copies of the key and value. Entry is destroyed with delete
+         */
+        static Entry* Create(const std::string& key, const std::string& value, const Metadata& meta) {
+            size_t area = ValueArea(value.size());
+            void* memory = StlAllocator<char>().allocate(sizeof(Entry) + KeyArea(key.size()) + area);
+            Entry* e = new (memory) Entry(key.size(), area, meta);
+            std::memcpy(e->key_bytes(), key.data(), key.size());
+            e->set_value(value.data(), value.size());
+            return e;
+        }
+
+        // Memory comes from Create, trailing bytes included
+        static void operator delete(void* p) {
+            StlAllocator<char>().deallocate(static_cast<char*>(p), 0);
+        }
+
+        ~Entry() {
+            if (_shared) {
+                shared().~shared_ptr();
+            }
+        }
+
+        Entry(const Entry&) = delete;
+        Entry& operator=(const Entry&) = delete;
+
+        // Flags, expiration time and version, kept inline
+        Metadata meta;
+
+        // Owned by the eviction policy, for example segment entry belongs to
+        uint8_t state;
+
+        /**
+         * Memory entry with the given key and value takes from the slab, see size()
+         */
+        static size_t Footprint(size_t key_size, size_t value_size) {
+            size_t result = Allocation(sizeof(Entry) + KeyArea(key_size) + ValueArea(value_size));
+            if (value_size > SMALL_VALUE) {
+                result += SharedFootprint(value_size);
+            }
+            return result;
+        }
+
+        /**
+         * Memory entry takes from the slab: chunks of the entry itself and of the value buffer if there
+         * is one. That is what storage budget is spent on
+         */
+        size_t size() const {
+            size_t result = Allocation(sizeof(Entry) + KeyArea(_key_size) + _value_area);
+            if (_shared) {
+                result += SharedFootprint(shared()->capacity());
+            }
+            return result;
+        }
+
+        /**
+         * Largest chunk of Memory entry holds: bytes of the value buffer if there is one, the entry itself
+         * otherwise. Entries are sorted into the slab classes and pages by it
+         */
+        const void* chunk() const {
+            return _shared ? static_cast<const void*>(shared()->data()) : this;
+        }
+
+        /**
+         * Slab class of the chunk(), see Allocator::Slab::class_of. All the entries are of the same class
+         * on the global heap
+         */
+        size_t chunk_class() const {
+            Allocator::Slab* arena = Memory();
+            if (arena == nullptr) {
+                return 0;
+            }
+            if (_shared) {
+                return arena->class_of(shared()->capacity() + 1);
+            }
+            return arena->class_of(sizeof(Entry) + KeyArea(_key_size) + _value_area);
+        }
+
+        bool expired(time_t now) const {
+            return meta.expired(now);
+        }
+
+        const char* key_data() const {
+            return key_bytes();
+        }
+
+        size_t key_size() const {
+            return _key_size;
+        }
+
+        /**
+         * Copy of the key, for the places that need it as a string
+         */
+        std::string key() const {
+            return std::string(key_bytes(), _key_size);
+        }
 
-        const std::string key;
-        std::string value;
+        bool has_key(const std::string& key) const {
+            return key.size() == _key_size && std::memcmp(key.data(), key_bytes(), _key_size) == 0;
+        }
+
+        uint64_t key_hash() const {
+            return KeyHash(key_bytes(), _key_size);
+        }
+
+        const char* value_data() const {
+            return _shared ? shared()->data() : value_bytes();
+        }
+
+        size_t value_size() const {
+            return _shared ? shared()->size() : _value_size;
+        }
+
+        /**
+         * Whether value is kept inline, so readers must copy it before the entry changes
+         */
+        bool small() const {
+            return !_shared;
+        }
+
+        void copy_value(std::string& out) const {
+            out.assign(value_data(), value_size());
+        }
+
+        /**
+         * Handle to the value that stays valid after the entry is changed or deleted. Shared buffer is
+         * referenced, small value is copied
+         */
+        Value pin_value() const {
+            if (_shared) {
+                return Value(shared(), shared()->data(), shared()->size());
+            }
+            return Value(std::make_shared<const std::string>(value_bytes(), _value_size));
+        }
+
+        void set_value(const std::string& value) {
+            set_value(value.data(), value.size());
+        }
+
+        /**
+         * Replaces value. Caller must hold exclusive access to the entry, inline bytes are overwritten
+         * in place. Shared buffer is never changed here, readers could refer to it
+         */
+        void set_value(const char* data, size_t size) {
+            if (size <= SMALL_VALUE && size <= _value_area) {
+                if (_shared) {
+                    shared().~shared_ptr();
+                    _shared = false;
+                }
+                std::memcpy(value_bytes(), data, size);
+                _value_size = size;
+                return;
+            }
+
+            set_shared(std::allocate_shared<Buffer>(StlAllocator<Buffer>(), data, size));
+        }
 
-        size_t size() {
-            return key.size() + value.size();
+        /**
+         * Adds data to the beginning or to the end of value
+         */
+        void Concat(const std::string& data, bool prepend) {
+            size_t size = value_size() + data.size();
+            if (!_shared && size <= _value_area) {
+                char* v = value_bytes();
+                if (prepend) {
+                    std::memmove(v + data.size(), v, _value_size);
+                    std::memcpy(v, data.data(), data.size());
+                } else {
+                    std::memcpy(v + _value_size, data.data(), data.size());
+                }
+                _value_size = size;
+                return;
+            }
+
+            Buffer& v = mutable_value(size);
+            if (prepend) {
+                v.insert(0, data.data(), data.size());
+            } else {
+                v.append(data.data(), data.size());
+            }
+        }
+
+        /**
+         * Treats value as decimal 64-bit unsigned integer and changes it by delta. Increment
+         * wraps around on overflow, decrement stops at zero
+         *
+         * @return false if value isn't a number, nothing is changed then
+         */
+        bool Increment(uint64_t delta, bool decrement, uint64_t& result) {
+            const char* v = value_data();
+            size_t size = value_size();
+            if (size == 0 || size > 20) {
+                return false;
+            }
+
+            uint64_t number = 0;
+            for (size_t i = 0; i < size; i++) {
+                if (v[i] < '0' || v[i] > '9') {
+                    return false;
+                }
+                uint64_t next = number * 10 + (v[i] - '0');
+                if (next / 10 != number) {
+                    return false;
+                }
+                number = next;
+            }
+
+            if (decrement) {
+                result = number > delta ? number - delta : 0;
+            } else {
+                result = number + delta;
+            }
+            set_value(std::to_string(result));
+            return true;
         }
 
     private:
-        Entry() : key("HEADER") {}
+        Entry() : state(0), _shared(false), _key_size(0), _value_size(0), _value_area(0), next(nullptr), prev(nullptr), timer_next(nullptr), timer_pprev(nullptr) {}
+
+        Entry(size_t key_size, size_t value_area, const Metadata& meta) : meta(meta), state(0), _shared(false), _key_size(key_size), _value_size(0), _value_area(value_area), next(nullptr), prev(nullptr), timer_next(nullptr), timer_pprev(nullptr) {}
+
+        // Value area is aligned to keep the buffer pointer there
+        static size_t KeyArea(size_t key_size) {
+            return (key_size + alignof(std::shared_ptr<Buffer>) - 1) & ~(alignof(std::shared_ptr<Buffer>) - 1);
+        }
+
+        static size_t ValueArea(size_t value_size) {
+            size_t area = value_size <= SMALL_VALUE ? KeyArea(value_size) : 0;
+            return std::max(area, sizeof(std::shared_ptr<Buffer>));
+        }
+
+        // Chunk the slab hands out for the request, heap overhead is unknown
+        static size_t Allocation(size_t size) {
+            Allocator::Slab* arena = Memory();
+            return arena != nullptr ? arena->chunk_size(size) : size;
+        }
+
+        // allocate_shared puts the string next to the reference counters, string bytes go separately
+        static size_t SharedFootprint(size_t capacity) {
+            return Allocation(sizeof(Buffer) + 2 * sizeof(void*)) + Allocation(capacity + 1);
+        }
+
+        char* key_bytes() const {
+            return reinterpret_cast<char*>(const_cast<Entry*>(this + 1));
+        }
+
+        char* value_bytes() const {
+            return key_bytes() + KeyArea(_key_size);
+        }
+
+        std::shared_ptr<Buffer>& shared() const {
+            return *reinterpret_cast<std::shared_ptr<Buffer>*>(value_bytes());
+        }
+
+        /**
+         * Value bytes that could be changed in place, small value is moved into a buffer first. Buffer
+         * is copied if any reader still holds a reference to it. Caller must hold exclusive access to
+         * the entry, so that no new references could appear meanwhile
+         *
+         * @param capacity number of bytes value is going to grow to, so that copy is done only once
+         */
+        Buffer& mutable_value(size_t capacity = 0) {
+            if (!_shared || shared().use_count() != 1) {
+                auto copy = std::allocate_shared<Buffer>(StlAllocator<Buffer>());
+                copy->reserve(std::max(capacity, value_size()));
+                copy->append(value_data(), value_size());
+                set_shared(std::move(copy));
+            } else {
+                // Last reader drops its reference with release semantics, make sure it is done
+                // with the bytes before they get overwritten
+                std::atomic_thread_fence(std::memory_order_acquire);
+            }
+            return *shared();
+        }
+
+        void set_shared(std::shared_ptr<Buffer> buffer) {
+            if (_shared) {
+                shared() = std::move(buffer);
+            } else {
+                new (value_bytes()) std::shared_ptr<Buffer>(std::move(buffer));
+                _shared = true;
+            }
+        }
+
+        // Whether value area holds pointer to the buffer rather than value bytes. Goes right
+        // after the public state, so that the header has no padding
+        bool _shared;
+
+        uint32_t _key_size;
+
+        // Size of the inline value, meaningless once value is moved into a buffer
+        uint32_t _value_size;
+        uint32_t _value_area;
 
         Entry* next;
         Entry* prev;
+
+        // Links in the TimerWheel slot, timer_pprev is nullptr if entry isn't scheduled
+        Entry* timer_next;
+        Entry** timer_pprev;
     };
 
 private:
-    Entry header = Entry();
+    Entry header;
 };
 
+static_assert(sizeof(void*) != 8 || sizeof(LinkedList::Entry) == 64, "Entry header must stay compact");
+
 } // namespace Backend
 } // namespace Afina
 
@@ -0,0 +1,144 @@
+#include "LockFreeIndex.h"
+
+#include <cstdlib>
+
+namespace Afina {
+namespace Backend {
+
+constexpr size_t LockFreeIndex::ENTRY_OVERHEAD;
+
+LinkedList::Entry *const LockFreeIndex::TOMBSTONE = reinterpret_cast<LinkedList::Entry *>(uintptr_t(1));
+
+LockFreeIndex::Table::Table(size_t capacity) : mask(capacity - 1), slots(capacity) {
+    // Atomics aren't initialized by default constructor
+    for (size_t i = 0; i < capacity; i++) {
+        slots[i].hash.store(0, std::memory_order_relaxed);
+        slots[i].entry.store(nullptr, std::memory_order_relaxed);
+    }
+}
+
+LockFreeIndex::LockFreeIndex(EpochReclaimer &reclaimer, size_t capacity)
+    : _reclaimer(reclaimer), _size(0), _used(0) {
+    size_t rounded = 16;
+    while (rounded < capacity) {
+        rounded <<= 1;
+    }
+    _table.store(new Table(rounded), std::memory_order_relaxed);
+}
+
+LockFreeIndex::~LockFreeIndex() { delete _table.load(std::memory_order_relaxed); }
+
+// See LockFreeIndex.h
+LinkedList::Entry *LockFreeIndex::Find(const std::string &key, uint64_t hash) const {
+    // Loads are sequentially consistent to pair with the epoch pinning, see EpochReclaimer
+    const Table *table = _table.load(std::memory_order_seq_cst);
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        const Slot &slot = table->slots[i];
+        LinkedList::Entry *e = slot.entry.load(std::memory_order_seq_cst);
+        if (e == nullptr) {
+            return nullptr;
+        }
+        if (e != TOMBSTONE && slot.hash.load(std::memory_order_relaxed) == hash && e->has_key(key)) {
+            return e;
+        }
+    }
+}
+
+// See LockFreeIndex.h
+bool LockFreeIndex::Contains(const LinkedList::Entry *e, uint64_t hash) const {
+    const Table *table = _table.load(std::memory_order_relaxed);
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        LinkedList::Entry *current = table->slots[i].entry.load(std::memory_order_relaxed);
+        if (current == nullptr) {
+            return false;
+        }
+        if (current == e) {
+            return true;
+        }
+    }
+}
+
+// See LockFreeIndex.h
+void LockFreeIndex::Insert(LinkedList::Entry *e, uint64_t hash) {
+    Table *table = _table.load(std::memory_order_relaxed);
+    if ((_used + 1) * 4 > (table->mask + 1) * 3) {
+        // Grow only if live entries need it, otherwise it is enough to drop tombstones
+        size_t capacity = table->mask + 1;
+        while ((_size + 1) * 2 > capacity) {
+            capacity <<= 1;
+        }
+        Rebuild(capacity);
+        table = _table.load(std::memory_order_relaxed);
+    }
+
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        Slot &slot = table->slots[i];
+        LinkedList::Entry *current = slot.entry.load(std::memory_order_relaxed);
+        if (current == nullptr || current == TOMBSTONE) {
+            // Reader checks hash only after it sees the entry
+            slot.hash.store(hash, std::memory_order_relaxed);
+            slot.entry.store(e, std::memory_order_seq_cst);
+            _used += current == nullptr;
+            _size++;
+            return;
+        }
+    }
+}
+
+// See LockFreeIndex.h
+void LockFreeIndex::Replace(const LinkedList::Entry *old, LinkedList::Entry *e, uint64_t hash) {
+    Locate(old, hash).entry.store(e, std::memory_order_seq_cst);
+}
+
+// See LockFreeIndex.h
+void LockFreeIndex::Erase(const LinkedList::Entry *e, uint64_t hash) {
+    Locate(e, hash).entry.store(TOMBSTONE, std::memory_order_seq_cst);
+    _size--;
+}
+
+LockFreeIndex::Slot &LockFreeIndex::Locate(const LinkedList::Entry *e, uint64_t hash) const {
+    Table *table = _table.load(std::memory_order_relaxed);
+    for (size_t i = hash & table->mask;; i = (i + 1) & table->mask) {
+        LinkedList::Entry *current = table->slots[i].entry.load(std::memory_order_relaxed);
+        if (current == e) {
+            return table->slots[i];
+        }
+        if (current == nullptr) {
+            // Caller broke the contract, index is inconsistent with the storage
+            abort();
+        }
+    }
+}
+
+// See LockFreeIndex.h
+size_t LockFreeIndex::memory() const {
+    static_assert(sizeof(Slot) * 2 == ENTRY_OVERHEAD, "entry overhead must follow slot layout");
+    return (_table.load(std::memory_order_relaxed)->mask + 1) * sizeof(Slot);
+}
+
+void LockFreeIndex::Rebuild(size_t capacity) {
+    Table *old = _table.load(std::memory_order_relaxed);
+    Table *table = new Table(capacity);
+    for (size_t i = 0; i <= old->mask; i++) {
+        LinkedList::Entry *e = old->slots[i].entry.load(std::memory_order_relaxed);
+        if (e == nullptr || e == TOMBSTONE) {
+            continue;
+        }
+
+        uint64_t hash = old->slots[i].hash.load(std::memory_order_relaxed);
+        size_t j = hash & table->mask;
+        while (table->slots[j].entry.load(std::memory_order_relaxed) != nullptr) {
+            j = (j + 1) & table->mask;
+        }
+        table->slots[j].hash.store(hash, std::memory_order_relaxed);
+        table->slots[j].entry.store(e, std::memory_order_relaxed);
+    }
+
+    // Old table stays intact, readers that have already loaded it could finish their lookups there
+    _table.store(table, std::memory_order_seq_cst);
+    _used = _size;
+    _reclaimer.Retire(old, [](void *p) { delete static_cast<Table *>(p); });
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,112 @@
+#ifndef AFINA_STORAGE_LOCK_FREE_INDEX_H
+#define AFINA_STORAGE_LOCK_FREE_INDEX_H
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include "EpochReclaimer.h"
+#include "KeyHash.h"
+#include "LinkedList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Open addressing hash index with lock-free lookups
+ * Maps keys to storage entries using linear probing. Find never blocks and could run concurrently
+ * with any modification, it must be called under EpochReclaimer::Guard though. Modifications must
+ * be serialized by the caller.
+ *
+ * Deleted slots are marked with tombstones. Once live and deleted slots take 3/4 of the table it
+ * gets rebuilt into a new one, readers keep using the old table until they are done with it and
+ * the reclaimer frees it then
+ */
+class LockFreeIndex {
+public:
+    /**
+     * @param reclaimer old tables are retired there
+     * @param capacity initial number of slots, rounded up to the power of two
+     */
+    explicit LockFreeIndex(EpochReclaimer &reclaimer, size_t capacity = 64);
+    ~LockFreeIndex();
+
+    // Table bytes each entry is charged for: hash and pointer of its slot plus share of the free
+    // ones. Live entries take from 1/4 to 3/4 of the table, entry is charged at 1/2 in between
+    static constexpr size_t ENTRY_OVERHEAD = 2 * (sizeof(uint64_t) + sizeof(LinkedList::Entry *));
+
+    static uint64_t Hash(const std::string &key) { return KeyHash(key); }
+
+    /**
+     * Entry stored for the key, nullptr if there is none
+     */
+    LinkedList::Entry *Find(const std::string &key, uint64_t hash) const;
+
+    /**
+     * Whether this very entry is stored in the index. Doesn't touch entry memory, so pointer
+     * could be stale
+     */
+    bool Contains(const LinkedList::Entry *e, uint64_t hash) const;
+
+    /**
+     * Adds entry, its key must not be in the index yet
+     */
+    void Insert(LinkedList::Entry *e, uint64_t hash);
+
+    /**
+     * Puts new entry for the same key in place of the old one
+     */
+    void Replace(const LinkedList::Entry *old, LinkedList::Entry *e, uint64_t hash);
+
+    /**
+     * Removes entry from the index
+     */
+    void Erase(const LinkedList::Entry *e, uint64_t hash);
+
+    /**
+     * Number of entries in the index
+     */
+    size_t size() const { return _size; }
+
+    /**
+     * Bytes taken by the current table, tables waiting for reclamation aren't counted
+     */
+    size_t memory() const;
+
+private:
+    struct Slot {
+        std::atomic<uint64_t> hash;
+        std::atomic<LinkedList::Entry *> entry;
+    };
+
+    struct Table {
+        explicit Table(size_t capacity);
+
+        size_t mask;
+
+        // Slots come from the arena entries do
+        std::vector<Slot, LinkedList::StlAllocator<Slot>> slots;
+    };
+
+    // Slot contents left by erased entry, probing goes over it
+    static LinkedList::Entry *const TOMBSTONE;
+
+    // Slot holding the entry, entry must be in the table
+    Slot &Locate(const LinkedList::Entry *e, uint64_t hash) const;
+    void Rebuild(size_t capacity);
+
+    EpochReclaimer &_reclaimer;
+    std::atomic<Table *> _table;
+
+    // Live entries and live entries plus tombstones
+    size_t _size;
+    size_t _used;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_LOCK_FREE_INDEX_H
@@ -7,11 +7,22 @@
 namespace Afina {
 namespace Backend {
 
-int MapBasedFlatCombineImpl::priority[5];
+int MapBasedFlatCombineImpl::priority[12];
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::Start() { _expirer.Start(); }
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::Stop() { _expirer.Stop(); }
 
 // See MapBasedFlatCombineImpl.h
 bool MapBasedFlatCombineImpl::Put(const std::string &key, const std::string &value) {
-    if ((key.size() + value.size()) > _max_size) {
+    return Put(key, value, Metadata());
+}
+
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
         return false;
     }
 
@@ -19,6 +30,7 @@ bool MapBasedFlatCombineImpl::Put(const std::string &key, const std::string &val
     slot->user_op.opcode = Node::OpCode::Put;
     slot->user_op.key = &key;
     slot->user_op.value = const_cast<std::string*>(&value);
+    slot->user_op.meta = meta;
     slot->user_op.fc = this;
 
     flat_combiner.apply_slot(*slot);
@@ -34,8 +46,8 @@ bool MapBasedFlatCombineImpl::_Put(CombineKeyData &data) {
 
     data.put_called = true;
 
-    if (data.it != _backend.end()) {
-        return _Set(data.it->second, *data.value);
+    if (data.it != nullptr) {
+        return _Set(*data.it, *data.value, *data.meta);
     }
 
     return _PutFast(data);
@@ -43,7 +55,12 @@ bool MapBasedFlatCombineImpl::_Put(CombineKeyData &data) {
 
 // See MapBasedFlatCombineImpl.h
 bool MapBasedFlatCombineImpl::PutIfAbsent(const std::string &key, const std::string &value) {
-    if ((key.size() + value.size()) > _max_size) {
+    return PutIfAbsent(key, value, Metadata());
+}
+
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
         return false;
     }
 
@@ -51,6 +68,7 @@ bool MapBasedFlatCombineImpl::PutIfAbsent(const std::string &key, const std::str
     slot->user_op.opcode = Node::OpCode::PutIfAbsent;
     slot->user_op.key = &key;
     slot->user_op.value = const_cast<std::string*>(&value);
+    slot->user_op.meta = meta;
     slot->user_op.fc = this;
 
     flat_combiner.apply_slot(*slot);
@@ -70,7 +88,7 @@ bool MapBasedFlatCombineImpl::_PutIfAbsent(CombineKeyData &data) {
         return true;
     }
 
-    if (data.it != _backend.end()) {
+    if (data.it != nullptr) {
         abort();
     }
 
@@ -78,12 +96,19 @@ bool MapBasedFlatCombineImpl::_PutIfAbsent(CombineKeyData &data) {
 }
 
 bool MapBasedFlatCombineImpl::_PutFast(CombineKeyData &data) {
-    auto e = _list.Put(*data.key, *data.value);
+    // Newcomer that doesn't fit has to beat the entry it would push out
+    if (_admission && !_backend.empty() &&
+        (_size + ItemSize(data.key->size(), data.value->size())) > _max_size &&
+        !_admission->Admit(*data.key, _policy->Tail()->key())) {
+        return false;
+    }
+
+    auto e = _policy->Put(*data.key, *data.value, *data.meta);
+    e->meta.cas = ++_cas;
+    _wheel.Schedule(e);
 
-    auto it = _backend.insert(data.hint, std::make_pair(std::cref(e->key), e));
-    data.it = it;
-    data.hint = it;
-    _size += e->size();
+    data.it = _backend.Insert(e);
+    _size += _ItemSize(e);
 
     _Trim();
 
@@ -92,7 +117,12 @@ bool MapBasedFlatCombineImpl::_PutFast(CombineKeyData &data) {
 
 // See MapBasedFlatCombineImpl.h
 bool MapBasedFlatCombineImpl::Set(const std::string &key, const std::string &value) {
-    if ((key.size() + value.size()) > _max_size) {
+    return Set(key, value, Metadata());
+}
+
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Set(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
         return false;
     }
 
@@ -100,6 +130,7 @@ bool MapBasedFlatCombineImpl::Set(const std::string &key, const std::string &val
     slot->user_op.opcode = Node::OpCode::Set;
     slot->user_op.key = &key;
     slot->user_op.value = const_cast<std::string*>(&value);
+    slot->user_op.meta = meta;
     slot->user_op.fc = this;
 
     flat_combiner.apply_slot(*slot);
@@ -119,26 +150,154 @@ bool MapBasedFlatCombineImpl::_Set(CombineKeyData &data) {
 
     data.set_called = true;
     
-    if (data.it == _backend.end()) {
+    if (data.it == nullptr) {
         abort();
     }
 
-    _Set(data.it->second, *data.value);
+    _Set(*data.it, *data.value, *data.meta);
+
+    return true;
+}
+
+bool MapBasedFlatCombineImpl::_Set(LinkedList::Entry* e, const std::string& value, const Metadata& meta) {
+    _size -= _ItemSize(e);
+    e->set_value(value);
+    e->meta = meta;
+    e->meta.cas = ++_cas;
+    _size += _ItemSize(e);
+    _policy->Up(e);
+    _wheel.Schedule(e);
+
+    _Trim();
 
     return true;
 }
 
-bool MapBasedFlatCombineImpl::_Set(LinkedList::Entry* e, const std::string& value) {
-    _size -= e->size();
-    e->value = value;
-    _size += e->size();
-    _list.Up(e);
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Append(const std::string &key, const std::string &data) {
+    return _ApplyConcat(key, data, Node::OpCode::Append);
+}
+
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Prepend(const std::string &key, const std::string &data) {
+    return _ApplyConcat(key, data, Node::OpCode::Prepend);
+}
+
+bool MapBasedFlatCombineImpl::_ApplyConcat(const std::string &key, const std::string &data, Node::OpCode opcode) {
+    if (ItemSize(key.size(), data.size()) > _max_size) {
+        return false;
+    }
+
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = opcode;
+    slot->user_op.key = &key;
+    slot->user_op.value = const_cast<std::string*>(&data);
+    slot->user_op.fc = this;
+
+    flat_combiner.apply_slot(*slot);
+
+    return slot->user_op.result;
+}
+
+bool MapBasedFlatCombineImpl::_Concat(CombineKeyData &data, bool prepend) {
+    if (data.it == nullptr) {
+        return false;
+    }
+
+    LinkedList::Entry *e = *data.it;
+    if (ItemSize(e->key_size(), e->value_size() + data.value->size()) > _max_size) {
+        return false;
+    }
+
+    size_t old_size = _ItemSize(e);
+    e->Concat(*data.value, prepend);
+    e->meta.cas = ++_cas;
+    _size = _size - old_size + _ItemSize(e);
+    _policy->Up(e);
 
     _Trim();
 
     return true;
 }
 
+// See MapBasedFlatCombineImpl.h
+Storage::ArithmeticResult MapBasedFlatCombineImpl::Increment(const std::string &key, uint64_t delta, uint64_t &result) {
+    return _ApplyArithmetic(key, delta, Node::OpCode::Increment, result);
+}
+
+// See MapBasedFlatCombineImpl.h
+Storage::ArithmeticResult MapBasedFlatCombineImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &result) {
+    return _ApplyArithmetic(key, delta, Node::OpCode::Decrement, result);
+}
+
+Storage::ArithmeticResult MapBasedFlatCombineImpl::_ApplyArithmetic(const std::string &key, uint64_t delta,
+                                                                    Node::OpCode opcode, uint64_t &result) {
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = opcode;
+    slot->user_op.key = &key;
+    slot->user_op.number = delta;
+    slot->user_op.fc = this;
+
+    flat_combiner.apply_slot(*slot);
+
+    result = slot->user_op.number;
+    return slot->user_op.arithmetic_result;
+}
+
+Storage::ArithmeticResult MapBasedFlatCombineImpl::_Arithmetic(CombineKeyData &data, Node &node, bool decrement) {
+    if (data.it == nullptr) {
+        return ArithmeticResult::NotFound;
+    }
+
+    LinkedList::Entry *e = *data.it;
+    size_t old_size = _ItemSize(e);
+    if (!e->Increment(node.number, decrement, node.number)) {
+        return ArithmeticResult::NonNumeric;
+    }
+
+    e->meta.cas = ++_cas;
+    _size = _size - old_size + _ItemSize(e);
+    _policy->Up(e);
+
+    _Trim();
+
+    return ArithmeticResult::Stored;
+}
+
+// See MapBasedFlatCombineImpl.h
+Storage::CasResult MapBasedFlatCombineImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                           const Metadata &meta, uint64_t cas) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
+        return CasResult::NotStored;
+    }
+
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = Node::OpCode::CompareAndSwap;
+    slot->user_op.key = &key;
+    slot->user_op.value = const_cast<std::string*>(&value);
+    slot->user_op.meta = meta;
+    slot->user_op.cas = cas;
+    slot->user_op.fc = this;
+
+    flat_combiner.apply_slot(*slot);
+
+    return slot->user_op.cas_result;
+}
+
+// CompareAndSwap goes first in the group, so it always deals with the entry as it was
+// before the pass. The entry is updated in place, rest of the group observes the new version
+Storage::CasResult MapBasedFlatCombineImpl::_CompareAndSwap(CombineKeyData &data, Node &node) {
+    if (data.it == nullptr) {
+        return CasResult::NotFound;
+    }
+    if ((*data.it)->meta.cas != node.cas) {
+        return CasResult::Exists;
+    }
+
+    _Set(*data.it, *data.value, *data.meta);
+    return CasResult::Stored;
+}
+
 // See MapBasedFlatCombineImpl.h
 bool MapBasedFlatCombineImpl::Delete(const std::string &key) {
     FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
@@ -156,17 +315,17 @@ bool MapBasedFlatCombineImpl::_Delete(CombineKeyData &data) {
         return false;
     }
     data.delete_called = true;
-    if (data.it == _backend.end()) {
+    if (data.it == nullptr) {
         return false;
     }
-    data.hint = _backend.begin();
     return _DeleteUnsafe(data.it);
 }
 
-bool MapBasedFlatCombineImpl::_DeleteUnsafe(MapBasedFlatCombineImpl::Map::iterator it) {
-    _size -= it->second->size();
-    _list.Delete(it->second);
-    _backend.erase(it);
+bool MapBasedFlatCombineImpl::_DeleteUnsafe(SwissIndex::Slot *it) {
+    _size -= _ItemSize(*it);
+    _wheel.Remove(*it);
+    _policy->Delete(*it);
+    _backend.Erase(it);
 
     return true;
 }
@@ -181,36 +340,168 @@ bool MapBasedFlatCombineImpl::Get(const std::string &key, std::string &value) co
 
     flat_combiner.apply_slot(*slot);
 
+    // Small values are already copied by the combiner, only big ones are left pinned
+    if (slot->user_op.result && !slot->user_op.pinned.empty()) {
+        value.assign(slot->user_op.pinned.data(), slot->user_op.pinned.size());
+        slot->user_op.pinned.reset();
+    }
     return slot->user_op.result;
 }
 
-bool MapBasedFlatCombineImpl::_Get(CombineKeyData &data) const {
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Get(const std::string &key, Value &value) const {
+    Metadata meta;
+    return Get(key, value, meta);
+}
+
+// See MapBasedFlatCombineImpl.h
+bool MapBasedFlatCombineImpl::Get(const std::string &key, Value &value, Metadata &meta) const {
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = Node::OpCode::Get;
+    slot->user_op.key = &key;
+    slot->user_op.value = nullptr;
+    slot->user_op.fc = const_cast<MapBasedFlatCombineImpl*>(this);
+
+    flat_combiner.apply_slot(*slot);
+
+    if (slot->user_op.result) {
+        value = std::move(slot->user_op.pinned);
+        slot->user_op.pinned.reset();
+        meta = slot->user_op.meta;
+    }
+    return slot->user_op.result;
+}
+
+bool MapBasedFlatCombineImpl::_Get(CombineKeyData &data, Node &node) const {
     if (!data.existed_initially) {
         return false;
     }
 
-    *data.value = data.initial_value;
-    _list.Up(data.it->second);
+    const Value &initial = data.initial_value;
+    if (node.value != nullptr && initial.size() <= LinkedList::Entry::SMALL_VALUE) {
+        node.value->assign(initial.data(), initial.size());
+    } else {
+        node.pinned = initial;
+    }
+    node.meta = data.initial_meta;
+    if (!data.delete_called) {
+        _policy->Up(*data.it);
+    }
 
     return true;
 }
 
+void MapBasedFlatCombineImpl::_CombineReadOnly(FlatCombiner<Node>::Slot **start, FlatCombiner<Node>::Slot **end,
+                                               time_t now) const {
+    if (_admission) {
+        for (auto p = start; p < end; ++p) {
+            _admission->Record(*((*p)->user_op.key));
+        }
+    }
+
+    auto it = _backend.Find(*((*start)->user_op.key));
+    if ((it == nullptr) || (*it)->expired(now)) {
+        for (auto p = start; p < end; ++p) {
+            (*p)->user_op.result = false;
+        }
+        return;
+    }
+
+    _policy->Up(*it);
+    const LinkedList::Entry *e = *it;
+    for (auto p = start; p < end; ++p) {
+        Node &node = (*p)->user_op;
+        if (node.value != nullptr && e->small()) {
+            e->copy_value(*node.value);
+        } else {
+            node.pinned = e->pin_value();
+        }
+        node.meta = e->meta;
+        node.result = true;
+    }
+}
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    // Policy and index belong to the combiner, only policy name and atomic counters could be read here
+    stats.emplace_back("eviction_policy", _policy->Name());
+    if (_admission) {
+        _admission->Stats(stats);
+    } else {
+        stats.emplace_back("admission", "none");
+    }
+
+    auto fc_stats = flat_combiner.stats();
+    stats.emplace_back("fc_passes", std::to_string(fc_stats.passes));
+    stats.emplace_back("fc_operations", std::to_string(fc_stats.operations));
+    stats.emplace_back("fc_max_pass", std::to_string(fc_stats.max_pass));
+    stats.emplace_back("fc_handoffs", std::to_string(fc_stats.handoffs));
+    stats.emplace_back("fc_parks", std::to_string(fc_stats.parks));
+    stats.emplace_back("bytes", std::to_string(_size));
+    stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+}
+
+// See MapBasedFlatCombineImpl.h
+size_t MapBasedFlatCombineImpl::Size() const { return _size; }
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::SetMaxSize(size_t max_size) {
+    // Entries are evicted by the combiner, expiration pass trims storage down to the new limit
+    _max_size = max_size;
+    Expire(time(nullptr));
+}
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::Expire(time_t now) {
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = Node::OpCode::Expire;
+    slot->user_op.key = nullptr;
+    slot->user_op.now = now;
+    slot->user_op.fc = this;
+
+    // Wheel is moved forward by small steps, so that single combine pass never takes too long
+    do {
+        flat_combiner.apply_slot(*slot);
+    } while (!slot->user_op.result);
+}
+
+bool MapBasedFlatCombineImpl::_Expire(Node &node) {
+    _Trim();
+    return _wheel.Advance(node.now, [this](LinkedList::Entry *e) { _DeleteUnsafe(_backend.Find(e)); }, 16);
+}
+
+// See MapBasedFlatCombineImpl.h
+void MapBasedFlatCombineImpl::Rebalance(time_t now) {
+    FlatCombiner<Node>::Slot *slot = flat_combiner.get_slot();
+    slot->user_op.opcode = Node::OpCode::Rebalance;
+    slot->user_op.key = nullptr;
+    slot->user_op.now = now;
+    slot->user_op.fc = this;
+
+    // Entries are deleted by small batches for the same reason
+    do {
+        flat_combiner.apply_slot(*slot);
+    } while (!slot->user_op.result);
+}
+
+bool MapBasedFlatCombineImpl::_Rebalance(Node &node) {
+    for (int i = 0; i < 16; i++) {
+        LinkedList::Entry *e = _policy->Rebalance(node.now);
+        if (e == nullptr) {
+            return true;
+        }
+        _DeleteUnsafe(_backend.Find(e));
+    }
+    return false;
+}
+
 void MapBasedFlatCombineImpl::_Trim() {
     while (_size > _max_size) {
-        auto it = _backend.find(_list.Tail()->key);
-        if (it != _backend.end()) {
-            _DeleteUnsafe(it);
-        }
+        _DeleteUnsafe(_backend.Find(_policy->Tail()));
     }
 }
 
 void MapBasedFlatCombineImpl::combine(FlatCombiner<Node>::Slot **start, FlatCombiner<Node>::Slot **end) {
-    // static size_t max_combine_n = 0;
-    // if ((end - start) > max_combine_n) {
-    //     max_combine_n = end - start;
-    //     std::cout << "New max combine size: " << max_combine_n << std::endl;
-    // }
-
     struct {
         bool operator()(FlatCombiner<Node>::Slot *a, FlatCombiner<Node>::Slot *b) {
             const std::string &ka = *(a->user_op.key);
@@ -227,32 +518,74 @@ void MapBasedFlatCombineImpl::combine(FlatCombiner<Node>::Slot **start, FlatComb
         }
     } prioritized_key_comparator;
 
+    // Expiration and rebalance requests have no key, they are handled first and the rest is sorted
+    auto fc = (*start)->user_op.fc;
+    auto keyed = std::partition(start, end, [](FlatCombiner<Node>::Slot *slot) {
+        return slot->user_op.opcode == Node::OpCode::Expire || slot->user_op.opcode == Node::OpCode::Rebalance;
+    });
+    for (auto p = start; p < keyed; ++p) {
+        Node &op = (*p)->user_op;
+        op.result = op.opcode == Node::OpCode::Expire ? fc->_Expire(op) : fc->_Rebalance(op);
+    }
+    start = keyed;
+
     std::sort(start, end, prioritized_key_comparator);
 
-    auto fc = (*start)->user_op.fc;
-    auto hint = fc->_backend.begin();
-    std::string prev_key = "";
+    time_t now = time(nullptr);
+    const std::string *prev_key = nullptr;
     CombineKeyData cdata;
     for (auto p = start; p < end; ++p) {
         const std::string &cur_key = *((*p)->user_op.key);
-        std::string &cur_val = *((*p)->user_op.value);
 
-        if (cur_key != prev_key) {
-            prev_key = cur_key;
+        if ((prev_key == nullptr) || (cur_key != *prev_key)) {
+            prev_key = &cur_key;
+
+            // Gets have the lowest priority, so if group starts with Get there is nothing else
+            // in it. Such a group doesn't change anything and needs no snapshot
+            if ((*p)->user_op.opcode == Node::OpCode::Get) {
+                auto group_end = p + 1;
+                while ((group_end < end) && (*((*group_end)->user_op.key) == cur_key)) {
+                    ++group_end;
+                }
+
+                fc->_CombineReadOnly(p, group_end, now);
+                p = group_end - 1;
+                continue;
+            }
+
             cdata = CombineKeyData();
-            cdata.it = fc->_backend.find(cur_key);
+            cdata.it = fc->_backend.Find(cur_key);
+            if ((cdata.it != nullptr) && (*cdata.it)->expired(now)) {
+                // For the clients expired entry doesn't exist already
+                fc->_DeleteUnsafe(cdata.it);
+                cdata.it = nullptr;
+            }
             cdata.delete_called = false;
             cdata.put_called = false;
             cdata.put_if_absent_called = false;
             cdata.set_called = false;
-            cdata.existed_initially = cdata.it != fc->_backend.end();
-            if (cdata.existed_initially) {
-                cdata.initial_value = cdata.it->second->value;
+            cdata.existed_initially = cdata.it != nullptr;
+
+            // Gets go last in the group, snapshot is needed only if there are any. Without
+            // the snapshot holding a reference, value could be updated in place
+            auto group_last = p;
+            while ((group_last + 1 < end) && (*((*(group_last + 1))->user_op.key) == cur_key)) {
+                ++group_last;
+            }
+            if (cdata.existed_initially && ((*group_last)->user_op.opcode == Node::OpCode::Get)) {
+                cdata.initial_value = (*cdata.it)->pin_value();
+                cdata.initial_meta = (*cdata.it)->meta;
             }
             cdata.key = &cur_key;
-            cdata.hint = hint;
         }
         cdata.value = (*p)->user_op.value;
+        cdata.meta = &(*p)->user_op.meta;
+
+        Node::OpCode opcode = (*p)->user_op.opcode;
+        if (fc->_admission &&
+            (opcode == Node::OpCode::Get || opcode == Node::OpCode::Put || opcode == Node::OpCode::PutIfAbsent)) {
+            fc->_admission->Record(cur_key);
+        }
 
         switch ((*p)->user_op.opcode) {
             case (Node::OpCode::Delete): {
@@ -272,18 +605,29 @@ void MapBasedFlatCombineImpl::combine(FlatCombiner<Node>::Slot **start, FlatComb
                 break;
             }
             case (Node::OpCode::Get): {
-                (*p)->user_op.result = fc->_Get(cdata);
+                (*p)->user_op.result = fc->_Get(cdata, (*p)->user_op);
+                break;
+            }
+            case (Node::OpCode::Append):
+            case (Node::OpCode::Prepend): {
+                (*p)->user_op.result = fc->_Concat(cdata, (*p)->user_op.opcode == Node::OpCode::Prepend);
+                break;
+            }
+            case (Node::OpCode::Increment):
+            case (Node::OpCode::Decrement): {
+                bool decrement = (*p)->user_op.opcode == Node::OpCode::Decrement;
+                (*p)->user_op.arithmetic_result = fc->_Arithmetic(cdata, (*p)->user_op, decrement);
+                (*p)->user_op.result = (*p)->user_op.arithmetic_result == ArithmeticResult::Stored;
+                break;
+            }
+            case (Node::OpCode::CompareAndSwap): {
+                (*p)->user_op.cas_result = fc->_CompareAndSwap(cdata, (*p)->user_op);
+                (*p)->user_op.result = (*p)->user_op.cas_result == CasResult::Stored;
                 break;
             }
             default:
                 break;
         }
-
-        if ((cdata.hint != fc->_backend.begin()) && (cdata.hint != fc->_backend.end())) {
-            hint = cdata.hint;
-        }
-
-        (*p)->done.store(true, std::memory_order_release);
     }
 }
 
@@ -1,15 +1,21 @@
 #ifndef AFINA_STORAGE_MAP_BASED_FLAT_COMBINE_IMPL_H
 #define AFINA_STORAGE_MAP_BASED_FLAT_COMBINE_IMPL_H
 
-#include <unordered_map>
+#include <atomic>
+#include <memory>
 #include <string>
 
 #include <functional>
 
 #include <afina/Storage.h>
 #include "LinkedList.h"
+#include "EvictionPolicy.h"
 #include "FlatCombiner.h"
+#include "PeriodicTask.h"
+#include "SwissIndex.h"
 #include "ThreadLocal.h"
+#include "TimerWheel.h"
+#include "TinyLfu.h"
 
 namespace Afina {
 namespace Backend {
@@ -19,7 +25,8 @@ struct CombineKeyData;
 
 struct Node {
     enum OpCode {
-        Get, Set, Put, PutIfAbsent, Delete
+        Get, Set, Put, PutIfAbsent, Delete, Expire, CompareAndSwap, Append, Prepend, Increment, Decrement,
+        Rebalance
     };
 
     OpCode opcode;
@@ -27,7 +34,26 @@ struct Node {
     std::string *value;
     MapBasedFlatCombineImpl *fc;
 
+    // Metadata of the value being stored, for Get metadata of the value found
+    Metadata meta;
+
+    // CompareAndSwap: expected version of the entry and outcome of the operation
+    uint64_t cas;
+    Afina::Storage::CasResult cas_result;
+
+    // Increment/Decrement: delta to apply, once operation is complete the updated value
+    uint64_t number;
+    Afina::Storage::ArithmeticResult arithmetic_result;
+
+    // Expire: time to move expiration wheel to, Rebalance: current time
+    time_t now;
+
     bool result;
+
+    // Get result: small value is copied by the combiner right away. For the big one combiner only
+    // takes a reference, owner thread copies it out once operation is complete, outside of the
+    // critical section
+    Afina::Value pinned;
 };
 
 /**
@@ -37,60 +63,168 @@ struct Node {
  */
 class MapBasedFlatCombineImpl : public Afina::Storage {
 public:
-    using Map = std::unordered_map<std::reference_wrapper<const std::string>,
-                        LinkedList::Entry*,
-                        std::hash<std::string>,
-                        std::equal_to<std::string>>;
-    MapBasedFlatCombineImpl(size_t max_size = 1048576) : _max_size(max_size), _size(0), flat_combiner(combine) {
-            priority[Node::OpCode::Delete] = 0;
-            priority[Node::OpCode::Put] = 1;
-            priority[Node::OpCode::PutIfAbsent] = 2;
-            priority[Node::OpCode::Set] = 3;
-            priority[Node::OpCode::Get] = 4;
+    using Options = FlatCombiner<Node>::Options;
+
+    /**
+     * @param admission put TinyLFU filter in front of the eviction policy, see MapBasedGlobalLockImpl
+     */
+    MapBasedFlatCombineImpl(size_t max_size = 1048576,
+                            const FlatCombiner<Node>::Options &options = FlatCombiner<Node>::Options(),
+                            EvictionPolicy::Type eviction = EvictionPolicy::Type::Lru, bool admission = false)
+        : _max_size(max_size), _policy(EvictionPolicy::Create(eviction)),
+          _admission(admission ? new TinyLfu(max_size) : nullptr), _size(0), _cas(0), _wheel(time(nullptr)), flat_combiner(combine, options),
+          _expirer(
+              [this]() {
+                  time_t now = time(nullptr);
+                  Expire(now);
+                  Rebalance(now);
+              },
+              std::chrono::seconds(1)) {
+            priority[Node::OpCode::CompareAndSwap] = 0;
+            priority[Node::OpCode::Append] = 1;
+            priority[Node::OpCode::Prepend] = 1;
+            priority[Node::OpCode::Increment] = 1;
+            priority[Node::OpCode::Decrement] = 1;
+            priority[Node::OpCode::Delete] = 2;
+            priority[Node::OpCode::Put] = 3;
+            priority[Node::OpCode::PutIfAbsent] = 4;
+            priority[Node::OpCode::Set] = 5;
+            priority[Node::OpCode::Get] = 6;
+            priority[Node::OpCode::Expire] = 7;
+            priority[Node::OpCode::Rebalance] = 7;
     }
     ~MapBasedFlatCombineImpl() {}
 
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
     // Implements Afina::Storage interface
     bool Put(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
     // Implements Afina::Storage interface
     bool PutIfAbsent(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) override;
+
     // Implements Afina::Storage interface
     bool Set(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Increment(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Decrement(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, const Metadata &meta,
+                             uint64_t cas) override;
+
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
 
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) const override;
 
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value, Metadata &meta) const override;
+
+    // Implements Afina::Storage interface
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    size_t Size() const override;
+
+    // Implements Afina::Storage interface
+    void SetMaxSize(size_t max_size) override;
+
+    /**
+     * Bytes item with key and value of the given sizes is accounted for, see MapBasedGlobalLockImpl
+     */
+    static size_t ItemSize(size_t key_size, size_t value_size) {
+        return LinkedList::Entry::Footprint(key_size, value_size) + SwissIndex::ENTRY_OVERHEAD;
+    }
+
+    /**
+     * Reclaim all entries expired by the given time. Storage calls it once a second in
+     * background between Start and Stop
+     */
+    void Expire(time_t now);
+
+    /**
+     * Deletes entries eviction policy picks to move memory where it is needed, see
+     * EvictionPolicy::Rebalance. Storage calls it once a second in background between Start and Stop
+     */
+    void Rebalance(time_t now);
+
 private:
     static void combine(FlatCombiner<Node>::Slot **start, FlatCombiner<Node>::Slot **end);
-    static int priority[5];
+    void _CombineReadOnly(FlatCombiner<Node>::Slot **start, FlatCombiner<Node>::Slot **end, time_t now) const;
+    static int priority[12];
 
     bool _Put(CombineKeyData &data);
     bool _PutIfAbsent(CombineKeyData &data);
     bool _Set(CombineKeyData &data);
     bool _Delete(CombineKeyData &data);
-    bool _Get(CombineKeyData &data) const;
+    CasResult _CompareAndSwap(CombineKeyData &data, Node &node);
+    bool _Concat(CombineKeyData &data, bool prepend);
+    ArithmeticResult _Arithmetic(CombineKeyData &data, Node &node, bool decrement);
+    bool _Get(CombineKeyData &data, Node &node) const;
 
     bool _PutFast(CombineKeyData &data);
-    bool _Set(LinkedList::Entry* e, const std::string& value);
-    bool _DeleteUnsafe(Map::iterator it);
+    bool _Set(LinkedList::Entry* e, const std::string& value, const Metadata& meta);
+    ArithmeticResult _ApplyArithmetic(const std::string &key, uint64_t delta, Node::OpCode opcode, uint64_t &result);
+    bool _ApplyConcat(const std::string &key, const std::string &data, Node::OpCode opcode);
+    bool _Expire(Node &node);
+    bool _Rebalance(Node &node);
+    bool _DeleteUnsafe(SwissIndex::Slot *it);
     void _Trim();
 
-    size_t _max_size;
-    Map _backend;
+    static size_t _ItemSize(const LinkedList::Entry *e) { return e->size() + SwissIndex::ENTRY_OVERHEAD; }
+
+    // Both are changed by the combiner only, but could be read from any thread
+    std::atomic<size_t> _max_size;
+    SwissIndex _backend;
+
+    // Owns entries and picks the ones to evict
+    std::unique_ptr<EvictionPolicy> _policy;
+
+    // Admission filter, nullptr if every new key is stored
+    std::unique_ptr<TinyLfu> _admission;
+    std::atomic<size_t> _size;
+
+    // Last version assigned to an entry
+    uint64_t _cas;
+
+    // Entries with expiration time set
+    TimerWheel _wheel;
 
-    mutable LinkedList _list;
-    size_t _size;
     mutable FlatCombiner<Node> flat_combiner;
+
+    // Background task moving _wheel forward, must be the last one to be destroyed first
+    PeriodicTask _expirer;
 };
 
 struct CombineKeyData {
-    MapBasedFlatCombineImpl::Map::iterator it;
-    MapBasedFlatCombineImpl::Map::iterator hint;
+    SwissIndex::Slot *it;
     bool delete_called;
     bool put_called;
     bool put_if_absent_called;
@@ -98,8 +232,11 @@ struct CombineKeyData {
     bool existed_initially;
     const std::string *key;
     std::string *value;
-    std::string initial_value;
+    const Metadata *meta;
 
+    // Value as it was before the first operation in the group, Gets in the group observe it
+    Value initial_value;
+    Metadata initial_meta;
 };
 
 } // namespace Backend
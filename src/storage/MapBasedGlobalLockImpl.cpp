@@ -5,38 +5,76 @@
 namespace Afina {
 namespace Backend {
 
+constexpr size_t MapBasedGlobalLockImpl::READ_BUFFER_SIZE;
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Start() { _expirer.Start(); }
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Stop() { _expirer.Stop(); }
+
 // See MapBasedGlobalLockImpl.h
 bool MapBasedGlobalLockImpl::Put(const std::string &key, const std::string &value) {
-	if ((key.size() + value.size()) > _max_size) {
+	return Put(key, value, Metadata());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+	if (ItemSize(key.size(), value.size()) > _max_size) {
 		return false;
 	}
 	std::lock_guard<std::mutex> lock(_general_mutex);
-	auto it = _backend.find(key);
-	if (it != _backend.end()) {
-		return Set(it->second, value);
+	ApplyReads();
+	if (_admission) {
+		_admission->Record(key);
+	}
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot != nullptr) {
+		return Set(*slot, value, meta);
 	}
 
-	return PutFast(key, value);
+	return PutFast(key, value, meta);
 }
 
 // See MapBasedGlobalLockImpl.h
 bool MapBasedGlobalLockImpl::PutIfAbsent(const std::string &key, const std::string &value) {
-	if ((key.size() + value.size()) > _max_size) {
+	return PutIfAbsent(key, value, Metadata());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) {
+	if (ItemSize(key.size(), value.size()) > _max_size) {
 		return false;
 	}
 	std::lock_guard<std::mutex> lock(_general_mutex);
-	auto it = _backend.find(key);
-	if (it != _backend.end()) {
-		return false;
+	ApplyReads();
+	if (_admission) {
+		_admission->Record(key);
+	}
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot != nullptr) {
+		if (!(*slot)->expired(time(nullptr))) {
+			return false;
+		}
+		DeleteUnsafe(slot);
 	}
 
-	return PutFast(key, value);
+	return PutFast(key, value, meta);
 }
 
-bool MapBasedGlobalLockImpl::PutFast(const std::string &key, const std::string &value) {
-	auto e = _list.Put(key, value);
-	_backend[e->key] = e;
-	_size += e->size();
+bool MapBasedGlobalLockImpl::PutFast(const std::string &key, const std::string &value, const Metadata &meta) {
+	// Newcomer that doesn't fit has to beat the entry it would push out
+	if (_admission && !_backend.empty() &&
+	    (_size + ItemSize(key.size(), value.size())) > _max_size &&
+	    !_admission->Admit(key, _policy->Tail()->key())) {
+		return false;
+	}
+
+	auto e = _policy->Put(key, value, meta);
+	e->meta.cas = ++_cas;
+	_backend.Insert(e);
+	_size += ItemSize(e);
+	_wheel.Schedule(e);
 
 	Trim();
 
@@ -45,67 +83,276 @@ bool MapBasedGlobalLockImpl::PutFast(const std::string &key, const std::string &
 
 // See MapBasedGlobalLockImpl.h
 bool MapBasedGlobalLockImpl::Set(const std::string &key, const std::string &value) {
-	if ((key.size() + value.size()) > _max_size) {
+	return Set(key, value, Metadata());
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Set(const std::string &key, const std::string &value, const Metadata &meta) {
+	if (ItemSize(key.size(), value.size()) > _max_size) {
 		return false;
 	}
 	std::lock_guard<std::mutex> lock(_general_mutex);
-	auto it = _backend.find(key);
-	if (it == _backend.end()) {
+	ApplyReads();
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
 		return false;
 	}
 
-	Set(it->second, value);
+	Set(*slot, value, meta);
 
 	return true;
 }
 
-bool MapBasedGlobalLockImpl::Set(LinkedList::Entry* e, const std::string& value) {
-	_size -= e->size();
-	e->value = value;
-	_size += e->size();
-	_list.Up(e);
+bool MapBasedGlobalLockImpl::Set(LinkedList::Entry* e, const std::string& value, const Metadata &meta) {
+	_size -= ItemSize(e);
+	e->set_value(value);
+	e->meta = meta;
+	e->meta.cas = ++_cas;
+	_size += ItemSize(e);
+	_policy->Up(e);
+	_wheel.Schedule(e);
+
+	Trim();
+
+	return true;
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Append(const std::string &key, const std::string &data) {
+	return Concat(key, data, false);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Prepend(const std::string &key, const std::string &data) {
+	return Concat(key, data, true);
+}
+
+bool MapBasedGlobalLockImpl::Concat(const std::string &key, const std::string &data, bool prepend) {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	ApplyReads();
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
+		return false;
+	}
+
+	LinkedList::Entry *e = *slot;
+	if (ItemSize(e->key_size(), e->value_size() + data.size()) > _max_size) {
+		return false;
+	}
+
+	size_t old_size = ItemSize(e);
+	e->Concat(data, prepend);
+	e->meta.cas = ++_cas;
+	_size = _size - old_size + ItemSize(e);
+	_policy->Up(e);
 
 	Trim();
 
 	return true;
 }
 
+// See MapBasedGlobalLockImpl.h
+Storage::ArithmeticResult MapBasedGlobalLockImpl::Increment(const std::string &key, uint64_t delta, uint64_t &result) {
+	return Arithmetic(key, delta, false, result);
+}
+
+// See MapBasedGlobalLockImpl.h
+Storage::ArithmeticResult MapBasedGlobalLockImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &result) {
+	return Arithmetic(key, delta, true, result);
+}
+
+Storage::ArithmeticResult MapBasedGlobalLockImpl::Arithmetic(const std::string &key, uint64_t delta, bool decrement,
+                                                             uint64_t &result) {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	ApplyReads();
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
+		return ArithmeticResult::NotFound;
+	}
+
+	LinkedList::Entry *e = *slot;
+	size_t old_size = ItemSize(e);
+	if (!e->Increment(delta, decrement, result)) {
+		return ArithmeticResult::NonNumeric;
+	}
+
+	e->meta.cas = ++_cas;
+	_size = _size - old_size + ItemSize(e);
+	_policy->Up(e);
+
+	Trim();
+
+	return ArithmeticResult::Stored;
+}
+
+// See MapBasedGlobalLockImpl.h
+Storage::CasResult MapBasedGlobalLockImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                          const Metadata &meta, uint64_t cas) {
+	if (ItemSize(key.size(), value.size()) > _max_size) {
+		return CasResult::NotStored;
+	}
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	ApplyReads();
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
+		return CasResult::NotFound;
+	}
+	if ((*slot)->meta.cas != cas) {
+		return CasResult::Exists;
+	}
+
+	Set(*slot, value, meta);
+
+	return CasResult::Stored;
+}
+
 // See MapBasedGlobalLockImpl.h
 bool MapBasedGlobalLockImpl::Delete(const std::string &key) {
 	std::lock_guard<std::mutex> lock(_general_mutex);
-	return DeleteUnsafe(key);
+	ApplyReads();
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr) {
+		return false;
+	}
+
+	// Expired entry is gone anyway, but for the client it was never there
+	bool expired = (*slot)->expired(time(nullptr));
+	DeleteUnsafe(slot);
+	return !expired;
 }
 
-bool MapBasedGlobalLockImpl::DeleteUnsafe(const std::string &key) {
-	auto it = _backend.find(key);
-	if (it == _backend.end()) {
+void MapBasedGlobalLockImpl::DeleteUnsafe(SwissIndex::Slot *slot) {
+	_size -= ItemSize(*slot);
+	_wheel.Remove(*slot);
+	_policy->Delete(*slot);
+	_backend.Erase(slot);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Get(const std::string &key, std::string &value) const {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	if (_admission) {
+		_admission->Record(key);
+	}
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
 		return false;
 	}
 
-	_size -= it->second->size();
-	_list.Delete(it->second);
-	_backend.erase(it);
+	(*slot)->copy_value(value);
+	Promote(*slot);
 
 	return true;
 }
 
 // See MapBasedGlobalLockImpl.h
-bool MapBasedGlobalLockImpl::Get(const std::string &key, std::string &value) const {
+bool MapBasedGlobalLockImpl::Get(const std::string &key, Value &value) const {
+	Metadata meta;
+	return Get(key, value, meta);
+}
+
+// See MapBasedGlobalLockImpl.h
+bool MapBasedGlobalLockImpl::Get(const std::string &key, Value &value, Metadata &meta) const {
 	std::lock_guard<std::mutex> lock(_general_mutex);
-	auto it = _backend.find(key);
-	if (it == _backend.end()) {
+	if (_admission) {
+		_admission->Record(key);
+	}
+	SwissIndex::Slot *slot = _backend.Find(key);
+	if (slot == nullptr || (*slot)->expired(time(nullptr))) {
 		return false;
 	}
 
-	value = it->second->value;
-	_list.Up(it->second);
+	value = (*slot)->pin_value();
+	meta = (*slot)->meta;
+	Promote(*slot);
 
 	return true;
 }
 
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	ApplyReads();
+	_policy->Stats(stats);
+	if (_admission) {
+		_admission->Stats(stats);
+	} else {
+		stats.emplace_back("admission", "none");
+	}
+	stats.emplace_back("promotion", _reads.empty() ? "immediate" : "batched");
+	stats.emplace_back("promotions_dropped", std::to_string(_reads_dropped));
+	stats.emplace_back("curr_items", std::to_string(_backend.size()));
+	stats.emplace_back("bytes", std::to_string(_size));
+	stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+	stats.emplace_back("index_bytes", std::to_string(_backend.memory()));
+}
+
+// See MapBasedGlobalLockImpl.h
+size_t MapBasedGlobalLockImpl::Size() const {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	return _size;
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::SetMaxSize(size_t max_size) {
+	std::lock_guard<std::mutex> lock(_general_mutex);
+	ApplyReads();
+	_max_size = max_size;
+	Trim();
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Expire(time_t now) {
+	// Wheel is moved forward by small steps, so that lock is never held for too long
+	bool done = false;
+	while (!done) {
+		std::lock_guard<std::mutex> lock(_general_mutex);
+		ApplyReads();
+		done = _wheel.Advance(now, [this](LinkedList::Entry *e) { DeleteUnsafe(_backend.Find(e)); }, 16);
+	}
+}
+
+// See MapBasedGlobalLockImpl.h
+void MapBasedGlobalLockImpl::Rebalance(time_t now) {
+	// Entries are deleted by small batches for the same reason
+	bool done = false;
+	while (!done) {
+		std::lock_guard<std::mutex> lock(_general_mutex);
+		ApplyReads();
+		for (int i = 0; i < 16 && !done; i++) {
+			LinkedList::Entry *e = _policy->Rebalance(now);
+			if (e != nullptr) {
+				DeleteUnsafe(_backend.Find(e));
+			} else {
+				done = true;
+			}
+		}
+	}
+}
+
+void MapBasedGlobalLockImpl::Promote(LinkedList::Entry *e) const {
+	if (_reads.empty()) {
+		_policy->Up(e);
+		return;
+	}
+
+	// Buffer is full: the oldest hit is lost, recent ones matter more for the eviction order
+	if (_reads_tail - _reads_head == _reads.size()) {
+		_reads_head++;
+		_reads_dropped++;
+	}
+	_reads[_reads_tail++ % _reads.size()] = e;
+}
+
+void MapBasedGlobalLockImpl::ApplyReads() const {
+	for (; _reads_head != _reads_tail; _reads_head++) {
+		_policy->Up(_reads[_reads_head % _reads.size()]);
+	}
+}
+
 void MapBasedGlobalLockImpl::Trim() {
 	while (_size > _max_size) {
-		DeleteUnsafe(_list.Tail()->key);
+		DeleteUnsafe(_backend.Find(_policy->Tail()));
 	}
 }
 
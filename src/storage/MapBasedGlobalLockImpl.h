@@ -1,14 +1,21 @@
 #ifndef AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 #define AFINA_STORAGE_MAP_BASED_GLOBAL_LOCK_IMPL_H
 
-#include <unordered_map>
+#include <atomic>
+#include <memory>
 #include <mutex>
 #include <string>
+#include <vector>
 
 #include <functional>
 
 #include <afina/Storage.h>
+#include "EvictionPolicy.h"
 #include "LinkedList.h"
+#include "PeriodicTask.h"
+#include "SwissIndex.h"
+#include "TimerWheel.h"
+#include "TinyLfu.h"
 
 namespace Afina {
 namespace Backend {
@@ -20,39 +27,159 @@ namespace Backend {
  */
 class MapBasedGlobalLockImpl : public Afina::Storage {
 public:
-    MapBasedGlobalLockImpl(size_t max_size = 1048576) : _max_size(max_size), _size(0) {}
+    // Number of reads batched promotion remembers, older ones are overwritten
+    static constexpr size_t READ_BUFFER_SIZE = 256;
+
+    /**
+     * @param admission put TinyLFU filter in front of the eviction policy: once storage is full new
+     * key is stored only if it is used more often than the entry it would evict
+     * @param batch_promotions Get doesn't move entry in the eviction policy, it only records the hit
+     * in a ring buffer. Buffered hits are applied to the policy in order by the next writer, so reads
+     * spend less time under the lock. Only the last READ_BUFFER_SIZE hits are kept
+     */
+    MapBasedGlobalLockImpl(size_t max_size = 1048576, EvictionPolicy::Type eviction = EvictionPolicy::Type::Lru,
+                           bool admission = false, bool batch_promotions = false)
+        : _max_size(max_size), _policy(EvictionPolicy::Create(eviction)),
+          _admission(admission ? new TinyLfu(max_size) : nullptr), _size(0),
+          _reads(batch_promotions ? READ_BUFFER_SIZE : 0), _reads_head(0), _reads_tail(0), _reads_dropped(0),
+          _cas(0), _wheel(time(nullptr)), _expirer(
+              [this]() {
+                  time_t now = time(nullptr);
+                  Expire(now);
+                  Rebalance(now);
+              },
+              std::chrono::seconds(1)) {}
     ~MapBasedGlobalLockImpl() {}
 
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
     // Implements Afina::Storage interface
     bool Put(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
     // Implements Afina::Storage interface
     bool PutIfAbsent(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) override;
+
     // Implements Afina::Storage interface
     bool Set(const std::string &key, const std::string &value) override;
 
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Increment(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Decrement(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, const Metadata &meta,
+                             uint64_t cas) override;
+
     // Implements Afina::Storage interface
     bool Delete(const std::string &key) override;
 
     // Implements Afina::Storage interface
     bool Get(const std::string &key, std::string &value) const override;
 
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value, Metadata &meta) const override;
+
+    // Implements Afina::Storage interface
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    size_t Size() const override;
+
+    // Implements Afina::Storage interface
+    void SetMaxSize(size_t max_size) override;
+
+    /**
+     * Bytes item with key and value of the given sizes is accounted for: entry allocation and its
+     * share of the index
+     */
+    static size_t ItemSize(size_t key_size, size_t value_size) {
+        return LinkedList::Entry::Footprint(key_size, value_size) + SwissIndex::ENTRY_OVERHEAD;
+    }
+
+    /**
+     * Name of the eviction policy storage uses
+     */
+    const char *eviction_policy() const { return _policy->Name(); }
+
+    /**
+     * Reclaim all entries expired by the given time. Storage calls it once a second in
+     * background between Start and Stop
+     */
+    void Expire(time_t now);
+
+    /**
+     * Deletes entries eviction policy picks to move memory where it is needed, see
+     * EvictionPolicy::Rebalance. Storage calls it once a second in background between Start and Stop
+     */
+    void Rebalance(time_t now);
+
 private:
-    bool Set(LinkedList::Entry* e, const std::string& value);
-    bool PutFast(const std::string &key, const std::string &value);
-    bool DeleteUnsafe(const std::string &key);
+    bool Set(LinkedList::Entry* e, const std::string& value, const Metadata &meta);
+    bool PutFast(const std::string &key, const std::string &value, const Metadata &meta);
+    bool Concat(const std::string &key, const std::string &data, bool prepend);
+    ArithmeticResult Arithmetic(const std::string &key, uint64_t delta, bool decrement, uint64_t &result);
+    void DeleteUnsafe(SwissIndex::Slot *slot);
     void Trim();
 
-    size_t _max_size;
-    std::unordered_map<std::reference_wrapper<const std::string>,
-                        LinkedList::Entry*,
-                        std::hash<std::string>,
-                        std::equal_to<std::string>> _backend;
+    static size_t ItemSize(const LinkedList::Entry *e) { return e->size() + SwissIndex::ENTRY_OVERHEAD; }
+
+    // Tells eviction policy about the hit, right away or through the read buffer
+    void Promote(LinkedList::Entry *e) const;
+
+    // Applies buffered hits, writers call it right after taking the lock so buffer never refers
+    // to deleted entries
+    void ApplyReads() const;
+
+    // Could be changed at any time, item that doesn't fit is rejected before taking the lock
+    std::atomic<size_t> _max_size;
+    SwissIndex _backend;
 
-    mutable LinkedList _list;
+    // Owns entries and picks the ones to evict
+    std::unique_ptr<EvictionPolicy> _policy;
+
+    // Admission filter, nullptr if every new key is stored
+    std::unique_ptr<TinyLfu> _admission;
     size_t _size;
     mutable std::mutex _general_mutex;
+
+    // Ring buffer of hits not yet applied to the policy, empty if promotions aren't batched
+    mutable std::vector<LinkedList::Entry *> _reads;
+    mutable size_t _reads_head;
+    mutable size_t _reads_tail;
+    mutable size_t _reads_dropped;
+
+    // Last version assigned to an entry
+    uint64_t _cas;
+
+    // Entries with expiration time set
+    TimerWheel _wheel;
+
+    // Background task moving _wheel forward, must be the last one to be destroyed first
+    PeriodicTask _expirer;
 };
 
 } // namespace Backend
@@ -0,0 +1,454 @@
+#include "MapBasedLockFreeImpl.h"
+
+namespace Afina {
+namespace Backend {
+
+namespace {
+
+// Number of retired entries to collect before trying to free them
+constexpr size_t RECLAIM_BATCH = 64;
+
+void DeleteEntry(void *e) { delete static_cast<LinkedList::Entry *>(e); }
+
+} // namespace
+
+constexpr size_t MapBasedLockFreeImpl::AccessBuffer::SIZE;
+
+MapBasedLockFreeImpl::MapBasedLockFreeImpl(size_t max_size, EvictionPolicy::Type eviction)
+    : _max_size(max_size), _policy(EvictionPolicy::Create(eviction)), _index(_reclaimer), _size(0), _cas(0),
+      _wheel(time(nullptr)), _buffers(nullptr), _buffer(nullptr, LeaveBuffer),
+      _expirer(
+          [this]() {
+              time_t now = time(nullptr);
+              Expire(now);
+              Rebalance(now);
+          },
+          std::chrono::seconds(1)) {}
+
+MapBasedLockFreeImpl::~MapBasedLockFreeImpl() {
+    AccessBuffer *buffer = _buffers.load(std::memory_order_acquire);
+    while (buffer != nullptr) {
+        AccessBuffer *next = buffer->next;
+        delete buffer;
+        buffer = next;
+    }
+}
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::Start() { _expirer.Start(); }
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::Stop() { _expirer.Stop(); }
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Put(const std::string &key, const std::string &value) {
+    return Put(key, value, Metadata());
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = _index.Find(key, hash);
+    if (e == nullptr) {
+        return Insert(key, hash, value, meta);
+    }
+
+    LinkedList::Entry *updated = _policy->Put(key, value, meta);
+    updated->meta.cas = ++_cas;
+    Replace(e, hash, updated);
+    return true;
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::PutIfAbsent(const std::string &key, const std::string &value) {
+    return PutIfAbsent(key, value, Metadata());
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    if (FindAlive(key, hash) != nullptr) {
+        return false;
+    }
+    return Insert(key, hash, value, meta);
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Set(const std::string &key, const std::string &value) {
+    return Set(key, value, Metadata());
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Set(const std::string &key, const std::string &value, const Metadata &meta) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
+        return false;
+    }
+
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = FindAlive(key, hash);
+    if (e == nullptr) {
+        return false;
+    }
+
+    LinkedList::Entry *updated = _policy->Put(key, value, meta);
+    updated->meta.cas = ++_cas;
+    Replace(e, hash, updated);
+    return true;
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Append(const std::string &key, const std::string &data) {
+    return Concat(key, data, false);
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Prepend(const std::string &key, const std::string &data) {
+    return Concat(key, data, true);
+}
+
+bool MapBasedLockFreeImpl::Concat(const std::string &key, const std::string &data, bool prepend) {
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = FindAlive(key, hash);
+    if (e == nullptr || ItemSize(key.size(), e->value_size() + data.size()) > _max_size) {
+        return false;
+    }
+
+    // Readers could be copying the value right now, so the new entry gets its own copy
+    std::string value;
+    value.reserve(e->value_size() + data.size());
+    if (prepend) {
+        value.append(data);
+    }
+    value.append(e->value_data(), e->value_size());
+    if (!prepend) {
+        value.append(data);
+    }
+
+    LinkedList::Entry *updated = _policy->Put(key, value, e->meta);
+    updated->meta.cas = ++_cas;
+    Replace(e, hash, updated);
+    return true;
+}
+
+// See MapBasedLockFreeImpl.h
+Storage::ArithmeticResult MapBasedLockFreeImpl::Increment(const std::string &key, uint64_t delta, uint64_t &result) {
+    return Arithmetic(key, delta, false, result);
+}
+
+// See MapBasedLockFreeImpl.h
+Storage::ArithmeticResult MapBasedLockFreeImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &result) {
+    return Arithmetic(key, delta, true, result);
+}
+
+Storage::ArithmeticResult MapBasedLockFreeImpl::Arithmetic(const std::string &key, uint64_t delta, bool decrement,
+                                                           uint64_t &result) {
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = FindAlive(key, hash);
+    if (e == nullptr) {
+        return ArithmeticResult::NotFound;
+    }
+
+    LinkedList::Entry *updated = _policy->Put(key, std::string(e->value_data(), e->value_size()), e->meta);
+    if (!updated->Increment(delta, decrement, result)) {
+        _policy->Delete(updated);
+        return ArithmeticResult::NonNumeric;
+    }
+
+    updated->meta.cas = ++_cas;
+    Replace(e, hash, updated);
+    return ArithmeticResult::Stored;
+}
+
+// See MapBasedLockFreeImpl.h
+Storage::CasResult MapBasedLockFreeImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                        const Metadata &meta, uint64_t cas) {
+    if (ItemSize(key.size(), value.size()) > _max_size) {
+        return CasResult::NotStored;
+    }
+
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = FindAlive(key, hash);
+    if (e == nullptr) {
+        return CasResult::NotFound;
+    }
+    if (e->meta.cas != cas) {
+        return CasResult::Exists;
+    }
+
+    LinkedList::Entry *updated = _policy->Put(key, value, meta);
+    updated->meta.cas = ++_cas;
+    Replace(e, hash, updated);
+    return CasResult::Stored;
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Delete(const std::string &key) {
+    uint64_t hash = LockFreeIndex::Hash(key);
+    std::lock_guard<std::mutex> lock(_mutex);
+    LinkedList::Entry *e = _index.Find(key, hash);
+    if (e == nullptr) {
+        return false;
+    }
+
+    // Expired entry is gone anyway, but for the client it was never there
+    bool expired = e->expired(time(nullptr));
+    Remove(e, hash);
+    return !expired;
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Get(const std::string &key, std::string &value) const {
+    uint64_t hash = LockFreeIndex::Hash(key);
+    bool drain;
+    {
+        EpochReclaimer::Guard guard(_reclaimer);
+        LinkedList::Entry *e = _index.Find(key, hash);
+        if (e == nullptr || e->expired(time(nullptr))) {
+            return false;
+        }
+
+        e->copy_value(value);
+        drain = Touch(e, hash);
+    }
+
+    if (drain) {
+        TryDrain();
+    }
+    return true;
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Get(const std::string &key, Value &value) const {
+    Metadata meta;
+    return Get(key, value, meta);
+}
+
+// See MapBasedLockFreeImpl.h
+bool MapBasedLockFreeImpl::Get(const std::string &key, Value &value, Metadata &meta) const {
+    uint64_t hash = LockFreeIndex::Hash(key);
+    bool drain;
+    {
+        EpochReclaimer::Guard guard(_reclaimer);
+        LinkedList::Entry *e = _index.Find(key, hash);
+        if (e == nullptr || e->expired(time(nullptr))) {
+            return false;
+        }
+
+        value = e->pin_value();
+        meta = e->meta;
+        drain = Touch(e, hash);
+    }
+
+    if (drain) {
+        TryDrain();
+    }
+    return true;
+}
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    size_t dropped = 0;
+    for (AccessBuffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        dropped += buffer->dropped.load(std::memory_order_relaxed);
+    }
+
+    std::lock_guard<std::mutex> lock(_mutex);
+    _policy->Stats(stats);
+    stats.emplace_back("retired_entries", std::to_string(_reclaimer.pending()));
+    stats.emplace_back("dropped_reads", std::to_string(dropped));
+    stats.emplace_back("curr_items", std::to_string(_index.size()));
+    stats.emplace_back("bytes", std::to_string(_size));
+    stats.emplace_back("limit_maxbytes", std::to_string(_max_size));
+    stats.emplace_back("index_bytes", std::to_string(_index.memory()));
+}
+
+// See MapBasedLockFreeImpl.h
+size_t MapBasedLockFreeImpl::Size() const {
+    std::lock_guard<std::mutex> lock(_mutex);
+    return _size;
+}
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::SetMaxSize(size_t max_size) {
+    std::lock_guard<std::mutex> lock(_mutex);
+    _max_size = max_size;
+    Trim();
+}
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::Expire(time_t now) {
+    // Wheel is moved forward by small steps, so that lock is never held for too long
+    bool done = false;
+    while (!done) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        done = _wheel.Advance(now, [this](LinkedList::Entry *e) { Remove(e, e->key_hash()); }, 16);
+    }
+}
+
+// See MapBasedLockFreeImpl.h
+void MapBasedLockFreeImpl::Rebalance(time_t now) {
+    // Entries are deleted by small batches for the same reason
+    bool done = false;
+    while (!done) {
+        std::lock_guard<std::mutex> lock(_mutex);
+        for (int i = 0; i < 16 && !done; i++) {
+            LinkedList::Entry *e = _policy->Rebalance(now);
+            if (e != nullptr) {
+                Remove(e, e->key_hash());
+            } else {
+                done = true;
+            }
+        }
+    }
+}
+
+bool MapBasedLockFreeImpl::Touch(LinkedList::Entry *e, uint64_t hash) const {
+    AccessBuffer *buffer = LocalBuffer();
+    size_t tail = buffer->tail.load(std::memory_order_relaxed);
+    size_t head = buffer->head.load(std::memory_order_acquire);
+    if (tail - head >= AccessBuffer::SIZE) {
+        buffer->dropped.store(buffer->dropped.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+        return true;
+    }
+
+    buffer->records[tail % AccessBuffer::SIZE] = AccessBuffer::Record{e, hash};
+    buffer->tail.store(tail + 1, std::memory_order_release);
+    return (tail + 1 - head) >= AccessBuffer::SIZE / 2;
+}
+
+void MapBasedLockFreeImpl::TryDrain() const {
+    // Readers never wait: if writer holds the lock it will drain buffers itself before eviction
+    std::unique_lock<std::mutex> lock(_mutex, std::try_to_lock);
+    if (lock.owns_lock()) {
+        Drain();
+    }
+}
+
+void MapBasedLockFreeImpl::Drain() const {
+    for (AccessBuffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        size_t head = buffer->head.load(std::memory_order_relaxed);
+        size_t tail = buffer->tail.load(std::memory_order_acquire);
+        for (; head != tail; head++) {
+            // Entry could be replaced or deleted since it was read, maybe even freed. Only live
+            // entries are promoted, checking that doesn't touch entry memory
+            const AccessBuffer::Record &record = buffer->records[head % AccessBuffer::SIZE];
+            if (_index.Contains(record.e, record.hash)) {
+                _policy->Up(record.e);
+            }
+        }
+        buffer->head.store(tail, std::memory_order_release);
+    }
+}
+
+MapBasedLockFreeImpl::AccessBuffer *MapBasedLockFreeImpl::LocalBuffer() const {
+    AccessBuffer *result = _buffer.get();
+    if (result != nullptr) {
+        return result;
+    }
+
+    for (AccessBuffer *buffer = _buffers.load(std::memory_order_acquire); buffer != nullptr; buffer = buffer->next) {
+        bool expected = false;
+        if (!buffer->in_use.load(std::memory_order_relaxed) &&
+            buffer->in_use.compare_exchange_strong(expected, true, std::memory_order_acquire)) {
+            result = buffer;
+            break;
+        }
+    }
+
+    if (result == nullptr) {
+        result = new AccessBuffer();
+        result->head.store(0, std::memory_order_relaxed);
+        result->tail.store(0, std::memory_order_relaxed);
+        result->dropped.store(0, std::memory_order_relaxed);
+        result->in_use.store(true, std::memory_order_relaxed);
+        result->next = _buffers.load(std::memory_order_relaxed);
+        while (!_buffers.compare_exchange_weak(result->next, result, std::memory_order_release,
+                                               std::memory_order_relaxed)) {
+        }
+    }
+
+    _buffer.set(result);
+    return result;
+}
+
+void MapBasedLockFreeImpl::LeaveBuffer(void *buffer) {
+    static_cast<AccessBuffer *>(buffer)->in_use.store(false, std::memory_order_release);
+}
+
+bool MapBasedLockFreeImpl::Insert(const std::string &key, uint64_t hash, const std::string &value,
+                                  const Metadata &meta) {
+    LinkedList::Entry *e = _policy->Put(key, value, meta);
+    e->meta.cas = ++_cas;
+    _index.Insert(e, hash);
+    _size += ItemSize(e);
+    _wheel.Schedule(e);
+
+    Trim();
+
+    return true;
+}
+
+void MapBasedLockFreeImpl::Replace(LinkedList::Entry *old, uint64_t hash, LinkedList::Entry *e) {
+    _index.Replace(old, e, hash);
+    _size = _size - ItemSize(old) + ItemSize(e);
+    _wheel.Remove(old);
+    _policy->Release(old);
+    _reclaimer.Retire(old, DeleteEntry);
+    _wheel.Schedule(e);
+
+    Trim();
+}
+
+void MapBasedLockFreeImpl::Remove(LinkedList::Entry *e, uint64_t hash) {
+    _index.Erase(e, hash);
+    _size -= ItemSize(e);
+    _wheel.Remove(e);
+    _policy->Release(e);
+    _reclaimer.Retire(e, DeleteEntry);
+
+    if (_reclaimer.pending() >= RECLAIM_BATCH) {
+        _reclaimer.Reclaim();
+    }
+}
+
+LinkedList::Entry *MapBasedLockFreeImpl::FindAlive(const std::string &key, uint64_t hash) {
+    LinkedList::Entry *e = _index.Find(key, hash);
+    if (e != nullptr && e->expired(time(nullptr))) {
+        Remove(e, hash);
+        return nullptr;
+    }
+    return e;
+}
+
+void MapBasedLockFreeImpl::Trim() {
+    if (_size <= _max_size) {
+        if (_reclaimer.pending() >= RECLAIM_BATCH) {
+            _reclaimer.Reclaim();
+        }
+        return;
+    }
+
+    // Victim is picked by the policy, so it must know about the recent reads
+    Drain();
+    while (_size > _max_size) {
+        LinkedList::Entry *victim = _policy->Tail();
+        Remove(victim, victim->key_hash());
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,200 @@
+#ifndef AFINA_STORAGE_MAP_BASED_LOCK_FREE_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_LOCK_FREE_IMPL_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+
+#include <afina/Storage.h>
+#include "EpochReclaimer.h"
+#include "EvictionPolicy.h"
+#include "LinkedList.h"
+#include "LockFreeIndex.h"
+#include "PeriodicTask.h"
+#include "ThreadLocal.h"
+#include "TimerWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation with lock-free reads
+ * Reads never take a lock: key is looked up in LockFreeIndex under epoch guard and the value is
+ * copied out of the entry. Published entries are immutable, every modification builds a new entry
+ * and swaps it into the index, old one is retired to EpochReclaimer and freed once no reader could
+ * see it anymore. Writers are serialized by a single mutex, readers never block them.
+ *
+ * Reads don't touch eviction policy directly. Each thread records entries it read into its own
+ * bounded buffer, buffers are applied to the policy in batches by whoever holds the writers lock:
+ * reader that filled half of its buffer if lock is free, or writer right before picking the
+ * victim. Records that don't fit into a full buffer are dropped, policy order is approximate
+ */
+class MapBasedLockFreeImpl : public Afina::Storage {
+public:
+    MapBasedLockFreeImpl(size_t max_size = 1048576, EvictionPolicy::Type eviction = EvictionPolicy::Type::Lru);
+    ~MapBasedLockFreeImpl();
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Increment(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Decrement(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, const Metadata &meta,
+                             uint64_t cas) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value, Metadata &meta) const override;
+
+    // Implements Afina::Storage interface
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    size_t Size() const override;
+
+    // Implements Afina::Storage interface
+    void SetMaxSize(size_t max_size) override;
+
+    /**
+     * Bytes item with key and value of the given sizes is accounted for: entry allocation and its
+     * share of the index
+     */
+    static size_t ItemSize(size_t key_size, size_t value_size) {
+        return LinkedList::Entry::Footprint(key_size, value_size) + LockFreeIndex::ENTRY_OVERHEAD;
+    }
+
+    /**
+     * Reclaim all entries expired by the given time. Storage calls it once a second in
+     * background between Start and Stop
+     */
+    void Expire(time_t now);
+
+    /**
+     * Deletes entries eviction policy picks to move memory where it is needed, see
+     * EvictionPolicy::Rebalance. Storage calls it once a second in background between Start and Stop
+     */
+    void Rebalance(time_t now);
+
+private:
+    // Entries read by a single thread and not yet applied to the eviction policy. Owner thread
+    // appends to the tail, lock holder consumes from the head
+    struct AccessBuffer {
+        static constexpr size_t SIZE = 64;
+
+        struct Record {
+            LinkedList::Entry *e;
+            uint64_t hash;
+        };
+        Record records[SIZE];
+
+        std::atomic<size_t> head;
+        std::atomic<size_t> tail;
+
+        // Records thrown away as buffer was full
+        std::atomic<size_t> dropped;
+
+        // Buffers outlive threads, exited thread leaves its buffer for the next one
+        std::atomic<bool> in_use;
+        AccessBuffer *next;
+    };
+
+    /**
+     * Records read of the entry, must be called under epoch guard
+     *
+     * @return true if buffer should be drained
+     */
+    bool Touch(LinkedList::Entry *e, uint64_t hash) const;
+
+    /**
+     * Applies recorded reads to the eviction policy if no one holds the lock
+     */
+    void TryDrain() const;
+
+    AccessBuffer *LocalBuffer() const;
+    static void LeaveBuffer(void *buffer);
+
+    // Methods below must be called under the lock
+    bool Insert(const std::string &key, uint64_t hash, const std::string &value, const Metadata &meta);
+    void Replace(LinkedList::Entry *old, uint64_t hash, LinkedList::Entry *e);
+    void Remove(LinkedList::Entry *e, uint64_t hash);
+    LinkedList::Entry *FindAlive(const std::string &key, uint64_t hash);
+    bool Concat(const std::string &key, const std::string &data, bool prepend);
+    ArithmeticResult Arithmetic(const std::string &key, uint64_t delta, bool decrement, uint64_t &result);
+    void Drain() const;
+    void Trim();
+
+    static size_t ItemSize(const LinkedList::Entry *e) { return e->size() + LockFreeIndex::ENTRY_OVERHEAD; }
+
+    // Could be changed at any time, item that doesn't fit is rejected before taking the lock
+    std::atomic<size_t> _max_size;
+
+    // Declared first to be destroyed last: it frees retired entries and index tables
+    mutable EpochReclaimer _reclaimer;
+
+    // Owns entries and picks the ones to evict
+    std::unique_ptr<EvictionPolicy> _policy;
+    LockFreeIndex _index;
+    size_t _size;
+
+    // Serializes writers and access to the eviction policy
+    mutable std::mutex _mutex;
+
+    // Last version assigned to an entry
+    uint64_t _cas;
+
+    // Entries with expiration time set
+    TimerWheel _wheel;
+
+    // Access buffers of all threads ever read from the storage
+    mutable std::atomic<AccessBuffer *> _buffers;
+    mutable ThreadLocal<AccessBuffer> _buffer;
+
+    // Background task moving _wheel forward, must be the last one to be destroyed first
+    PeriodicTask _expirer;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_LOCK_FREE_IMPL_H
@@ -0,0 +1,180 @@
+#include "MapBasedShardedImpl.h"
+
+#include <algorithm>
+#include <cstdint>
+#include <functional>
+
+namespace Afina {
+namespace Backend {
+
+MapBasedShardedImpl::MapBasedShardedImpl(size_t max_size, size_t n_shards, EvictionPolicy::Type eviction,
+                                         bool admission, bool batch_promotions)
+    : _shard_bits(0), _expirer(
+                          [this]() {
+                              time_t now = time(nullptr);
+                              Expire(now);
+                              Rebalance(now);
+                          },
+                          std::chrono::seconds(1)) {
+    // Round number of shards up to the power of two, so that shard could be
+    // selected by the hash bits only
+    while ((size_t(1) << _shard_bits) < n_shards) {
+        _shard_bits++;
+    }
+
+    size_t total = size_t(1) << _shard_bits;
+    _shards.reserve(total);
+    for (size_t i = 0; i < total; i++) {
+        _shards.emplace_back(new MapBasedGlobalLockImpl(max_size / total, eviction, admission, batch_promotions));
+    }
+}
+
+MapBasedGlobalLockImpl &MapBasedShardedImpl::Shard(const std::string &key) const {
+    if (_shard_bits == 0) {
+        return *_shards[0];
+    }
+
+    // Shards and maps inside of them are using the same hash function, so low bits are already
+    // spent on map buckets. Mix hash with golden ratio and take the top bits instead
+    uint64_t hash = std::hash<std::string>()(key);
+    hash *= 0x9E3779B97F4A7C15ULL;
+    return *_shards[hash >> (64 - _shard_bits)];
+}
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::Start() { _expirer.Start(); }
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::Stop() { _expirer.Stop(); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Put(const std::string &key, const std::string &value) { return Shard(key).Put(key, value); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Put(const std::string &key, const std::string &value, const Metadata &meta) {
+    return Shard(key).Put(key, value, meta);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::PutIfAbsent(const std::string &key, const std::string &value) {
+    return Shard(key).PutIfAbsent(key, value);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) {
+    return Shard(key).PutIfAbsent(key, value, meta);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Set(const std::string &key, const std::string &value) { return Shard(key).Set(key, value); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Set(const std::string &key, const std::string &value, const Metadata &meta) {
+    return Shard(key).Set(key, value, meta);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Append(const std::string &key, const std::string &data) {
+    return Shard(key).Append(key, data);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Prepend(const std::string &key, const std::string &data) {
+    return Shard(key).Prepend(key, data);
+}
+
+// See MapBasedShardedImpl.h
+Storage::ArithmeticResult MapBasedShardedImpl::Increment(const std::string &key, uint64_t delta, uint64_t &result) {
+    return Shard(key).Increment(key, delta, result);
+}
+
+// See MapBasedShardedImpl.h
+Storage::ArithmeticResult MapBasedShardedImpl::Decrement(const std::string &key, uint64_t delta, uint64_t &result) {
+    return Shard(key).Decrement(key, delta, result);
+}
+
+// See MapBasedShardedImpl.h
+Storage::CasResult MapBasedShardedImpl::CompareAndSwap(const std::string &key, const std::string &value,
+                                                       const Metadata &meta, uint64_t cas) {
+    return Shard(key).CompareAndSwap(key, value, meta, cas);
+}
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Delete(const std::string &key) { return Shard(key).Delete(key); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Get(const std::string &key, std::string &value) const { return Shard(key).Get(key, value); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Get(const std::string &key, Value &value) const { return Shard(key).Get(key, value); }
+
+// See MapBasedShardedImpl.h
+bool MapBasedShardedImpl::Get(const std::string &key, Value &value, Metadata &meta) const {
+    return Shard(key).Get(key, value, meta);
+}
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::Expire(time_t now) {
+    for (auto &shard : _shards) {
+        shard->Expire(now);
+    }
+}
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::Rebalance(time_t now) {
+    for (auto &shard : _shards) {
+        shard->Rebalance(now);
+    }
+}
+
+// See MapBasedShardedImpl.h
+size_t MapBasedShardedImpl::Size() const {
+    size_t size = 0;
+    for (auto &shard : _shards) {
+        size += shard->Size();
+    }
+    return size;
+}
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::SetMaxSize(size_t max_size) {
+    for (auto &shard : _shards) {
+        shard->SetMaxSize(max_size / _shards.size());
+    }
+}
+
+// See MapBasedShardedImpl.h
+void MapBasedShardedImpl::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    stats.emplace_back("shards", std::to_string(_shards.size()));
+    stats.emplace_back("eviction_policy", _shards[0]->eviction_policy());
+
+    // Admission, promotion, memory and slab class counters are summed over the shards, the rest of shard
+    // metrics stays internal
+    std::vector<std::pair<std::string, std::string>> admission;
+    for (auto &shard : _shards) {
+        std::vector<std::pair<std::string, std::string>> shard_stats;
+        shard->Stats(shard_stats);
+        for (auto &metric : shard_stats) {
+            if (metric.first.compare(0, 9, "admission") != 0 && metric.first.compare(0, 9, "promotion") != 0 &&
+                metric.first.compare(0, 8, "slab_lru") != 0 &&
+                metric.first != "curr_items" && metric.first != "bytes" && metric.first != "limit_maxbytes" &&
+                metric.first != "index_bytes") {
+                continue;
+            }
+
+            auto it = std::find_if(admission.begin(), admission.end(),
+                                   [&metric](const std::pair<std::string, std::string> &m) {
+                                       return m.first == metric.first;
+                                   });
+            if (it == admission.end()) {
+                admission.push_back(metric);
+            } else if (metric.first != "admission" && metric.first != "promotion") {
+                it->second = std::to_string(std::stoull(it->second) + std::stoull(metric.second));
+            }
+        }
+    }
+    stats.insert(stats.end(), admission.begin(), admission.end());
+}
+
+} // namespace Backend
+} // namespace Afina
@@ -0,0 +1,129 @@
+#ifndef AFINA_STORAGE_MAP_BASED_SHARDED_IMPL_H
+#define AFINA_STORAGE_MAP_BASED_SHARDED_IMPL_H
+
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+#include "MapBasedGlobalLockImpl.h"
+#include "PeriodicTask.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Map based implementation split into independent shards
+ * Keyspace is hash-partitioned into a power of two number of shards, each shard is
+ * a separate MapBasedGlobalLockImpl instance with its own lock, LRU list and an equal
+ * slice of the total size budget. Operations on keys from different shards never
+ * contend with each other.
+ *
+ * Note that LRU order and size limit are maintained per shard, so a single item could
+ * not be bigger than max_size / n_shards
+ */
+class MapBasedShardedImpl : public Afina::Storage {
+public:
+    /**
+     * @param admission put TinyLFU filter in front of the eviction policy of each shard
+     * @param batch_promotions shards buffer hits, see MapBasedGlobalLockImpl
+     */
+    MapBasedShardedImpl(size_t max_size = 1048576, size_t n_shards = 16,
+                        EvictionPolicy::Type eviction = EvictionPolicy::Type::Lru, bool admission = false,
+                        bool batch_promotions = false);
+    ~MapBasedShardedImpl() {}
+
+    // Implements Afina::Storage interface
+    void Start() override;
+
+    // Implements Afina::Storage interface
+    void Stop() override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Put(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool PutIfAbsent(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value) override;
+
+    // Implements Afina::Storage interface
+    bool Set(const std::string &key, const std::string &value, const Metadata &meta) override;
+
+    // Implements Afina::Storage interface
+    bool Append(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    bool Prepend(const std::string &key, const std::string &data) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Increment(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    ArithmeticResult Decrement(const std::string &key, uint64_t delta, uint64_t &result) override;
+
+    // Implements Afina::Storage interface
+    CasResult CompareAndSwap(const std::string &key, const std::string &value, const Metadata &meta,
+                             uint64_t cas) override;
+
+    // Implements Afina::Storage interface
+    bool Delete(const std::string &key) override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, std::string &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value) const override;
+
+    // Implements Afina::Storage interface
+    bool Get(const std::string &key, Value &value, Metadata &meta) const override;
+
+    // Implements Afina::Storage interface
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const override;
+
+    // Implements Afina::Storage interface
+    size_t Size() const override;
+
+    // Implements Afina::Storage interface, limit is split between shards evenly
+    void SetMaxSize(size_t max_size) override;
+
+    /**
+     * Number of shards keyspace is split into
+     */
+    size_t shards() const { return _shards.size(); }
+
+    /**
+     * Reclaim all entries expired by the given time in all shards. Storage calls it once a
+     * second in background between Start and Stop
+     */
+    void Expire(time_t now);
+
+    /**
+     * Rebalances memory of all shards, see MapBasedGlobalLockImpl::Rebalance. Storage calls it once a
+     * second in background between Start and Stop
+     */
+    void Rebalance(time_t now);
+
+private:
+    MapBasedGlobalLockImpl &Shard(const std::string &key) const;
+
+    // Number of hash bits used to select shard
+    unsigned _shard_bits;
+
+    std::vector<std::unique_ptr<MapBasedGlobalLockImpl>> _shards;
+
+    // Single background task expires entries and rebalances memory in all shards one after another
+    PeriodicTask _expirer;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MAP_BASED_SHARDED_IMPL_H
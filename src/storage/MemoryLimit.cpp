@@ -0,0 +1,72 @@
+#include "MemoryLimit.h"
+
+#include <algorithm>
+#include <cstdio>
+
+#include <unistd.h>
+
+#include <afina/allocator/Slab.h>
+#include <afina/allocator/StlAllocator.h>
+
+#if defined(__GLIBC__)
+#include <malloc.h>
+#endif
+
+namespace Afina {
+namespace Backend {
+
+constexpr size_t MemoryLimit::MIN_SHARE;
+
+MemoryLimit::MemoryLimit(Storage &storage, size_t limit) : _storage(storage), _limit(limit), _max_size(limit) {}
+
+// See MemoryLimit.h
+size_t MemoryLimit::Resident() {
+    FILE *statm = std::fopen("/proc/self/statm", "r");
+    if (statm == nullptr) {
+        return 0;
+    }
+
+    // Sizes are in pages: total program size goes first, resident set is the second one
+    unsigned long size = 0, resident = 0;
+    int read = std::fscanf(statm, "%lu %lu", &size, &resident);
+    std::fclose(statm);
+    if (read != 2) {
+        return 0;
+    }
+    return resident * sysconf(_SC_PAGESIZE);
+}
+
+// See MemoryLimit.h
+void MemoryLimit::Sample() {
+    size_t resident = Resident();
+    if (resident > _limit) {
+#if defined(__GLIBC__)
+        // Evicted items are freed into malloc free lists, which stay resident until trimmed
+        malloc_trim(0);
+        resident = Resident();
+#endif
+    }
+    Allocator::Slab *arena = Allocator::DefaultArena();
+    Sample(resident, arena != nullptr ? arena->unused() : 0);
+}
+
+// See MemoryLimit.h
+void MemoryLimit::Sample(size_t resident, size_t unused) {
+    if (resident == 0) {
+        return;
+    }
+
+    // Slack left by the evictions is refilled by the next items, counting it as overhead would shrink
+    // storage until arena is empty
+    size_t used = _storage.Size() + unused;
+    size_t overhead = resident > used ? resident - used : 0;
+    size_t target = std::max(_limit > overhead ? _limit - overhead : 0, _limit / MIN_SHARE);
+
+    // RSS reflects evictions by the next sample only, going halfway keeps limit from oscillating
+    size_t max_size = (_max_size.load(std::memory_order_relaxed) + target) / 2;
+    _max_size.store(max_size, std::memory_order_relaxed);
+    _storage.SetMaxSize(max_size);
+}
+
+} // namespace Backend
+} // namespace Afina
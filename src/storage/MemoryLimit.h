@@ -0,0 +1,72 @@
+#ifndef AFINA_STORAGE_MEMORY_LIMIT_H
+#define AFINA_STORAGE_MEMORY_LIMIT_H
+
+#include <atomic>
+#include <cstddef>
+
+#include <afina/Storage.h>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Memory limit of the whole process
+ * Storage accounts only the bytes of its items, while process also spends memory on allocator slack
+ * and fragmentation, connection buffers, thread stacks and so on. Limit samples resident set size of
+ * the process and adjusts storage size limit, so that RSS stays under the given number of bytes:
+ * everything beyond the bytes storage accounts is considered overhead, storage gets the rest. Free
+ * chunks and pages arena keeps resident are not overhead: items allocated next take them first.
+ *
+ * Owner decides how often to sample, Sample calls must be serialized
+ */
+class MemoryLimit {
+public:
+    // Storage is never squeezed below this share of the limit, even if the rest of process takes it all
+    static constexpr size_t MIN_SHARE = 16;
+
+    /**
+     * @param storage to adjust size limit of, must outlive the object
+     * @param limit bytes process is allowed to keep resident
+     */
+    MemoryLimit(Storage &storage, size_t limit);
+
+    /**
+     * Resident set size of the process in bytes, read from /proc/self/statm. Zero if it couldn't be read
+     */
+    static size_t Resident();
+
+    /**
+     * Measures RSS and moves storage size limit towards the bytes left for items. Memory freed by the
+     * evictions is returned to the system, otherwise RSS never goes down. Bytes the process arena keeps
+     * for the next allocations are taken from Allocator::DefaultArena
+     */
+    void Sample();
+
+    /**
+     * Same as above, but with RSS measured by the caller
+     *
+     * @param resident resident set size of the process in bytes
+     * @param unused resident bytes allocator keeps free, they are not counted as overhead
+     */
+    void Sample(size_t resident, size_t unused = 0);
+
+    /**
+     * Bytes process is allowed to keep resident
+     */
+    size_t limit() const { return _limit; }
+
+    /**
+     * Storage size limit set by the last sample
+     */
+    size_t max_size() const { return _max_size.load(std::memory_order_relaxed); }
+
+private:
+    Storage &_storage;
+    size_t _limit;
+    std::atomic<size_t> _max_size;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_MEMORY_LIMIT_H
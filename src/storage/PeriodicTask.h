@@ -0,0 +1,83 @@
+#ifndef AFINA_STORAGE_PERIODIC_TASK_H
+#define AFINA_STORAGE_PERIODIC_TASK_H
+
+#include <chrono>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <thread>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Background maintenance task
+ * Runs given function in a separate thread once per period, between Start and Stop calls
+ */
+class PeriodicTask {
+public:
+    PeriodicTask(std::function<void()> task, std::chrono::milliseconds period)
+        : _task(task), _period(period), _running(false) {}
+
+    // Owner must make sure task stops before anything it touches gets destroyed
+    ~PeriodicTask() { Stop(); }
+
+    PeriodicTask(const PeriodicTask &) = delete;
+    PeriodicTask &operator=(const PeriodicTask &) = delete;
+
+    /**
+     * Launch background thread, noop if it is running already
+     */
+    void Start() {
+        std::lock_guard<std::mutex> lock(_mutex);
+        if (_running) {
+            return;
+        }
+
+        _running = true;
+        _thread = std::thread(&PeriodicTask::Run, this);
+    }
+
+    /**
+     * Signal background thread to stop and wait until it does
+     */
+    void Stop() {
+        {
+            std::lock_guard<std::mutex> lock(_mutex);
+            if (!_running) {
+                return;
+            }
+            _running = false;
+        }
+
+        _stop.notify_all();
+        _thread.join();
+    }
+
+private:
+    void Run() {
+        std::unique_lock<std::mutex> lock(_mutex);
+        while (_running) {
+            if (_stop.wait_for(lock, _period, [this]() { return !_running; })) {
+                break;
+            }
+
+            lock.unlock();
+            _task();
+            lock.lock();
+        }
+    }
+
+    std::function<void()> _task;
+    const std::chrono::milliseconds _period;
+
+    std::mutex _mutex;
+    std::condition_variable _stop;
+    bool _running;
+    std::thread _thread;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_PERIODIC_TASK_H
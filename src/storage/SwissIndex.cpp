@@ -0,0 +1,84 @@
+#include "SwissIndex.h"
+
+#include <cstring>
+
+namespace Afina {
+namespace Backend {
+
+constexpr size_t SwissIndex::ENTRY_OVERHEAD;
+constexpr size_t SwissIndex::GROUP_SIZE;
+constexpr int8_t SwissIndex::EMPTY;
+constexpr int8_t SwissIndex::DELETED;
+
+SwissIndex::SwissIndex() : _group_mask(0), _size(0), _growth_left(0) { Rehash(1); }
+
+SwissIndex::~SwissIndex() {}
+
+// See SwissIndex.h
+SwissIndex::Slot *SwissIndex::Insert(LinkedList::Entry *e) {
+    uint64_t hash = e->key_hash();
+    size_t capacity = (_group_mask + 1) * GROUP_SIZE;
+    if (_growth_left == 0) {
+        // Tombstones alone could exhaust the table, then it is enough to rebuild it in place
+        Rehash((_size + 1) * 16 > capacity * 7 ? (_group_mask + 1) * 2 : _group_mask + 1);
+    }
+
+    Slot *slot = Place(e, hash);
+    _size++;
+    return slot;
+}
+
+// See SwissIndex.h
+void SwissIndex::Erase(Slot *slot) {
+    size_t i = slot - _slots.data();
+    const int8_t *group = _ctrl.data() + (i / GROUP_SIZE) * GROUP_SIZE;
+
+    // Lookups never go past the group with empty slot, so there is no probe chain to keep
+    if (MatchEmpty(group) != 0) {
+        _ctrl[i] = EMPTY;
+        _growth_left++;
+    } else {
+        _ctrl[i] = DELETED;
+    }
+    _size--;
+}
+
+SwissIndex::Slot *SwissIndex::Place(LinkedList::Entry *e, uint64_t hash) {
+    size_t group = (hash >> 7) & _group_mask;
+    for (size_t step = 1;; step++) {
+        const int8_t *ctrl = _ctrl.data() + group * GROUP_SIZE;
+        uint32_t free = MatchFree(ctrl);
+        if (free != 0) {
+            size_t i = group * GROUP_SIZE + __builtin_ctz(free);
+            _growth_left -= _ctrl[i] == EMPTY;
+            _ctrl[i] = hash & 0x7F;
+            _slots[i] = e;
+            return &_slots[i];
+        }
+        group = (group + step) & _group_mask;
+    }
+}
+
+void SwissIndex::Rehash(size_t groups) {
+    size_t old_capacity = _ctrl.size();
+    std::vector<int8_t, LinkedList::StlAllocator<int8_t>> old_ctrl;
+    std::vector<Slot, LinkedList::StlAllocator<Slot>> old_slots;
+    old_ctrl.swap(_ctrl);
+    old_slots.swap(_slots);
+
+    size_t capacity = groups * GROUP_SIZE;
+    _group_mask = groups - 1;
+    _ctrl.assign(capacity, EMPTY);
+    _slots.resize(capacity);
+    // Entries placed back take their slots out of it
+    _growth_left = capacity * 7 / 8;
+
+    for (size_t i = 0; i < old_capacity; i++) {
+        if (old_ctrl[i] >= 0) {
+            Place(old_slots[i], old_slots[i]->key_hash());
+        }
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
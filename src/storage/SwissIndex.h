@@ -0,0 +1,156 @@
+#ifndef AFINA_STORAGE_SWISS_INDEX_H
+#define AFINA_STORAGE_SWISS_INDEX_H
+
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+#include "KeyHash.h"
+#include "LinkedList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Open addressing index of storage entries
+ * Swiss table layout: slots are split into groups of 16, every slot has a control byte telling
+ * whether it is empty, deleted or full, and for the full one keeping 7 bits of the key hash. Lookup
+ * compares control bytes of the whole group with the fingerprint at once, so key is compared only
+ * for the entries whose fingerprint matches, which is one in 128 for the wrong ones. Control bytes of
+ * a group share a cache line, slot itself is just the entry pointer, so successful lookup costs
+ * control bytes, the slot and the entry with its key.
+ *
+ * Groups are probed quadratically, lookup stops at the group having an empty slot. Erased slot
+ * becomes empty if its group has empty slots already, otherwise it is marked deleted to keep probe
+ * chains going through the group. Table grows once 7/8 of slots are used.
+ *
+ * Entry is found by its own key, so index doesn't own or copy anything. Modifications must be
+ * serialized by the caller
+ */
+class SwissIndex {
+public:
+    // Slot holding the entry, stays valid until the next insertion
+    using Slot = LinkedList::Entry *;
+
+    // Table bytes each entry is charged for: its slot with the control byte plus share of the free
+    // ones. Load goes from 7/16 right after growth up to 7/8, entry is charged at 21/32 in between
+    static constexpr size_t ENTRY_OVERHEAD = (sizeof(Slot) + 1) * 32 / 21;
+
+    SwissIndex();
+    ~SwissIndex();
+
+    SwissIndex(const SwissIndex &) = delete;
+    SwissIndex &operator=(const SwissIndex &) = delete;
+
+    /**
+     * Slot of the entry with the given key, nullptr if there is none
+     */
+    Slot *Find(const std::string &key) const {
+        return Probe(KeyHash(key), [&key](const LinkedList::Entry *e) { return e->has_key(key); });
+    }
+
+    /**
+     * Slot holding this very entry, nullptr if it isn't in the index
+     */
+    Slot *Find(const LinkedList::Entry *entry) const {
+        return Probe(entry->key_hash(), [entry](const LinkedList::Entry *e) { return e == entry; });
+    }
+
+    /**
+     * Adds entry, its key must not be in the index yet. Invalidates slots returned before
+     */
+    Slot *Insert(LinkedList::Entry *e);
+
+    /**
+     * Removes entry from the slot
+     */
+    void Erase(Slot *slot);
+
+    size_t size() const { return _size; }
+    bool empty() const { return _size == 0; }
+
+    /**
+     * Bytes taken by the table: slots and control bytes
+     */
+    size_t memory() const { return (_group_mask + 1) * GROUP_SIZE * (sizeof(Slot) + 1); }
+
+private:
+    static constexpr size_t GROUP_SIZE = 16;
+
+    // Control bytes of not full slots have the high bit set
+    static constexpr int8_t EMPTY = -128;
+    static constexpr int8_t DELETED = -2;
+
+    // Bit mask of the group slots having the given control byte
+    static uint32_t Match(const int8_t *ctrl, int8_t value) {
+#if defined(__SSE2__)
+        __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+        return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8(value)));
+#else
+        uint32_t result = 0;
+        for (size_t i = 0; i < GROUP_SIZE; i++) {
+            result |= uint32_t(ctrl[i] == value) << i;
+        }
+        return result;
+#endif
+    }
+
+    static uint32_t MatchEmpty(const int8_t *ctrl) { return Match(ctrl, EMPTY); }
+
+    // Bit mask of the group slots that are empty or deleted
+    static uint32_t MatchFree(const int8_t *ctrl) {
+#if defined(__SSE2__)
+        return _mm_movemask_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl)));
+#else
+        uint32_t result = 0;
+        for (size_t i = 0; i < GROUP_SIZE; i++) {
+            result |= uint32_t(ctrl[i] < 0) << i;
+        }
+        return result;
+#endif
+    }
+
+    // Goes over the slots with matching fingerprint until predicate accepts one
+    template <typename P> Slot *Probe(uint64_t hash, P &&predicate) const {
+        int8_t fingerprint = hash & 0x7F;
+        size_t group = (hash >> 7) & _group_mask;
+        for (size_t step = 1;; step++) {
+            const int8_t *ctrl = _ctrl.data() + group * GROUP_SIZE;
+            for (uint32_t match = Match(ctrl, fingerprint); match != 0; match &= match - 1) {
+                size_t i = group * GROUP_SIZE + __builtin_ctz(match);
+                if (predicate(_slots[i])) {
+                    return &_slots[i];
+                }
+            }
+            if (MatchEmpty(ctrl) != 0) {
+                return nullptr;
+            }
+            group = (group + step) & _group_mask;
+        }
+    }
+
+    // Puts entry into the first free slot of its probe sequence
+    Slot *Place(LinkedList::Entry *e, uint64_t hash);
+    void Rehash(size_t groups);
+
+    size_t _group_mask;
+    // Tables come from the arena entries do. Lookup is const, but hands out slots caller could change
+    std::vector<int8_t, LinkedList::StlAllocator<int8_t>> _ctrl;
+    mutable std::vector<Slot, LinkedList::StlAllocator<Slot>> _slots;
+
+    size_t _size;
+
+    // Number of empty slots could be taken before table has to grow
+    size_t _growth_left;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_SWISS_INDEX_H
@@ -15,6 +15,9 @@ public:
         set(initial);
     }
 
+    // Once key is deleted destructor won't be called for the threads still holding value
+    ~ThreadLocal() { pthread_key_delete(_th_key); }
+
     inline T *get() {
         T *val = static_cast<T*>(pthread_getspecific(_th_key));
         return val;
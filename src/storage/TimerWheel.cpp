@@ -0,0 +1,121 @@
+#include "TimerWheel.h"
+
+namespace Afina {
+namespace Backend {
+
+constexpr unsigned TimerWheel::LEVEL_BITS;
+constexpr unsigned TimerWheel::SLOTS;
+constexpr unsigned TimerWheel::LEVELS;
+
+TimerWheel::TimerWheel(time_t now) : _next(now), _size(0) {
+    for (unsigned level = 0; level < LEVELS; level++) {
+        for (unsigned slot = 0; slot < SLOTS; slot++) {
+            _slots[level][slot] = nullptr;
+        }
+    }
+}
+
+// See TimerWheel.h
+void TimerWheel::Schedule(LinkedList::Entry *e) {
+    Remove(e);
+    if (e->meta.expire == 0) {
+        return;
+    }
+
+    Link(e);
+    _size++;
+}
+
+// See TimerWheel.h
+void TimerWheel::Remove(LinkedList::Entry *e) {
+    if (e->timer_pprev == nullptr) {
+        return;
+    }
+
+    *e->timer_pprev = e->timer_next;
+    if (e->timer_next != nullptr) {
+        e->timer_next->timer_pprev = e->timer_pprev;
+    }
+    e->timer_next = nullptr;
+    e->timer_pprev = nullptr;
+    _size--;
+}
+
+// See TimerWheel.h
+bool TimerWheel::Advance(time_t now, const std::function<void(LinkedList::Entry *)> &expired, size_t max_ticks) {
+    for (size_t ticks = 0; _next <= now; ticks++) {
+        if (_size == 0) {
+            // Nothing to expire, empty wheel could jump straight to the given time
+            _next = now + 1;
+            break;
+        }
+
+        if ((max_ticks != 0) && (ticks == max_ticks)) {
+            return false;
+        }
+
+        // Whenever lower level makes full turn, next slot of the upper level gets redistributed
+        // over the lower levels. Upper levels go first as they could fill slots being cascaded
+        unsigned top = 0;
+        while ((top < LEVELS - 1) && ((_next & ((time_t(1) << (LEVEL_BITS * (top + 1))) - 1)) == 0)) {
+            top++;
+        }
+        for (unsigned level = top; level > 0; level--) {
+            Cascade(level);
+        }
+
+        LinkedList::Entry *&head = _slots[0][_next & (SLOTS - 1)];
+        while (head != nullptr) {
+            LinkedList::Entry *e = head;
+            Remove(e);
+            expired(e);
+        }
+
+        _next++;
+    }
+    return true;
+}
+
+void TimerWheel::Link(LinkedList::Entry *e) {
+    // Entries that are already expired fire on the next tick
+    time_t expire = time_t(e->meta.expire) > _next ? time_t(e->meta.expire) : _next;
+    time_t delta = expire - _next;
+
+    // Too far in the future, park it in the furthest slot of the top level. It will be put
+    // back on the wheel once that slot gets cascaded
+    time_t max_delta = time_t(1) << (LEVEL_BITS * LEVELS);
+    if (delta >= max_delta) {
+        expire = _next + max_delta - 1;
+        delta = max_delta - 1;
+    }
+
+    unsigned level = 0;
+    while ((level < LEVELS - 1) && (delta >= (time_t(1) << (LEVEL_BITS * (level + 1))))) {
+        level++;
+    }
+
+    LinkedList::Entry *&head = _slots[level][(expire >> (LEVEL_BITS * level)) & (SLOTS - 1)];
+    e->timer_next = head;
+    e->timer_pprev = &head;
+    if (head != nullptr) {
+        head->timer_pprev = &e->timer_next;
+    }
+    head = e;
+}
+
+void TimerWheel::Cascade(unsigned level) {
+    LinkedList::Entry *&slot = _slots[level][(_next >> (LEVEL_BITS * level)) & (SLOTS - 1)];
+    LinkedList::Entry *head = slot;
+    slot = nullptr;
+
+    while (head != nullptr) {
+        LinkedList::Entry *e = head;
+        head = e->timer_next;
+        e->timer_next = nullptr;
+        e->timer_pprev = nullptr;
+        Link(e);
+    }
+}
+
+} // namespace Backend
+} // namespace Afina
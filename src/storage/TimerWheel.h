@@ -0,0 +1,78 @@
+#ifndef AFINA_STORAGE_TIMER_WHEEL_H
+#define AFINA_STORAGE_TIMER_WHEEL_H
+
+#include <cstddef>
+#include <ctime>
+#include <functional>
+
+#include "LinkedList.h"
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Hierarchical timer wheel
+ * Keeps entries ordered by expiration time with one second resolution. There are LEVELS wheels
+ * of SLOTS slots each, slot of the level L covers SLOTS^L seconds. Entry is put on the lowest
+ * level which range covers its expiration time and moves down on the wheel as the time goes by,
+ * so that both scheduling and expiration are O(1) per entry and no scan over the whole storage
+ * is ever needed.
+ *
+ * Entries are linked into the wheel slots intrusively, wheel doesn't own them. Storage must
+ * remove entry from the wheel before delete it
+ */
+class TimerWheel {
+public:
+    static constexpr unsigned LEVEL_BITS = 6;
+    static constexpr unsigned SLOTS = 1 << LEVEL_BITS;
+    static constexpr unsigned LEVELS = 4;
+
+    explicit TimerWheel(time_t now);
+    ~TimerWheel() {}
+
+    TimerWheel(const TimerWheel &) = delete;
+    TimerWheel &operator=(const TimerWheel &) = delete;
+
+    /**
+     * Put entry on the wheel according to its expiration time, or take it off if entry never
+     * expires. Could be called again once expiration time changed
+     */
+    void Schedule(LinkedList::Entry *e);
+
+    /**
+     * Take entry off the wheel, noop if entry isn't scheduled
+     */
+    void Remove(LinkedList::Entry *e);
+
+    /**
+     * Move wheel forward up to the given time. Entries expired by that time are taken off the wheel
+     * and passed to the callback, which must remove them from storage
+     *
+     * @param now current unix time
+     * @param max_ticks maximum number of seconds to process in this call, so that caller could
+     * release its locks in between. Zero means no limit
+     * @return true if wheel has reached now
+     */
+    bool Advance(time_t now, const std::function<void(LinkedList::Entry *)> &expired, size_t max_ticks = 0);
+
+    /**
+     * Number of entries scheduled
+     */
+    size_t size() const { return _size; }
+
+private:
+    void Link(LinkedList::Entry *e);
+    void Cascade(unsigned level);
+
+    // Next second to be processed, all entries expired before it have been passed out already
+    time_t _next;
+
+    size_t _size;
+
+    LinkedList::Entry *_slots[LEVELS][SLOTS];
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TIMER_WHEEL_H
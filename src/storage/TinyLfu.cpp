@@ -0,0 +1,104 @@
+#include "TinyLfu.h"
+
+#include <algorithm>
+#include <functional>
+
+namespace Afina {
+namespace Backend {
+
+constexpr unsigned FrequencySketch::DEPTH;
+constexpr unsigned FrequencySketch::MAX_FREQUENCY;
+
+FrequencySketch::FrequencySketch(size_t width, size_t sample_size)
+    : _width_bits(4), _additions(0), _agings(0) {
+    // At least one word per row
+    while ((size_t(1) << _width_bits) < width) {
+        _width_bits++;
+    }
+
+    size_t row_width = size_t(1) << _width_bits;
+    _table.assign(DEPTH * row_width / 16, 0);
+    _sample_size = sample_size != 0 ? sample_size : 10 * row_width;
+}
+
+// See TinyLfu.h
+void FrequencySketch::Increment(uint64_t hash) {
+    size_t index[DEPTH];
+    unsigned min = MAX_FREQUENCY;
+    for (unsigned row = 0; row < DEPTH; row++) {
+        index[row] = Index(hash, row);
+        min = std::min(min, Counter(index[row]));
+    }
+
+    if (min == MAX_FREQUENCY) {
+        return;
+    }
+
+    for (unsigned row = 0; row < DEPTH; row++) {
+        if (Counter(index[row]) == min) {
+            _table[index[row] / 16] += uint64_t(1) << ((index[row] % 16) * 4);
+        }
+    }
+
+    if (++_additions >= _sample_size) {
+        Age();
+    }
+}
+
+// See TinyLfu.h
+unsigned FrequencySketch::Frequency(uint64_t hash) const {
+    unsigned min = MAX_FREQUENCY;
+    for (unsigned row = 0; row < DEPTH; row++) {
+        min = std::min(min, Counter(Index(hash, row)));
+    }
+    return min;
+}
+
+size_t FrequencySketch::Index(uint64_t hash, unsigned row) const {
+    // Each row uses hash remixed with its own seed, top bits are the best mixed ones
+    static const uint64_t seeds[DEPTH] = {0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL,
+                                          0xFF51AFD7ED558CCDULL};
+    uint64_t h = (hash + seeds[row]) * 0xC4CEB9FE1A85EC53ULL;
+    h ^= h >> 29;
+    h *= seeds[row] | 1;
+    return (size_t(row) << _width_bits) + (h >> (64 - _width_bits));
+}
+
+unsigned FrequencySketch::Counter(size_t index) const { return (_table[index / 16] >> ((index % 16) * 4)) & 0xF; }
+
+void FrequencySketch::Age() {
+    // Halve all the counters at once: shift whole word and drop bits moved in from the neighbours
+    for (auto &word : _table) {
+        word = (word >> 1) & 0x7777777777777777ULL;
+    }
+    _additions /= 2;
+    _agings.fetch_add(1, std::memory_order_relaxed);
+}
+
+TinyLfu::TinyLfu(size_t max_size) : _sketch(std::max(max_size / 64, size_t(1024))), _admitted(0), _rejected(0) {}
+
+// See TinyLfu.h
+void TinyLfu::Record(const std::string &key) { _sketch.Increment(std::hash<std::string>()(key)); }
+
+// See TinyLfu.h
+bool TinyLfu::Admit(const std::string &candidate, const std::string &victim) {
+    std::hash<std::string> hash;
+    if (_sketch.Frequency(hash(candidate)) > _sketch.Frequency(hash(victim))) {
+        _admitted.fetch_add(1, std::memory_order_relaxed);
+        return true;
+    }
+
+    _rejected.fetch_add(1, std::memory_order_relaxed);
+    return false;
+}
+
+// See TinyLfu.h
+void TinyLfu::Stats(std::vector<std::pair<std::string, std::string>> &stats) const {
+    stats.emplace_back("admission", "tinylfu");
+    stats.emplace_back("admission_admitted", std::to_string(_admitted.load(std::memory_order_relaxed)));
+    stats.emplace_back("admission_rejected", std::to_string(_rejected.load(std::memory_order_relaxed)));
+    stats.emplace_back("admission_agings", std::to_string(_sketch.agings()));
+}
+
+} // namespace Backend
+} // namespace Afina
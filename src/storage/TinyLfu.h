@@ -0,0 +1,107 @@
+#ifndef AFINA_STORAGE_TINY_LFU_H
+#define AFINA_STORAGE_TINY_LFU_H
+
+#include <cstddef>
+#include <atomic>
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace Afina {
+namespace Backend {
+
+/**
+ * # Count-min sketch of access frequencies
+ * Approximate number of times each key has been seen, in a fixed amount of memory. There are
+ * DEPTH rows of 4-bit counters, key maps to one counter in each row and its frequency is the
+ * minimum of them. Only the smallest counters get incremented (conservative update), which
+ * keeps overestimation low.
+ *
+ * Once number of increments reaches sample size all counters are halved, so the sketch follows
+ * the recent popularity instead of the whole history
+ */
+class FrequencySketch {
+public:
+    static constexpr unsigned DEPTH = 4;
+    static constexpr unsigned MAX_FREQUENCY = 15;
+
+    /**
+     * @param width number of counters in each row, rounded up to the power of two
+     * @param sample_size number of increments between agings, 10 * width if zero
+     */
+    explicit FrequencySketch(size_t width, size_t sample_size = 0);
+
+    /**
+     * Record one more access to the key with the given hash
+     */
+    void Increment(uint64_t hash);
+
+    /**
+     * Estimated number of accesses to the key with the given hash, at most MAX_FREQUENCY
+     */
+    unsigned Frequency(uint64_t hash) const;
+
+    /**
+     * Number of times counters have been halved
+     */
+    size_t agings() const { return _agings.load(std::memory_order_relaxed); }
+
+private:
+    size_t Index(uint64_t hash, unsigned row) const;
+    unsigned Counter(size_t index) const;
+    void Age();
+
+    // Log2 of the row width
+    unsigned _width_bits;
+
+    // 16 counters per word, rows go one after another
+    std::vector<uint64_t> _table;
+
+    size_t _sample_size;
+    size_t _additions;
+
+    // Metrics could be read concurrently with the sketch updates
+    std::atomic<size_t> _agings;
+};
+
+/**
+ * # TinyLFU admission filter
+ * Once storage is full every new key would evict some existing one. Filter lets the newcomer in
+ * only if it has been accessed more often recently than the entry it is going to replace, so
+ * that a flood of keys that are used once can't wash out the popular ones
+ */
+class TinyLfu {
+public:
+    /**
+     * @param max_size storage size limit, sketch is sized for the number of entries it could hold
+     */
+    explicit TinyLfu(size_t max_size);
+
+    /**
+     * Record access to the key, both hits and misses count
+     */
+    void Record(const std::string &key);
+
+    /**
+     * Whether new key should be stored at the cost of the victim eviction
+     */
+    bool Admit(const std::string &candidate, const std::string &victim);
+
+    /**
+     * Admission metrics, see Afina::Storage::Stats. Unlike the rest of the methods could be called
+     * concurrently with the others
+     */
+    void Stats(std::vector<std::pair<std::string, std::string>> &stats) const;
+
+private:
+    FrequencySketch _sketch;
+
+    std::atomic<size_t> _admitted;
+    std::atomic<size_t> _rejected;
+};
+
+} // namespace Backend
+} // namespace Afina
+
+#endif // AFINA_STORAGE_TINY_LFU_H
@@ -0,0 +1,171 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <vector>
+
+#include <afina/allocator/Error.h>
+#include <afina/allocator/Pointer.h>
+#include <afina/allocator/Simple.h>
+
+using namespace Afina::Allocator;
+
+/**
+ * Benchmarks are not a part of regular test run, parameters could be tuned
+ * using environment:
+ * - AFINA_BENCH_ARENA: arena size in bytes, 67108864 by default
+ * - AFINA_BENCH_OPS: number of operations to perform, 2000000 by default
+ * - AFINA_BENCH_FILL: percent of the arena workload keeps allocated, 90 by default
+ * - AFINA_BENCH_MAX_BLOCK: largest block size, sizes are spread log-uniformly starting
+ *   from 16 bytes, 4096 by default
+ */
+static size_t env_size(const char *name, size_t def) {
+    const char *value = std::getenv(name);
+    return value != nullptr ? std::stoul(value) : def;
+}
+
+namespace {
+
+// Random alloc/free/realloc sequence, the same for every run
+class Workload {
+public:
+    Workload(size_t max_block) : _x(0x2545F4914F6CDD1DULL), _log_max(std::log(double(max_block) / 16)) {}
+
+    uint64_t Next() {
+        // xorshift64
+        _x ^= _x << 13;
+        _x ^= _x >> 7;
+        _x ^= _x << 17;
+        return _x;
+    }
+
+    size_t Size() { return size_t(16 * std::exp(_log_max * double(Next() % 10000) / 10000)); }
+
+private:
+    uint64_t _x;
+    double _log_max;
+};
+
+struct Result {
+    double mops;
+    size_t failed;
+    size_t defrags;
+    double defrag_ms;
+    double fragmentation;
+    double max_fragmentation;
+};
+
+/**
+ * Keeps the arena filled up to the given share by random sized blocks, freeing random ones to
+ * make room. Every tenth operation reallocates a random block. With defrag failed allocation is
+ * retried once after defragmentation. Allocation that failed anyway is counted and a random block
+ * is freed instead. Fragmentation is the share of free space that single allocation can't take:
+ * 1 - largest free block / all free space
+ */
+Result run(size_t arena_size, size_t n_ops, size_t fill, size_t max_block, bool defrag) {
+    std::unique_ptr<char[]> arena(new char[arena_size]);
+    Simple a(arena.get(), arena_size);
+    Workload w(max_block);
+
+    struct Live {
+        Pointer p;
+        size_t size;
+    };
+    std::vector<Live> live;
+    size_t live_bytes = 0;
+    size_t target = arena_size / 100 * fill;
+
+    Result result = {};
+    double fragmentation = 0;
+    size_t samples = 0;
+    std::chrono::duration<double> in_defrag(0);
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_ops; i++) {
+        if (i % 10 == 9 && !live.empty()) {
+            Live &l = live[w.Next() % live.size()];
+            size_t size = w.Size();
+            try {
+                a.realloc(l.p, size);
+                live_bytes = live_bytes - l.size + size;
+                l.size = size;
+            } catch (AllocError &) {
+                result.failed++;
+            }
+        } else if (live_bytes < target || live.empty()) {
+            size_t size = w.Size();
+            for (int attempt = 0; attempt < 2; attempt++) {
+                try {
+                    live.push_back(Live{a.alloc(size), size});
+                    std::memset(live.back().p.get(), 0, std::min<size_t>(size, 64));
+                    live_bytes += size;
+                    break;
+                } catch (AllocError &) {
+                    // Defragmentation is worth it only if noticeable share of the arena is free and most
+                    // of it is scattered, otherwise nearly full arena would be compacted on every allocation
+                    if (attempt == 1 || !defrag || a.available() < arena_size / 32 ||
+                        a.largest_free() * 2 > a.available()) {
+                        // Cache would evict something to make room, so does the workload
+                        result.failed++;
+                        size_t j = w.Next() % live.size();
+                        a.free(live[j].p);
+                        live_bytes -= live[j].size;
+                        live[j] = live.back();
+                        live.pop_back();
+                        break;
+                    }
+                    auto defrag_start = std::chrono::steady_clock::now();
+                    a.defrag();
+                    in_defrag += std::chrono::steady_clock::now() - defrag_start;
+                    result.defrags++;
+                }
+            }
+        } else {
+            size_t j = w.Next() % live.size();
+            a.free(live[j].p);
+            live_bytes -= live[j].size;
+            live[j] = live.back();
+            live.pop_back();
+        }
+
+        if (i % 1000 == 0 && a.available() > 0) {
+            double sample = 1 - double(a.largest_free()) / a.available();
+            fragmentation += sample;
+            result.max_fragmentation = std::max(result.max_fragmentation, sample);
+            samples++;
+        }
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    result.mops = n_ops / elapsed / 1e6;
+    result.fragmentation = samples > 0 ? fragmentation / samples : 0;
+    result.defrag_ms = result.defrags > 0 ? in_defrag.count() * 1000 / result.defrags : 0;
+    for (Live &l : live) {
+        a.free(l.p);
+    }
+    return result;
+}
+
+} // namespace
+
+TEST(SimpleBenchmark, Fragmentation) {
+    size_t arena_size = env_size("AFINA_BENCH_ARENA", 64 << 20);
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 2000000);
+    size_t fill = env_size("AFINA_BENCH_FILL", 90);
+    size_t max_block = env_size("AFINA_BENCH_MAX_BLOCK", 4096);
+
+    std::cout << std::setw(12) << "mode" << std::setw(12) << "Mops/sec" << std::setw(12) << "failed"
+              << std::setw(12) << "defrags" << std::setw(14) << "ms/defrag" << std::setw(12) << "frag %"
+              << std::setw(12) << "max frag %" << std::endl;
+    for (bool defrag : {false, true}) {
+        Result r = run(arena_size, n_ops, fill, max_block, defrag);
+        std::cout << std::setw(12) << (defrag ? "defrag" : "no_defrag") << std::setw(12) << std::fixed
+                  << std::setprecision(2) << r.mops << std::setw(12) << r.failed << std::setw(12) << r.defrags
+                  << std::setw(14) << r.defrag_ms << std::setw(12) << r.fragmentation * 100 << std::setw(12)
+                  << r.max_fragmentation * 100 << std::endl;
+    }
+}
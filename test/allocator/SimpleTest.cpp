@@ -1,4 +1,5 @@
 #include "gtest/gtest.h"
+#include <cstring>
 #include <iostream>
 #include <set>
 #include <vector>
@@ -322,3 +323,109 @@ TEST(SimpleTest, ReallocGrow) {
     a.free(p);
     a.free(p2);
 }
+
+TEST(SimpleTest, FreeCoalesce) {
+    Simple a(buf, sizeof(buf));
+
+    vector<Pointer> ptrs;
+    int size = 135;
+
+    ASSERT_TRUE(fillUp(a, size, ptrs));
+
+    // Neighbours are merged whichever order they are freed in
+    a.free(ptrs[11]);
+    a.free(ptrs[13]);
+    a.free(ptrs[12]);
+
+    Pointer p = a.alloc(size * 3);
+    writeTo(p, size * 3);
+    EXPECT_TRUE(isDataOk(p, size * 3));
+    a.free(p);
+}
+
+TEST(SimpleTest, InvalidFree) {
+    Simple a(buf, sizeof(buf));
+
+    Pointer p = a.alloc(100);
+    Pointer copy = p;
+    a.free(p);
+    EXPECT_EQ(p.get(), nullptr);
+
+    try {
+        a.free(copy);
+        EXPECT_TRUE(false);
+    } catch (AllocError &e) {
+        EXPECT_EQ(e.getType(), AllocErrorType::InvalidFree);
+    }
+}
+
+TEST(SimpleTest, RandomWorkload) {
+    Simple a(buf, sizeof(buf));
+
+    // Each block is filled with its own byte, so moved or overwritten data is noticed
+    struct Live {
+        Pointer p;
+        size_t size;
+        char fill;
+    };
+    vector<Live> live;
+    auto check = [&live]() {
+        for (Live &l : live) {
+            char *v = reinterpret_cast<char *>(l.p.get());
+            ASSERT_TRUE(isValidMemory(l.p, l.size));
+            for (size_t i = 0; i < l.size; i++) {
+                ASSERT_EQ(l.fill, v[i]);
+            }
+        }
+    };
+
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    auto next = [&x]() {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        return x;
+    };
+
+    for (int i = 0; i < 20000; i++) {
+        size_t op = next() % 10;
+        if (op < 5 || live.empty()) {
+            size_t size = 1 + next() % 1000;
+            try {
+                Pointer p = a.alloc(size);
+                char fill = char(i);
+                memset(p.get(), fill, size);
+                live.push_back(Live{p, size, fill});
+            } catch (AllocError &) {
+                a.defrag();
+            }
+        } else if (op < 8) {
+            size_t j = next() % live.size();
+            a.free(live[j].p);
+            live[j] = live.back();
+            live.pop_back();
+        } else {
+            Live &l = live[next() % live.size()];
+            size_t size = 1 + next() % 2000;
+            try {
+                a.realloc(l.p, size);
+                if (size > l.size) {
+                    memset(reinterpret_cast<char *>(l.p.get()) + l.size, l.fill, size - l.size);
+                }
+                l.size = size;
+            } catch (AllocError &) {
+            }
+        }
+
+        if (i % 1000 == 0) {
+            check();
+        }
+    }
+    check();
+
+    for (Live &l : live) {
+        a.free(l.p);
+    }
+    EXPECT_EQ(0, a.used());
+    EXPECT_EQ(a.available(), a.largest_free());
+}
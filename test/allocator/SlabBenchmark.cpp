@@ -0,0 +1,189 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <afina/allocator/Slab.h>
+
+using namespace Afina::Allocator;
+
+/**
+ * Benchmarks are not a part of regular test run, parameters could be tuned
+ * using environment:
+ * - AFINA_BENCH_THREADS: comma separated list of producer/consumer pairs count, "1,2,4" by default
+ * - AFINA_BENCH_OPS: number of chunks each producer allocates, 2000000 by default
+ * - AFINA_BENCH_MAX_BLOCK: largest chunk size, sizes are spread uniformly starting from 16 bytes,
+ *   512 by default
+ */
+static std::vector<size_t> env_list(const char *name, const char *def) {
+    const char *value = std::getenv(name);
+    std::stringstream ss(value != nullptr ? value : def);
+
+    std::vector<size_t> result;
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        result.push_back(std::stoul(item));
+    }
+    return result;
+}
+
+static size_t env_size(const char *name, size_t def) {
+    const char *value = std::getenv(name);
+    return value != nullptr ? std::stoul(value) : def;
+}
+
+namespace {
+
+struct Backend {
+    const char *name;
+    std::function<void *(size_t)> alloc;
+    std::function<void(void *)> free;
+
+    // Memory taken from the system, empty if unknown
+    std::function<size_t()> mapped;
+};
+
+// Single producer single consumer ring of chunks
+class Ring {
+public:
+    Ring() : _head(0), _tail(0) {}
+
+    bool Push(void *p) {
+        size_t tail = _tail.load(std::memory_order_relaxed);
+        if (tail - _head.load(std::memory_order_acquire) == SIZE) {
+            return false;
+        }
+        _items[tail % SIZE] = p;
+        _tail.store(tail + 1, std::memory_order_release);
+        return true;
+    }
+
+    bool Pop(void *&p) {
+        size_t head = _head.load(std::memory_order_relaxed);
+        if (head == _tail.load(std::memory_order_acquire)) {
+            return false;
+        }
+        p = _items[head % SIZE];
+        _head.store(head + 1, std::memory_order_release);
+        return true;
+    }
+
+private:
+    static constexpr size_t SIZE = 4096;
+    void *_items[SIZE];
+
+    // Producer and consumer indices live on their own cache lines. Padded instead of aligned: C++11 new
+    // doesn't honor alignment over alignof(max_align_t)
+    static constexpr size_t CACHE_LINE = 64;
+    char _pad0[CACHE_LINE];
+    std::atomic<size_t> _head;
+    char _pad1[CACHE_LINE - sizeof(std::atomic<size_t>)];
+    std::atomic<size_t> _tail;
+    char _pad2[CACHE_LINE - sizeof(std::atomic<size_t>)];
+};
+
+/**
+ * Each producer allocates chunks and passes them to its consumer, consumer touches and frees them, so every
+ * free is done by the other thread than the allocation. Returns chunks per second over all pairs
+ */
+double run_remote(const Backend &backend, size_t n_pairs, size_t n_ops, size_t max_block) {
+    std::vector<std::unique_ptr<Ring>> rings;
+    for (size_t t = 0; t < n_pairs; t++) {
+        rings.emplace_back(new Ring());
+    }
+
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+    for (size_t t = 0; t < n_pairs; t++) {
+        Ring &ring = *rings[t];
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x2545F4914F6CDD1DULL * (t + 1);
+            ready++;
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+
+            for (size_t i = 0; i < n_ops; i++) {
+                // xorshift64
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+
+                size_t size = 16 + x % (max_block - 15);
+                char *p = static_cast<char *>(backend.alloc(size));
+                p[0] = char(size);
+                while (!ring.Push(p)) {
+                    std::this_thread::yield();
+                }
+            }
+            while (!ring.Push(nullptr)) {
+                std::this_thread::yield();
+            }
+        });
+
+        threads.emplace_back([&]() {
+            ready++;
+            for (;;) {
+                void *p;
+                if (!ring.Pop(p)) {
+                    std::this_thread::yield();
+                    continue;
+                }
+                // Producer pushes nullptr after all the chunks
+                if (p == nullptr) {
+                    break;
+                }
+                static_cast<char *>(p)[1] = 0;
+                backend.free(p);
+            }
+        });
+    }
+
+    while (ready.load() != 2 * n_pairs) {
+        std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto &t : threads) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return n_pairs * n_ops / elapsed;
+}
+
+} // namespace
+
+TEST(SlabBenchmark, ProducerConsumer) {
+    std::vector<size_t> pairs = env_list("AFINA_BENCH_THREADS", "1,2,4");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 2000000);
+    size_t max_block = env_size("AFINA_BENCH_MAX_BLOCK", 512);
+
+    Slab slab;
+    std::vector<Backend> backends = {
+        {"slab", [&slab](size_t size) { return slab.alloc(size); }, [&slab](void *p) { slab.free(p); },
+         [&slab]() { return slab.mapped(); }},
+        {"malloc", [](size_t size) { return std::malloc(size); }, [](void *p) { std::free(p); }, nullptr},
+    };
+
+    std::cout << std::setw(12) << "backend" << std::setw(12) << "pairs" << std::setw(12) << "Mops/sec"
+              << std::setw(14) << "mapped MB" << std::endl;
+    for (const Backend &backend : backends) {
+        for (size_t n : pairs) {
+            double ops = run_remote(backend, n, n_ops, max_block);
+            std::cout << std::setw(12) << backend.name << std::setw(12) << n << std::setw(12) << std::fixed
+                      << std::setprecision(3) << ops / 1e6 << std::setw(14)
+                      << (backend.mapped ? std::to_string(backend.mapped() >> 20) : "-") << std::endl;
+        }
+    }
+}
@@ -0,0 +1,363 @@
+#include "gtest/gtest.h"
+#include <cstdint>
+#include <cstring>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include <sys/mman.h>
+#include <unistd.h>
+
+#include <afina/allocator/Slab.h>
+
+using namespace Afina::Allocator;
+
+static size_t used_chunks(const Slab &a) {
+    size_t result = 0;
+    for (size_t cls = 0; cls < a.classes(); cls++) {
+        result += a.stats(cls).used;
+    }
+    return result;
+}
+
+static size_t class_of(const Slab &a, size_t size) {
+    size_t cls = 0;
+    while (a.stats(cls).chunk_size < size) {
+        cls++;
+    }
+    return cls;
+}
+
+TEST(SlabTest, SizeClasses) {
+    Slab a;
+    ASSERT_GT(a.classes(), 1);
+    EXPECT_EQ(Slab::MIN_CHUNK, a.stats(0).chunk_size);
+    EXPECT_EQ(Slab::MAX_CHUNK, a.stats(a.classes() - 1).chunk_size);
+
+    for (size_t cls = 1; cls < a.classes(); cls++) {
+        size_t prev = a.stats(cls - 1).chunk_size;
+        size_t size = a.stats(cls).chunk_size;
+        EXPECT_GT(size, prev);
+        EXPECT_LE(size, prev * 5 / 4 + 8);
+        EXPECT_EQ(0, size % 8);
+    }
+
+    for (size_t size = 1; size <= Slab::MAX_CHUNK; size = size * 3 / 2 + 1) {
+        EXPECT_GE(a.chunk_size(size), size);
+        EXPECT_LE(a.chunk_size(size), std::max(Slab::MIN_CHUNK, size * 5 / 4 + 8));
+    }
+}
+
+TEST(SlabTest, AllocReusesFreed) {
+    Slab a;
+    void *p = a.alloc(100);
+    ASSERT_NE(nullptr, p);
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p) % 8);
+    std::memset(p, 'x', 100);
+
+    a.free(p);
+    EXPECT_EQ(p, a.alloc(100));
+    a.free(p);
+    a.free(nullptr);
+}
+
+TEST(SlabTest, ClassStats) {
+    Slab a;
+    size_t cls = class_of(a, 200);
+    size_t chunk = a.stats(cls).chunk_size;
+    size_t per_page = (Slab::PAGE_SIZE - Slab::HEADER) / chunk;
+
+    // Two full pages and one more chunk
+    std::vector<void *> chunks;
+    for (size_t i = 0; i < 2 * per_page + 1; i++) {
+        chunks.push_back(a.alloc(200));
+        std::memset(chunks.back(), int(i), 200);
+    }
+
+    Slab::ClassStats s = a.stats(cls);
+    EXPECT_EQ(chunk, s.chunk_size);
+    EXPECT_EQ(3, s.pages);
+    EXPECT_EQ(chunks.size(), s.used);
+    EXPECT_EQ(per_page - 1, s.free);
+    EXPECT_EQ(chunks.size(), used_chunks(a));
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+
+    for (size_t i = 0; i < chunks.size(); i++) {
+        EXPECT_EQ(char(i), *static_cast<char *>(chunks[i]));
+        a.free(chunks[i]);
+    }
+
+    // Empty pages go back to the arena, but the last one
+    s = a.stats(cls);
+    EXPECT_EQ(1, s.pages);
+    EXPECT_EQ(0, s.used);
+    EXPECT_EQ(per_page, s.free);
+}
+
+TEST(SlabTest, PagesMoveBetweenClasses) {
+    Slab a;
+    size_t pages = Slab::ARENA_SIZE / Slab::PAGE_SIZE;
+
+    // Whole arena is taken by a single class and freed
+    std::vector<void *> chunks;
+    for (size_t i = 0; i < pages * 8; i++) {
+        chunks.push_back(a.alloc(Slab::MAX_CHUNK));
+    }
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+    for (void *p : chunks) {
+        a.free(p);
+    }
+
+    // Another class reuses the pages without mapping a new arena, one page is still kept by the first one
+    size_t per_page = (Slab::PAGE_SIZE - Slab::HEADER) / a.chunk_size(1000);
+    chunks.clear();
+    for (size_t i = 0; i < (pages - 1) * per_page; i++) {
+        chunks.push_back(a.alloc(1000));
+    }
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+
+    // Arena is over, the next one is mapped
+    for (size_t i = 0; i < per_page + 1; i++) {
+        chunks.push_back(a.alloc(1000));
+    }
+    EXPECT_EQ(2 * Slab::ARENA_SIZE, a.mapped());
+
+    for (void *p : chunks) {
+        a.free(p);
+    }
+    EXPECT_EQ(0, used_chunks(a));
+}
+
+TEST(SlabTest, ReleasesFreePages) {
+    Slab a;
+    size_t cls = class_of(a, Slab::MAX_CHUNK);
+    size_t per_page = (Slab::PAGE_SIZE - Slab::HEADER) / a.stats(cls).chunk_size;
+
+    std::vector<void *> chunks;
+    for (size_t i = 0; i < 4 * per_page; i++) {
+        chunks.push_back(a.alloc(Slab::MAX_CHUNK));
+        std::memset(chunks.back(), 'x', Slab::MAX_CHUNK);
+    }
+    EXPECT_EQ(0, a.released());
+    EXPECT_EQ(0, a.unused());
+
+    for (void *p : chunks) {
+        a.free(p);
+    }
+
+    // Three pages go back to the system, the one class keeps stays resident and free
+    size_t body = Slab::PAGE_SIZE - sysconf(_SC_PAGESIZE);
+    EXPECT_EQ(3 * body, a.released());
+    EXPECT_EQ(per_page * a.stats(cls).chunk_size, a.unused());
+
+    size_t resident = 0;
+    std::vector<unsigned char> pages(Slab::MAX_CHUNK / sysconf(_SC_PAGESIZE) + 1);
+    for (void *p : chunks) {
+        char *aligned = reinterpret_cast<char *>(reinterpret_cast<uintptr_t>(p) & ~(sysconf(_SC_PAGESIZE) - 1));
+        ASSERT_EQ(0, mincore(aligned, Slab::MAX_CHUNK, pages.data()));
+        for (size_t i = 0; i < Slab::MAX_CHUNK / sysconf(_SC_PAGESIZE); i++) {
+            resident += pages[i] & 1;
+        }
+    }
+    EXPECT_LT(resident * sysconf(_SC_PAGESIZE), 2 * Slab::PAGE_SIZE);
+
+    // Released pages are reused before the arena grows
+    chunks.clear();
+    for (size_t i = 0; i < 4 * per_page; i++) {
+        chunks.push_back(a.alloc(Slab::MAX_CHUNK));
+        std::memset(chunks.back(), 'y', Slab::MAX_CHUNK);
+    }
+    EXPECT_EQ(0, a.released());
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+    for (void *p : chunks) {
+        a.free(p);
+    }
+}
+
+TEST(SlabTest, Huge) {
+    Slab a;
+    size_t size = 3 * Slab::PAGE_SIZE + 5;
+    char *p = static_cast<char *>(a.alloc(size));
+    ASSERT_NE(nullptr, p);
+    p[0] = 'a';
+    p[size - 1] = 'z';
+
+    EXPECT_EQ(1, a.huge());
+    EXPECT_EQ(a.chunk_size(size), a.huge_bytes());
+    EXPECT_GE(a.chunk_size(size), size);
+    EXPECT_EQ(a.huge_bytes(), a.mapped());
+    EXPECT_EQ(0, used_chunks(a));
+
+    a.free(p);
+    EXPECT_EQ(0, a.huge());
+    EXPECT_EQ(0, a.huge_bytes());
+    EXPECT_EQ(0, a.mapped());
+}
+
+TEST(SlabTest, HugePages) {
+    Slab regular;
+    regular.free(regular.alloc(100));
+    EXPECT_EQ(0, regular.hugetlb_bytes());
+    EXPECT_EQ(0, regular.thp_bytes());
+
+    // Arena either comes from the explicit huge pages or is advised to use transparent ones, unless
+    // system has neither
+    Slab a(0, true);
+    EXPECT_TRUE(a.huge_pages());
+    char *p = static_cast<char *>(a.alloc(100));
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(p - Slab::HEADER) % Slab::HUGE_PAGE_SIZE);
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+    EXPECT_LE(a.hugetlb_bytes() + a.thp_bytes(), Slab::ARENA_SIZE);
+    std::memset(p, 'x', 100);
+
+    // Big blocks are aligned to the huge pages too
+    size_t size = 3 * Slab::HUGE_PAGE_SIZE;
+    char *q = static_cast<char *>(a.alloc(size));
+    EXPECT_EQ(0, reinterpret_cast<uintptr_t>(q - Slab::HEADER) % Slab::HUGE_PAGE_SIZE);
+    q[size - 1] = 'z';
+
+    a.free(p);
+    a.free(q);
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+}
+
+TEST(SlabTest, Multithreaded) {
+    Slab a;
+    const int n_threads = 4;
+    const int n_ops = 100000;
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&a, t]() {
+            uint64_t x = 0x2545F4914F6CDD1DULL + t;
+            std::vector<std::pair<char *, size_t>> live;
+            for (int i = 0; i < n_ops; i++) {
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+                if (live.size() < 1000 && (x % 3 != 0 || live.empty())) {
+                    size_t size = 1 + x % 2000;
+                    char *p = static_cast<char *>(a.alloc(size));
+                    std::memset(p, t, size);
+                    live.emplace_back(p, size);
+                } else {
+                    size_t j = x % live.size();
+                    char *p = live[j].first;
+                    ASSERT_EQ(char(t), p[0]);
+                    ASSERT_EQ(char(t), p[live[j].second - 1]);
+                    a.free(p);
+                    live[j] = live.back();
+                    live.pop_back();
+                }
+            }
+            for (auto &l : live) {
+                a.free(l.first);
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    EXPECT_EQ(0, used_chunks(a));
+}
+
+TEST(SlabTest, RemoteFree) {
+    Slab a;
+    std::vector<void *> chunks;
+    for (int i = 0; i < 100; i++) {
+        chunks.push_back(a.alloc(64));
+    }
+
+    // Chunks freed by another thread go back to this one
+    std::thread([&a, &chunks]() {
+        for (void *p : chunks) {
+            a.free(p);
+        }
+    }).join();
+    EXPECT_EQ(100, used_chunks(a));
+
+    // Owner collects them once its page is over
+    size_t per_page = (Slab::PAGE_SIZE - Slab::HEADER) / a.chunk_size(64);
+    std::vector<void *> more;
+    for (size_t i = 0; i < per_page - 100; i++) {
+        more.push_back(a.alloc(64));
+    }
+    EXPECT_EQ(per_page, used_chunks(a));
+    void *p = a.alloc(64);
+    EXPECT_EQ(per_page - 99, used_chunks(a));
+    EXPECT_EQ(chunks.front(), p);
+    EXPECT_EQ(1, a.stats(class_of(a, 64)).pages);
+
+    a.free(p);
+    for (void *p : more) {
+        a.free(p);
+    }
+    EXPECT_EQ(0, used_chunks(a));
+}
+
+TEST(SlabTest, CacheOfExitedThread) {
+    Slab a;
+    void *p = nullptr;
+    std::thread([&a, &p]() { p = a.alloc(64); }).join();
+    a.free(p);
+
+    // Next thread takes the cache left along with its page
+    void *q = nullptr;
+    std::thread([&a, &q]() { q = a.alloc(64); }).join();
+    EXPECT_EQ(reinterpret_cast<uintptr_t>(p) / Slab::PAGE_SIZE, reinterpret_cast<uintptr_t>(q) / Slab::PAGE_SIZE);
+    EXPECT_EQ(1, a.stats(class_of(a, 64)).pages);
+
+    // Chunk freed meanwhile is still waiting to be collected
+    EXPECT_EQ(2, used_chunks(a));
+    a.free(q);
+}
+
+TEST(SlabTest, ProducerConsumer) {
+    Slab a;
+    const int n_pairs = 2;
+    const size_t n_ops = 100000;
+
+    // Each producer hands chunks to its consumer through a queue guarded by mutex
+    struct Queue {
+        std::mutex lock;
+        std::vector<char *> chunks;
+        bool done = false;
+    };
+    std::vector<Queue> queues(n_pairs);
+
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_pairs; t++) {
+        Queue &q = queues[t];
+        threads.emplace_back([&a, &q, t]() {
+            for (size_t i = 0; i < n_ops; i++) {
+                size_t size = 16 + i % 1000;
+                char *p = static_cast<char *>(a.alloc(size));
+                std::memset(p, t, size);
+                std::lock_guard<std::mutex> lock(q.lock);
+                q.chunks.push_back(p);
+            }
+            std::lock_guard<std::mutex> lock(q.lock);
+            q.done = true;
+        });
+        threads.emplace_back([&a, &q, t]() {
+            std::vector<char *> chunks;
+            for (bool done = false; !done;) {
+                {
+                    std::lock_guard<std::mutex> lock(q.lock);
+                    chunks.swap(q.chunks);
+                    done = q.done;
+                }
+                for (char *p : chunks) {
+                    ASSERT_EQ(char(t), p[0]);
+                    ASSERT_EQ(char(t), p[15]);
+                    a.free(p);
+                }
+                chunks.clear();
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+}
@@ -0,0 +1,107 @@
+#include "gtest/gtest.h"
+#include <deque>
+#include <map>
+#include <new>
+#include <string>
+#include <vector>
+
+#include <afina/allocator/StlAllocator.h>
+
+using namespace Afina::Allocator;
+
+static size_t used_chunks(const Slab &a) {
+    size_t result = 0;
+    for (size_t cls = 0; cls < a.classes(); cls++) {
+        result += a.stats(cls).used;
+    }
+    return result;
+}
+
+using String = std::basic_string<char, std::char_traits<char>, StlAllocator<char>>;
+
+TEST(StlAllocatorTest, Containers) {
+    Slab a;
+    {
+        std::vector<int, StlAllocator<int>> v{StlAllocator<int>(&a)};
+        for (int i = 0; i < 1000; i++) {
+            v.push_back(i);
+        }
+
+        std::deque<String, StlAllocator<String>> d{StlAllocator<String>(&a)};
+        for (int i = 0; i < 100; i++) {
+            d.emplace_back(std::string(100, 'a' + i % 26).c_str(), StlAllocator<char>(&a));
+        }
+
+        std::map<int, int, std::less<int>, StlAllocator<std::pair<const int, int>>> m{
+            std::less<int>(), StlAllocator<std::pair<const int, int>>(&a)};
+        for (int i = 0; i < 100; i++) {
+            m[i] = i;
+        }
+
+        EXPECT_EQ(999, v.back());
+        EXPECT_EQ(std::string(100, 'z'), d[25].c_str());
+        EXPECT_EQ(42, m[42]);
+        EXPECT_GT(used_chunks(a), 200);
+    }
+    EXPECT_EQ(0, used_chunks(a));
+}
+
+TEST(StlAllocatorTest, Equality) {
+    Slab a, b;
+    StlAllocator<int> x(&a);
+    StlAllocator<char> y(x);
+    EXPECT_EQ(&a, y.arena());
+    EXPECT_TRUE(x == y);
+    EXPECT_TRUE(x != StlAllocator<int>(&b));
+    EXPECT_TRUE(StlAllocator<int>(nullptr) == StlAllocator<char>(nullptr));
+
+    // Arena goes along with the contents
+    std::vector<int, StlAllocator<int>> v(10, 1, x);
+    std::vector<int, StlAllocator<int>> w{StlAllocator<int>(&b)};
+    w = std::move(v);
+    EXPECT_EQ(&a, w.get_allocator().arena());
+}
+
+TEST(StlAllocatorTest, Heap) {
+    std::vector<std::string, StlAllocator<std::string>> v{StlAllocator<std::string>(nullptr)};
+    for (int i = 0; i < 100; i++) {
+        v.push_back(std::to_string(i));
+    }
+    EXPECT_EQ("99", v.back());
+}
+
+TEST(StlAllocatorTest, DefaultArena) {
+    Slab *process = DefaultArena();
+    ASSERT_NE(nullptr, process);
+    EXPECT_EQ(process, StlAllocator<int>().arena());
+
+    Slab a;
+    SetDefaultArena(&a);
+    {
+        String s(1000, 'x');
+        EXPECT_EQ(1, used_chunks(a));
+    }
+    SetDefaultArena(process);
+    EXPECT_EQ(0, used_chunks(a));
+}
+
+TEST(StlAllocatorTest, Limit) {
+    Slab a(Slab::ARENA_SIZE);
+    EXPECT_EQ(Slab::ARENA_SIZE, a.limit());
+
+    // Single arena is all allocator could map
+    std::vector<void *> chunks;
+    for (size_t i = 0; i < Slab::ARENA_SIZE / Slab::PAGE_SIZE; i++) {
+        chunks.push_back(a.alloc(Slab::MAX_CHUNK));
+    }
+    EXPECT_THROW(a.alloc(2 * Slab::PAGE_SIZE), std::bad_alloc);
+    StlAllocator<char> limited(&a);
+    EXPECT_THROW(limited.allocate(Slab::PAGE_SIZE), std::bad_alloc);
+    EXPECT_EQ(Slab::ARENA_SIZE, a.mapped());
+
+    a.set_limit(0);
+    chunks.push_back(a.alloc(2 * Slab::PAGE_SIZE));
+    for (void *p : chunks) {
+        a.free(p);
+    }
+}
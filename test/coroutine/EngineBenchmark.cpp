@@ -0,0 +1,123 @@
+#include "gtest/gtest.h"
+#include <chrono>
+#include <cstdlib>
+#include <iomanip>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <vector>
+
+#include <afina/coroutine/Engine.h>
+
+using namespace Afina::Coroutine;
+
+/**
+ * Benchmarks are not a part of regular test run, parameters could be tuned
+ * using environment:
+ * - AFINA_BENCH_SWITCHES: number of switches each run makes, 1000000 by default
+ * - AFINA_BENCH_DEPTHS: comma separated list of stack bytes each routine keeps in use while switching,
+ *   "0,1024,16384" by default
+ * - AFINA_BENCH_SPAWNS: number of routines started one after another, 1000000 by default
+ */
+static std::vector<size_t> env_list(const char *name, const char *def) {
+    const char *value = std::getenv(name);
+    std::stringstream ss(value != nullptr ? value : def);
+
+    std::vector<size_t> result;
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        result.push_back(std::stoul(item));
+    }
+    return result;
+}
+
+static size_t env_size(const char *name, size_t def) {
+    const char *value = std::getenv(name);
+    return value != nullptr ? std::stoul(value) : def;
+}
+
+namespace {
+
+struct PingPong {
+    Engine *engine;
+    size_t switches;
+    size_t depth;
+    void *routines[2];
+    double elapsed;
+};
+
+// Takes depth bytes of stack, then passes control to the other routine until switches are over
+void player(PingPong &game, int me, size_t depth) {
+    if (depth >= 1024) {
+        volatile char frame[1024];
+        frame[0] = char(me);
+        player(game, me, depth - 1024);
+        frame[1] = frame[0];
+        return;
+    }
+
+    while (game.switches > 0) {
+        game.switches--;
+        game.engine->sched(game.routines[1 - me]);
+    }
+    // Let the other one see the end
+    game.engine->sched(game.routines[1 - me]);
+}
+
+void referee(PingPong &game) {
+    game.routines[0] = game.engine->run(player, game, 0, size_t(game.depth));
+    game.routines[1] = game.engine->run(player, game, 1, size_t(game.depth));
+
+    auto start = std::chrono::steady_clock::now();
+    game.engine->sched(game.routines[0]);
+    game.elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+// Returns nanoseconds per switch
+double run_switches(Engine::Mode mode, size_t switches, size_t depth) {
+    Engine engine(mode);
+    PingPong game{&engine, switches, depth, {nullptr, nullptr}, 0};
+    engine.start(referee, game);
+    return game.elapsed * 1e9 / switches;
+}
+
+void nop(int &done) { done++; }
+
+void spawner(Engine &engine, size_t spawns, double &elapsed) {
+    int done = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < spawns; i++) {
+        engine.run(nop, done);
+        engine.yield();
+    }
+    elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+}
+
+} // namespace
+
+TEST(EngineBenchmark, SwitchLatency) {
+    size_t switches = env_size("AFINA_BENCH_SWITCHES", 1000000);
+    std::vector<size_t> depths = env_list("AFINA_BENCH_DEPTHS", "0,1024,16384");
+
+    std::cout << std::setw(12) << "mode" << std::setw(12) << "depth" << std::setw(14) << "ns/switch" << std::endl;
+    for (Engine::Mode mode : {Engine::Mode::StackCopy, Engine::Mode::Dedicated}) {
+        for (size_t depth : depths) {
+            double ns = run_switches(mode, switches, depth);
+            std::cout << std::setw(12) << (mode == Engine::Mode::StackCopy ? "copy" : "dedicated") << std::setw(12)
+                      << depth << std::setw(14) << std::fixed << std::setprecision(1) << ns << std::endl;
+        }
+    }
+}
+
+TEST(EngineBenchmark, Spawn) {
+    size_t spawns = env_size("AFINA_BENCH_SPAWNS", 1000000);
+
+    std::cout << std::setw(12) << "mode" << std::setw(14) << "ns/spawn" << std::endl;
+    for (Engine::Mode mode : {Engine::Mode::StackCopy, Engine::Mode::Dedicated}) {
+        Engine engine(mode);
+        double elapsed = 0;
+        engine.start(spawner, engine, size_t(spawns), elapsed);
+        std::cout << std::setw(12) << (mode == Engine::Mode::StackCopy ? "copy" : "dedicated") << std::setw(14)
+                  << std::fixed << std::setprecision(1) << elapsed * 1e9 / spawns << std::endl;
+    }
+}
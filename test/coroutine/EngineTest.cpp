@@ -1,7 +1,16 @@
 #include "gtest/gtest.h"
 
+#include <chrono>
 #include <iostream>
 #include <sstream>
+#include <string>
+#include <vector>
+
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/socket.h>
+#include <unistd.h>
 
 #include <afina/coroutine/Engine.h>
 
@@ -69,3 +78,310 @@ TEST(CoroutineTest, Printer) {
     engine.start(_printer, engine, result);
     ASSERT_STREQ("A1 B1 A2 B2 A3 B3 END", result.c_str());
 }
+
+TEST(CoroutineTest, DedicatedSimpleStart) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    int result;
+    engine.start(_calculator_add, result, 1, 2);
+
+    ASSERT_EQ(3, result);
+}
+
+void _dedicated_printer(Afina::Coroutine::Engine &pe, std::stringstream &out, std::string &result) {
+    void *a = nullptr, *b = nullptr;
+    a = pe.run(printa, pe, out, b);
+    b = pe.run(printb, pe, out, a);
+    pe.sched(a);
+
+    out << "END";
+    result = out.str();
+}
+
+TEST(CoroutineTest, DedicatedPrinter) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    std::stringstream out;
+    std::string result;
+    engine.start(_dedicated_printer, engine, out, result);
+    ASSERT_STREQ("A1 B1 A2 B2 A3 B3 END", result.c_str());
+}
+
+// Fills stack with the pattern unique for the routine, switches away and checks that nobody touched it
+static void _deep(Afina::Coroutine::Engine &pe, int id, int depth, int &checked) {
+    volatile char frame[1024];
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        frame[i] = char(id + depth);
+    }
+
+    if (depth > 0) {
+        _deep(pe, id, depth - 1, checked);
+    } else {
+        pe.yield();
+    }
+
+    for (size_t i = 0; i < sizeof(frame); i++) {
+        if (frame[i] != char(id + depth)) {
+            return;
+        }
+    }
+    checked++;
+}
+
+static void _many(Afina::Coroutine::Engine &pe, int &checked) {
+    for (int id = 0; id < 50; id++) {
+        pe.run(_deep, pe, int(id), int(64), checked);
+    }
+    pe.yield();
+}
+
+TEST(CoroutineTest, DedicatedStacks) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated, 128 * 1024);
+
+    int checked = 0;
+    engine.start(_many, engine, checked);
+    ASSERT_EQ(50 * 65, checked);
+}
+
+static void _float(Afina::Coroutine::Engine &pe, double x, double &result) {
+    // Keeps value in the callee-saved registers across the switch where ABI has ones
+    double y = x * 3;
+    pe.yield();
+    result = y + x;
+}
+
+static void _floats(Afina::Coroutine::Engine &pe, double &a, double &b) {
+    pe.run(_float, pe, 1.5, a);
+    pe.run(_float, pe, 2.5, b);
+    pe.yield();
+}
+
+TEST(CoroutineTest, DedicatedFloat) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    double a = 0, b = 0;
+    engine.start(_floats, engine, a, b);
+    EXPECT_EQ(6.0, a);
+    EXPECT_EQ(10.0, b);
+}
+
+static void _reader(Afina::Coroutine::Engine &pe, int fd, std::string &result) {
+    char buffer[16];
+    ssize_t n;
+    while ((n = pe.read(fd, buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, n);
+    }
+    close(fd);
+}
+
+static void _writer(Afina::Coroutine::Engine &pe, int fd, size_t size) {
+    // Pipe gets full long before, so writer waits for the reader many times
+    std::string data(size, 'x');
+    for (size_t i = 0; i < size; i++) {
+        data[i] = char('a' + i % 26);
+    }
+
+    size_t written = 0;
+    while (written < size) {
+        ssize_t n = pe.write(fd, data.data() + written, size - written);
+        ASSERT_GT(n, 0);
+        written += n;
+    }
+    close(fd);
+}
+
+static void _pipe(Afina::Coroutine::Engine &pe, std::string &result, size_t size) {
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+
+    // Reader goes first and blocks at once
+    pe.run(_reader, pe, int(fds[0]), result);
+    pe.run(_writer, pe, int(fds[1]), size_t(size));
+}
+
+TEST(CoroutineTest, ReadWrite) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    size_t size = 1 << 20;
+    std::string result;
+    engine.start(_pipe, engine, result, size_t(size));
+    ASSERT_EQ(size, result.size());
+    for (size_t i = 0; i < size; i += 4099) {
+        ASSERT_EQ(char('a' + i % 26), result[i]);
+    }
+}
+
+static void _sleeper(Afina::Coroutine::Engine &pe, int ms, std::vector<int> &order) {
+    pe.sleep(ms);
+    order.push_back(ms);
+}
+
+static void _sleepers(Afina::Coroutine::Engine &pe, std::vector<int> &order) {
+    for (int ms : {30, 10, 20, 0}) {
+        pe.run(_sleeper, pe, int(ms), order);
+    }
+}
+
+TEST(CoroutineTest, Sleep) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    std::vector<int> order;
+    auto start = std::chrono::steady_clock::now();
+    engine.start(_sleepers, engine, order);
+    auto elapsed = std::chrono::steady_clock::now() - start;
+
+    // Routines sleep at once, so it takes as long as the longest sleep
+    ASSERT_EQ(std::vector<int>({0, 10, 20, 30}), order);
+    EXPECT_GE(elapsed, std::chrono::milliseconds(30));
+    EXPECT_LT(elapsed, std::chrono::milliseconds(300));
+}
+
+static void _echo(Afina::Coroutine::Engine &pe, int server) {
+    int client = pe.accept(server);
+    ASSERT_NE(-1, client);
+    close(server);
+
+    char buffer[64];
+    ssize_t n;
+    while ((n = pe.read(client, buffer, sizeof(buffer))) > 0) {
+        ASSERT_EQ(n, pe.write(client, buffer, n));
+    }
+    close(client);
+}
+
+static void _client(Afina::Coroutine::Engine &pe, int port, std::string &result) {
+    int s = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_port = htons(port);
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    connect(s, (struct sockaddr *)&addr, sizeof(addr));
+
+    // Connect completes once socket gets writable
+    std::string message = "ping";
+    ASSERT_EQ(ssize_t(message.size()), pe.write(s, message.data(), message.size()));
+    shutdown(s, SHUT_WR);
+
+    char buffer[64];
+    ssize_t n;
+    while ((n = pe.read(s, buffer, sizeof(buffer))) > 0) {
+        result.append(buffer, n);
+    }
+    close(s);
+}
+
+static void _network(Afina::Coroutine::Engine &pe, std::string &result) {
+    int server = socket(AF_INET, SOCK_STREAM | SOCK_NONBLOCK, 0);
+    struct sockaddr_in addr = {};
+    addr.sin_family = AF_INET;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    socklen_t len = sizeof(addr);
+    ASSERT_EQ(0, bind(server, (struct sockaddr *)&addr, sizeof(addr)));
+    ASSERT_EQ(0, listen(server, 1));
+    ASSERT_EQ(0, getsockname(server, (struct sockaddr *)&addr, &len));
+
+    pe.run(_echo, pe, int(server));
+    pe.run(_client, pe, int(ntohs(addr.sin_port)), result);
+}
+
+TEST(CoroutineTest, Accept) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    std::string result;
+    engine.start(_network, engine, result);
+    ASSERT_EQ("ping", result);
+}
+
+static void _blocked(Afina::Coroutine::Engine &pe, int &steps) {
+    steps++;
+    pe.block();
+    steps++;
+}
+
+static void _unblocker(Afina::Coroutine::Engine &pe, int &steps) {
+    void *a = pe.run(_blocked, pe, steps);
+    pe.run(_blocked, pe, steps);
+
+    // Once the first one blocks control goes to the other one ready to run
+    pe.sched(a);
+    EXPECT_EQ(2, steps);
+
+    // Blocked routines are never picked by yield
+    pe.yield();
+    EXPECT_EQ(2, steps);
+
+    pe.unblock(a);
+    pe.yield();
+    EXPECT_EQ(3, steps);
+
+    // The other one is left blocked for good and dropped
+}
+
+TEST(CoroutineTest, BlockUnblock) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    int steps = 0;
+    engine.start(_unblocker, engine, steps);
+    EXPECT_EQ(3, steps);
+    EXPECT_EQ(engine.stacks().mapped(), engine.stacks().free());
+}
+
+static void _early(Afina::Coroutine::Engine &pe, std::chrono::steady_clock::duration &slept) {
+    auto start = std::chrono::steady_clock::now();
+    pe.sleep(50);
+    slept = std::chrono::steady_clock::now() - start;
+}
+
+static void _early_reader(Afina::Coroutine::Engine &pe, int fd, std::string &result) {
+    char c;
+    if (pe.read(fd, &c, 1) == 1) {
+        result.push_back(c);
+    }
+}
+
+static void _wake_early(Afina::Coroutine::Engine &pe, std::chrono::steady_clock::duration &slept, int &steps,
+                        std::string &result) {
+    // Sleeping routine is woken up by sched and completes, the next one gets its stack and context
+    void *a = pe.run(_early, pe, slept);
+    pe.yield();
+    pe.sched(a);
+
+    void *b = pe.run(_blocked, pe, steps);
+    EXPECT_EQ(a, b);
+    pe.yield();
+    EXPECT_EQ(1, steps);
+
+    // Timer of the first one must not wake up the second one
+    pe.sleep(100);
+    EXPECT_EQ(1, steps);
+
+    // Reader woken up early waits for the data again
+    int fds[2];
+    ASSERT_EQ(0, pipe2(fds, O_NONBLOCK));
+    void *c = pe.run(_early_reader, pe, int(fds[0]), result);
+    pe.yield();
+    pe.sched(c);
+    pe.sched(c);
+    EXPECT_EQ("", result);
+
+    ASSERT_EQ(1, write(fds[1], "x", 1));
+    pe.sleep(10);
+    EXPECT_EQ("x", result);
+    close(fds[0]);
+    close(fds[1]);
+
+    // Nothing waits anymore, so engine drops the blocked ones instead of waiting forever
+    pe.block();
+}
+
+TEST(CoroutineTest, EarlyWakeUp) {
+    Afina::Coroutine::Engine engine(Afina::Coroutine::Engine::Mode::Dedicated);
+
+    std::chrono::steady_clock::duration slept;
+    int steps = 0;
+    std::string result;
+    engine.start(_wake_early, engine, slept, steps, result);
+    EXPECT_LT(slept, std::chrono::milliseconds(50));
+    EXPECT_EQ(1, steps);
+    EXPECT_EQ("x", result);
+}
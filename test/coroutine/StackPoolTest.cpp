@@ -0,0 +1,98 @@
+#include "gtest/gtest.h"
+#include <cstring>
+
+#include <unistd.h>
+
+#include <afina/coroutine/Engine.h>
+#include <afina/coroutine/StackPool.h>
+
+using namespace Afina::Coroutine;
+
+TEST(StackPoolTest, RoundsToPages) {
+    size_t page = sysconf(_SC_PAGESIZE);
+    EXPECT_EQ(page, StackPool(1).stack_size());
+    EXPECT_EQ(2 * page, StackPool(page + 1).stack_size());
+    EXPECT_EQ(4 * page, StackPool(4 * page).stack_size());
+}
+
+TEST(StackPoolTest, Reuse) {
+    StackPool pool(64 * 1024);
+    char *a = pool.Get();
+    char *b = pool.Get();
+    ASSERT_NE(a, b);
+    std::memset(a, 'a', pool.stack_size());
+    std::memset(b, 'b', pool.stack_size());
+    EXPECT_EQ(2, pool.mapped());
+    EXPECT_EQ(0, pool.free());
+
+    // Last stack given back is taken first, while it is still warm
+    pool.Put(a);
+    pool.Put(b);
+    EXPECT_EQ(2, pool.free());
+    EXPECT_EQ(b, pool.Get());
+    EXPECT_EQ(a, pool.Get());
+    EXPECT_EQ(2, pool.mapped());
+
+    pool.Put(a);
+    pool.Put(b);
+}
+
+TEST(StackPoolTest, MaxFree) {
+    StackPool pool(16 * 1024, 1);
+    char *a = pool.Get();
+    char *b = pool.Get();
+    pool.Put(a);
+    pool.Put(b);
+    EXPECT_EQ(1, pool.free());
+    EXPECT_EQ(1, pool.mapped());
+}
+
+TEST(StackPoolDeathTest, GuardPage) {
+    StackPool pool(16 * 1024);
+    char *stack = pool.Get();
+    stack[0] = 'x';
+
+    volatile char *below = stack - 1;
+    EXPECT_DEATH(*below = 'x', "");
+    pool.Put(stack);
+}
+
+static void _recurse(int depth) {
+    volatile char frame[1024];
+    frame[0] = char(depth);
+    _recurse(depth + 1);
+    frame[1] = frame[0];
+}
+
+static void _overflow(Afina::Coroutine::Engine &pe) { pe.run(_recurse, int(0)); }
+
+TEST(StackPoolDeathTest, EngineOverflow) {
+    // Routine that runs out of its stack is killed on the guard page
+    EXPECT_DEATH(
+        {
+            Engine engine(Engine::Mode::Dedicated, 64 * 1024);
+            engine.start(_overflow, engine);
+        },
+        "");
+}
+
+static void _count(int &done) { done++; }
+
+static void _spawn(Engine &pe, int &done, int n) {
+    for (int i = 0; i < n; i++) {
+        pe.run(_count, done);
+        pe.yield();
+    }
+}
+
+TEST(StackPoolTest, EngineRecycles) {
+    // Routines come and go one at a time, so few stacks are in use at once
+    Engine engine(Engine::Mode::Dedicated, 32 * 1024);
+    EXPECT_EQ(32 * 1024, engine.stack_size());
+
+    int done = 0;
+    engine.start(_spawn, engine, done, int(10000));
+    EXPECT_EQ(10000, done);
+    EXPECT_EQ(2, engine.stacks().mapped());
+    EXPECT_EQ(2, engine.stacks().free());
+}
@@ -0,0 +1,135 @@
+#include "gtest/gtest.h"
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <afina/Value.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Response.h>
+#include <afina/execute/Set.h>
+#include <storage/MapBasedFlatCombineImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+
+using namespace Afina;
+using namespace Afina::Backend;
+using namespace Afina::Execute;
+
+TEST(ResponseTest, TextAndValues) {
+    Response response;
+    response.Append("VALUE k 0 3\r\n");
+    response.Append(Value::Copy("abc"));
+    response.Append("\r\n");
+    response.Append("END");
+
+    EXPECT_EQ(21, response.size());
+    EXPECT_EQ("VALUE k 0 3\r\nabc\r\nEND", response.str());
+    EXPECT_EQ(3, response.Chunks().size());
+
+    response.Clear();
+    EXPECT_EQ(0, response.size());
+    EXPECT_EQ(0, response.Chunks().size());
+}
+
+TEST(ExecuteTest, GetReferencesStoredValue) {
+    MapBasedGlobalLockImpl storage;
+    storage.Put("KEY", std::string(1024, 'x'));
+
+    Value stored;
+    ASSERT_TRUE(storage.Get("KEY", stored));
+
+    Afina::Execute::Get get({"KEY", "NONE"});
+    Response response;
+    get.Execute(storage, "", response);
+
+    // Value chunk points to the same bytes as storage holds
+    bool referenced = false;
+    for (auto &chunk : response.Chunks()) {
+        referenced |= chunk.data() == stored.data();
+    }
+    EXPECT_TRUE(referenced);
+    EXPECT_EQ("VALUE KEY 0 1024\r\n" + std::string(1024, 'x') + "\r\nEND", response.str());
+
+    // Handle keeps value alive once association is gone
+    storage.Delete("KEY");
+    EXPECT_EQ(std::string(1024, 'x'), stored.str());
+}
+
+TEST(ExecuteTest, StringAndChunkedResultsMatch) {
+    MapBasedFlatCombineImpl storage;
+
+    // Commands without chunked implementation fall back to the string one
+    Afina::Execute::Set set("KEY", 0, 0);
+    Command &command = set;
+    Response set_response;
+    command.Execute(storage, "value", set_response);
+    EXPECT_EQ("STORED", set_response.str());
+
+    Afina::Execute::Get get({"KEY"});
+    std::string out;
+    get.Execute(storage, "", out);
+
+    Response response;
+    get.Execute(storage, "", response);
+    EXPECT_EQ(out, response.str());
+    EXPECT_EQ("VALUE KEY 0 5\r\nvalue\r\nEND", out);
+}
+
+TEST(ExecuteTest, FlagsRoundTrip) {
+    MapBasedGlobalLockImpl storage;
+
+    std::string out;
+    Afina::Execute::Set set("KEY", 3735928559u, 0);
+    set.Execute(storage, "value", out);
+    EXPECT_EQ("STORED", out);
+
+    Afina::Execute::Get get({"KEY"});
+    get.Execute(storage, "", out);
+    EXPECT_EQ("VALUE KEY 3735928559 5\r\nvalue\r\nEND", out);
+}
+
+TEST(ExecuteTest, GetsAndCas) {
+    MapBasedGlobalLockImpl storage;
+    storage.Put("KEY", "value");
+
+    Value value;
+    Metadata meta;
+    ASSERT_TRUE(storage.Get("KEY", value, meta));
+    std::string version = std::to_string(meta.cas);
+
+    std::string out;
+    Afina::Execute::Get gets({"KEY"}, true);
+    gets.Execute(storage, "", out);
+    EXPECT_EQ("VALUE KEY 0 5 " + version + "\r\nvalue\r\nEND", out);
+
+    Afina::Execute::Cas cas("KEY", 0, 0, meta.cas);
+    cas.Execute(storage, "other", out);
+    EXPECT_EQ("STORED", out);
+    cas.Execute(storage, "again", out);
+    EXPECT_EQ("EXISTS", out);
+
+    Afina::Execute::Cas missing("NONE", 0, 0, meta.cas);
+    missing.Execute(storage, "other", out);
+    EXPECT_EQ("NOT_FOUND", out);
+}
+
+TEST(ExecuteTest, Incr) {
+    MapBasedGlobalLockImpl storage;
+    storage.Put("NUM", "41");
+    storage.Put("TEXT", "abc");
+
+    std::string out;
+    Afina::Execute::Incr incr("NUM", 1);
+    incr.Execute(storage, "", out);
+    EXPECT_EQ("42", out);
+
+    Afina::Execute::Incr text("TEXT", 1);
+    text.Execute(storage, "", out);
+    EXPECT_EQ("CLIENT_ERROR cannot increment or decrement non-numeric value", out);
+
+    Afina::Execute::Incr missing("NONE", 1);
+    missing.Execute(storage, "", out);
+    EXPECT_EQ("NOT_FOUND", out);
+}
@@ -4,7 +4,12 @@
 #include <string>
 
 #include <afina/execute/Add.h>
+#include <afina/execute/Cas.h>
+#include <afina/execute/Decr.h>
 #include <afina/execute/Get.h>
+#include <afina/execute/Incr.h>
+#include <afina/execute/Prepend.h>
+#include <afina/execute/Replace.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Stats.h>
 
@@ -98,3 +103,117 @@ TEST(MemcachedParserTest, Stats) {
     Execute::Stats *tmp = reinterpret_cast<Execute::Stats *>(cmd.get());
 	ASSERT_FALSE(tmp == nullptr);
 }
+
+// Verify multi digit expiration time
+TEST(MemcachedParserTest, ExpireTime) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("set foo 0 3600 6\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Set *tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    ASSERT_EQ(3600, tmp->expire());
+
+    parser.Reset();
+    cmd_avail = parser.Parse("set foo 0 -120 6\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    cmd = parser.Build(value_size);
+    tmp = reinterpret_cast<Execute::Set *>(cmd.get());
+    ASSERT_EQ(-120, tmp->expire());
+}
+
+TEST(MemcachedParserTest, Gets) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("gets foo bar\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(14, consumed);
+    ASSERT_EQ("gets", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Get *tmp = reinterpret_cast<Execute::Get *>(cmd.get());
+    ASSERT_EQ(2, tmp->keys().size());
+    ASSERT_TRUE(tmp->with_cas());
+}
+
+TEST(MemcachedParserTest, Cas) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("cas foo 5 100 6 18446744073709551615\r\nfooval\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(38, consumed);
+    ASSERT_EQ("cas", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(6, value_size);
+
+    Execute::Cas *tmp = reinterpret_cast<Execute::Cas *>(cmd.get());
+    ASSERT_EQ("foo", tmp->key());
+    ASSERT_EQ(5, tmp->flags());
+    ASSERT_EQ(100, tmp->expire());
+    ASSERT_EQ(18446744073709551615ULL, tmp->cas());
+}
+
+TEST(MemcachedParserTest, IncrDecr) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    bool cmd_avail = parser.Parse("incr foo 42\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ(13, consumed);
+    ASSERT_EQ("incr", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(0, value_size);
+
+    Execute::Incr *incr = reinterpret_cast<Execute::Incr *>(cmd.get());
+    ASSERT_EQ("foo", incr->key());
+    ASSERT_EQ(42, incr->value());
+
+    parser.Reset();
+    cmd_avail = parser.Parse("decr bar 18446744073709551615\r\n", consumed);
+    ASSERT_TRUE(cmd_avail);
+    ASSERT_EQ("decr", parser.Name());
+    cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+
+    Execute::Decr *decr = reinterpret_cast<Execute::Decr *>(cmd.get());
+    ASSERT_EQ("bar", decr->key());
+    ASSERT_EQ(18446744073709551615ULL, decr->value());
+}
+
+TEST(MemcachedParserTest, ReplaceAndPrepend) {
+    Protocol::Parser parser;
+
+    size_t consumed = 0;
+    ASSERT_TRUE(parser.Parse("replace foo 1 0 3\r\nabc\r\n", consumed));
+    ASSERT_EQ("replace", parser.Name());
+
+    uint32_t value_size;
+    std::unique_ptr<Execute::Command> cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(3, value_size);
+    ASSERT_EQ("foo", reinterpret_cast<Execute::Replace *>(cmd.get())->key());
+
+    parser.Reset();
+    ASSERT_TRUE(parser.Parse("prepend foo 0 0 3\r\nabc\r\n", consumed));
+    ASSERT_EQ("prepend", parser.Name());
+    cmd = parser.Build(value_size);
+    ASSERT_FALSE(cmd == nullptr);
+    ASSERT_EQ(3, value_size);
+    ASSERT_EQ("foo", reinterpret_cast<Execute::Prepend *>(cmd.get())->key());
+}
@@ -0,0 +1,459 @@
+#include "gtest/gtest.h"
+#include <atomic>
+#include <chrono>
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <sstream>
+#include <unordered_map>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <afina/Storage.h>
+#include <afina/allocator/StlAllocator.h>
+#include <storage/MapBasedFlatCombineImpl.h>
+#include <storage/MapBasedGlobalLockImpl.h>
+#include <storage/MapBasedLockFreeImpl.h>
+#include <storage/MapBasedShardedImpl.h>
+#include <storage/SwissIndex.h>
+
+using namespace Afina::Backend;
+
+/**
+ * Benchmarks are not a part of regular test run, parameters could be tuned
+ * using environment:
+ * - AFINA_BENCH_THREADS: comma separated list of threads count, "1,2,4,8,16" by default
+ *   ("1,2,4,8,16,32,64" in ReadContention)
+ * - AFINA_BENCH_OPS: number of operations each thread performs, 200000 by default
+ * - AFINA_BENCH_KEYS: number of distinct keys, 100000 by default
+ * - AFINA_BENCH_TRACE: file with one key per line to replay in EvictionHitRatio instead of
+ *   the synthetic trace
+ * - AFINA_BENCH_CACHE_PERCENT: cache capacity in EvictionHitRatio, percent of distinct keys
+ *   it could hold, 10 by default
+ * - AFINA_BENCH_INDEX_KEYS: comma separated list of index sizes in IndexLookup, "1000000,10000000"
+ *   by default
+ * - AFINA_BENCH_HUGE_KEYS: comma separated list of storage sizes in HugePages, "1000000,4000000"
+ *   by default
+ */
+static std::vector<size_t> env_list(const char *name, const char *def) {
+    const char *value = std::getenv(name);
+    std::stringstream ss(value != nullptr ? value : def);
+
+    std::vector<size_t> result;
+    std::string item;
+    while (std::getline(ss, item, ',')) {
+        result.push_back(std::stoul(item));
+    }
+    return result;
+}
+
+static size_t env_size(const char *name, size_t def) {
+    const char *value = std::getenv(name);
+    return value != nullptr ? std::stoul(value) : def;
+}
+
+static std::string make_key(size_t i) {
+    std::stringstream ss;
+    ss << "Key" << std::setw(8) << std::setfill('0') << i;
+    return ss.str();
+}
+
+using StorageFactory = std::function<Afina::Storage *()>;
+
+/**
+ * Run mixed workload: each thread performs n_ops operations on random keys, where
+ * every put_every-th operation is Put and the rest are Get. Returns total throughput in ops/sec
+ */
+static double run_mixed(Afina::Storage &storage, size_t n_threads, size_t n_ops, const std::vector<std::string> &keys,
+                        size_t put_every = 10) {
+    std::atomic<size_t> ready(0);
+    std::atomic<bool> go(false);
+    std::vector<std::thread> threads;
+
+    for (size_t t = 0; t < n_threads; t++) {
+        threads.emplace_back([&, t]() {
+            uint64_t x = 0x2545F4914F6CDD1DULL * (t + 1);
+            std::string value;
+            std::string put_value(32, 'v');
+
+            ready++;
+            while (!go.load()) {
+                std::this_thread::yield();
+            }
+
+            for (size_t i = 0; i < n_ops; i++) {
+                // xorshift64
+                x ^= x << 13;
+                x ^= x >> 7;
+                x ^= x << 17;
+
+                const std::string &key = keys[x % keys.size()];
+                if (i % put_every == 0) {
+                    storage.Put(key, put_value);
+                } else {
+                    storage.Get(key, value);
+                }
+            }
+        });
+    }
+
+    while (ready.load() != n_threads) {
+        std::this_thread::yield();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    go.store(true);
+    for (auto &t : threads) {
+        t.join();
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    return (n_threads * n_ops) / elapsed;
+}
+
+TEST(StorageBenchmark, MixedThroughput) {
+    std::vector<size_t> n_threads = env_list("AFINA_BENCH_THREADS", "1,2,4,8,16");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 200000);
+    size_t n_keys = env_size("AFINA_BENCH_KEYS", 100000);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < n_keys; i++) {
+        keys.push_back(make_key(i));
+    }
+
+    // Budget is big enough to hold the whole dataset, so benchmark measures synchronization only
+    size_t max_size = n_keys * 128;
+    std::vector<std::pair<std::string, StorageFactory>> backends = {
+        {"map_global", [=]() { return new MapBasedGlobalLockImpl(max_size); }},
+        {"map_batched", [=]() { return new MapBasedGlobalLockImpl(max_size, EvictionPolicy::Type::Lru, false, true); }},
+        {"map_fc", [=]() { return new MapBasedFlatCombineImpl(max_size); }},
+        {"sharded", [=]() { return new MapBasedShardedImpl(max_size, 64); }},
+        {"lock_free", [=]() { return new MapBasedLockFreeImpl(max_size); }},
+    };
+
+    std::cout << std::setw(12) << "backend" << std::setw(10) << "threads" << std::setw(14) << "Mops/sec"
+              << std::endl;
+    for (auto &backend : backends) {
+        for (size_t threads : n_threads) {
+            std::unique_ptr<Afina::Storage> storage(backend.second());
+            for (auto &key : keys) {
+                storage->Put(key, std::string(32, 'v'));
+            }
+
+            double ops = run_mixed(*storage, threads, n_ops, keys);
+            std::cout << std::setw(12) << backend.first << std::setw(10) << threads << std::setw(14)
+                      << std::fixed << std::setprecision(3) << ops / 1e6 << std::endl;
+        }
+    }
+}
+
+/**
+ * Read mostly workload over a small hot set: all threads hit the same few keys, so backends that
+ * take a lock on every read serialize on it. 1% of operations are Put
+ */
+TEST(StorageBenchmark, ReadContention) {
+    std::vector<size_t> n_threads = env_list("AFINA_BENCH_THREADS", "1,2,4,8,16,32,64");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 200000);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < 1000; i++) {
+        keys.push_back(make_key(i));
+    }
+
+    size_t max_size = keys.size() * 128;
+    std::vector<std::pair<std::string, StorageFactory>> backends = {
+        {"map_global", [=]() { return new MapBasedGlobalLockImpl(max_size); }},
+        {"map_batched", [=]() { return new MapBasedGlobalLockImpl(max_size, EvictionPolicy::Type::Lru, false, true); }},
+        {"map_fc", [=]() { return new MapBasedFlatCombineImpl(max_size); }},
+        {"sharded", [=]() { return new MapBasedShardedImpl(max_size, 64); }},
+        {"lock_free", [=]() { return new MapBasedLockFreeImpl(max_size); }},
+    };
+
+    std::cout << std::setw(12) << "backend" << std::setw(10) << "threads" << std::setw(14) << "Mops/sec"
+              << std::endl;
+    for (auto &backend : backends) {
+        for (size_t threads : n_threads) {
+            std::unique_ptr<Afina::Storage> storage(backend.second());
+            for (auto &key : keys) {
+                storage->Put(key, std::string(32, 'v'));
+            }
+
+            double ops = run_mixed(*storage, threads, n_ops, keys, 100);
+            std::cout << std::setw(12) << backend.first << std::setw(10) << threads << std::setw(14)
+                      << std::fixed << std::setprecision(3) << ops / 1e6 << std::endl;
+        }
+    }
+}
+
+/**
+ * Synthetic trace: zipfian (s = 0.99) accesses to n_keys keys, interrupted every scan_every
+ * accesses by a scan over scan_len keys that are never accessed again
+ */
+static std::vector<std::string> synthetic_trace(size_t n_keys, size_t n_ops, size_t scan_every, size_t scan_len) {
+    std::vector<double> cdf(n_keys);
+    double sum = 0;
+    for (size_t i = 0; i < n_keys; i++) {
+        sum += 1.0 / std::pow(double(i + 1), 0.99);
+        cdf[i] = sum;
+    }
+
+    std::vector<std::string> trace;
+    trace.reserve(n_ops + (n_ops / scan_every) * scan_len);
+
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    size_t scanned = 0;
+    for (size_t i = 0; i < n_ops; i++) {
+        if ((i > 0) && (i % scan_every == 0)) {
+            for (size_t j = 0; j < scan_len; j++) {
+                trace.push_back("Scan" + std::to_string(scanned++));
+            }
+        }
+
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        double u = (x >> 11) * (1.0 / 9007199254740992.0) * sum;
+        size_t rank = std::lower_bound(cdf.begin(), cdf.end(), u) - cdf.begin();
+        trace.push_back(make_key(std::min(rank, n_keys - 1)));
+    }
+    return trace;
+}
+
+TEST(StorageBenchmark, EvictionHitRatio) {
+    size_t n_keys = env_size("AFINA_BENCH_KEYS", 100000);
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 2000000);
+    size_t cache_percent = env_size("AFINA_BENCH_CACHE_PERCENT", 10);
+
+    std::vector<std::string> trace;
+    const char *trace_file = std::getenv("AFINA_BENCH_TRACE");
+    if (trace_file != nullptr) {
+        std::ifstream in(trace_file);
+        std::string key;
+        while (std::getline(in, key)) {
+            trace.push_back(key);
+        }
+        std::vector<std::string> distinct(trace);
+        std::sort(distinct.begin(), distinct.end());
+        n_keys = std::unique(distinct.begin(), distinct.end()) - distinct.begin();
+    } else {
+        size_t cache_items = n_keys * cache_percent / 100;
+        trace = synthetic_trace(n_keys, n_ops, n_ops / 10, cache_items * 2);
+    }
+
+    // Every item takes key plus 32 bytes of value
+    size_t item_size = make_key(0).size() + 32;
+    size_t max_size = n_keys * cache_percent / 100 * item_size;
+    std::string put_value(32, 'v');
+
+    struct Setup {
+        std::string name;
+        EvictionPolicy::Type eviction;
+        bool admission;
+    };
+    std::vector<Setup> policies = {
+        {"lru", EvictionPolicy::Type::Lru, false},
+        {"slru", EvictionPolicy::Type::SegmentedLru, false},
+        {"clock", EvictionPolicy::Type::Clock, false},
+        {"lru+tinylfu", EvictionPolicy::Type::Lru, true},
+        {"slru+tinylfu", EvictionPolicy::Type::SegmentedLru, true},
+        {"clock+tinylfu", EvictionPolicy::Type::Clock, true},
+    };
+
+    std::cout << "trace: " << trace.size() << " accesses, " << n_keys << " keys, cache " << cache_percent << "%"
+              << std::endl;
+    std::cout << std::setw(16) << "policy" << std::setw(14) << "hit ratio %" << std::setw(14) << "Mops/sec" << std::endl;
+    for (auto &policy : policies) {
+        // Cache-aside: every miss is followed by Put
+        MapBasedGlobalLockImpl storage(max_size, policy.eviction, policy.admission);
+        std::string value;
+        size_t hits = 0;
+
+        auto start = std::chrono::steady_clock::now();
+        for (auto &key : trace) {
+            if (storage.Get(key, value)) {
+                hits++;
+            } else {
+                storage.Put(key, put_value);
+            }
+        }
+        auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+        std::cout << std::setw(16) << policy.name << std::setw(14) << std::fixed << std::setprecision(2)
+                  << 100.0 * hits / trace.size() << std::setw(14) << std::setprecision(3)
+                  << trace.size() / elapsed / 1e6 << std::endl;
+    }
+}
+
+/**
+ * Time of a single successful lookup in random order, in nanoseconds
+ */
+template <typename F> static double lookup_latency(const std::vector<std::string> &keys, size_t n_ops, F &&find) {
+    uint64_t x = 0x2545F4914F6CDD1DULL;
+    size_t found = 0;
+
+    auto start = std::chrono::steady_clock::now();
+    for (size_t i = 0; i < n_ops; i++) {
+        x ^= x << 13;
+        x ^= x >> 7;
+        x ^= x << 17;
+        found += find(keys[x % keys.size()]) != nullptr;
+    }
+    auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    EXPECT_EQ(n_ops, found);
+    return elapsed * 1e9 / n_ops;
+}
+
+/**
+ * Index alone, without storage around it: node based std::unordered_map the storages used before
+ * against SwissIndex. Map is keyed by references to the lookup keys themselves, SwissIndex compares
+ * with the keys inside of the entries, so it also pays for the entry load
+ */
+TEST(StorageBenchmark, IndexLookup) {
+    std::vector<size_t> sizes = env_list("AFINA_BENCH_INDEX_KEYS", "1000000,10000000");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 2000000);
+
+    std::cout << std::setw(12) << "index" << std::setw(12) << "keys" << std::setw(14) << "ns/lookup" << std::endl;
+    for (size_t n_keys : sizes) {
+        std::vector<std::string> keys;
+        keys.reserve(n_keys);
+        LinkedList list;
+        std::vector<LinkedList::Entry *> entries;
+        entries.reserve(n_keys);
+        for (size_t i = 0; i < n_keys; i++) {
+            keys.push_back(make_key(i));
+            entries.push_back(list.Put(keys.back(), std::string()));
+        }
+
+        {
+            std::unordered_map<std::reference_wrapper<const std::string>, LinkedList::Entry *,
+                               std::hash<std::string>, std::equal_to<std::string>>
+                index;
+            for (size_t i = 0; i < n_keys; i++) {
+                index[keys[i]] = entries[i];
+            }
+
+            double ns = lookup_latency(keys, n_ops, [&index](const std::string &key) -> LinkedList::Entry * {
+                auto it = index.find(key);
+                return it != index.end() ? it->second : nullptr;
+            });
+            std::cout << std::setw(12) << "unordered" << std::setw(12) << n_keys << std::setw(14) << std::fixed
+                      << std::setprecision(1) << ns << std::endl;
+        }
+
+        {
+            SwissIndex index;
+            for (LinkedList::Entry *e : entries) {
+                index.Insert(e);
+            }
+
+            double ns = lookup_latency(keys, n_ops, [&index](const std::string &key) -> LinkedList::Entry * {
+                SwissIndex::Slot *slot = index.Find(key);
+                return slot != nullptr ? *slot : nullptr;
+            });
+            std::cout << std::setw(12) << "swiss" << std::setw(12) << n_keys << std::setw(14) << std::fixed
+                      << std::setprecision(1) << ns << std::endl;
+        }
+    }
+}
+
+/**
+ * Global lock storage with entries, value buffers and index drawing from the slab arena against the
+ * same storage on the global heap. Storage holds about half of the keys and every other operation is
+ * Put, so memory is allocated and freed all the time
+ */
+TEST(StorageBenchmark, Arena) {
+    std::vector<size_t> n_threads = env_list("AFINA_BENCH_THREADS", "1,2,4,8,16");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 200000);
+    size_t n_keys = env_size("AFINA_BENCH_KEYS", 100000);
+
+    std::vector<std::string> keys;
+    for (size_t i = 0; i < n_keys; i++) {
+        keys.push_back(make_key(i));
+    }
+
+    Afina::Allocator::Slab *process = Afina::Allocator::DefaultArena();
+    std::vector<std::pair<std::string, Afina::Allocator::Slab *>> arenas = {{"arena", process}, {"heap", nullptr}};
+
+    std::cout << std::setw(12) << "memory" << std::setw(10) << "threads" << std::setw(14) << "fill Mops"
+              << std::setw(14) << "Mops/sec" << std::endl;
+    for (auto &arena : arenas) {
+        // Nothing allocated by default constructed allocators is alive between the runs
+        Afina::Allocator::SetDefaultArena(arena.second);
+        size_t max_size = n_keys / 2 * MapBasedGlobalLockImpl::ItemSize(keys[0].size(), 32);
+        for (size_t threads : n_threads) {
+            std::unique_ptr<Afina::Storage> storage(new MapBasedGlobalLockImpl(max_size));
+
+            auto start = std::chrono::steady_clock::now();
+            for (auto &key : keys) {
+                storage->Put(key, std::string(32, 'v'));
+            }
+            auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+            double ops = run_mixed(*storage, threads, n_ops, keys, 2);
+            std::cout << std::setw(12) << arena.first << std::setw(10) << threads << std::setw(14) << std::fixed
+                      << std::setprecision(3) << n_keys / elapsed / 1e6 << std::setw(14) << ops / 1e6 << std::endl;
+        }
+    }
+    Afina::Allocator::SetDefaultArena(process);
+}
+
+// Anonymous memory backed by the transparent huge pages, 0 if kernel doesn't tell
+static size_t anon_huge_pages() {
+    std::ifstream smaps("/proc/self/smaps_rollup");
+    std::string line;
+    while (std::getline(smaps, line)) {
+        if (line.compare(0, 14, "AnonHugePages:") == 0) {
+            return std::stoul(line.substr(14)) * 1024;
+        }
+    }
+    return 0;
+}
+
+/**
+ * Random Gets over a storage much bigger than TLB covers with regular pages: each lookup touches index
+ * control bytes, the slot and the entry, all of them at random places. Storage memory comes from the
+ * arena on the regular pages and from the one on the huge pages
+ */
+TEST(StorageBenchmark, HugePages) {
+    std::vector<size_t> sizes = env_list("AFINA_BENCH_HUGE_KEYS", "1000000,4000000");
+    size_t n_ops = env_size("AFINA_BENCH_OPS", 2000000);
+
+    Afina::Allocator::Slab *process = Afina::Allocator::DefaultArena();
+    std::cout << std::setw(12) << "pages" << std::setw(12) << "keys" << std::setw(14) << "ns/lookup"
+              << std::setw(14) << "mapped MB" << std::setw(14) << "THP MB" << std::endl;
+    for (size_t n_keys : sizes) {
+        std::vector<std::string> keys;
+        keys.reserve(n_keys);
+        for (size_t i = 0; i < n_keys; i++) {
+            keys.push_back(make_key(i));
+        }
+
+        for (bool huge_pages : {false, true}) {
+            Afina::Allocator::Slab arena(0, huge_pages);
+            Afina::Allocator::SetDefaultArena(&arena);
+            size_t thp_before = anon_huge_pages();
+            {
+                MapBasedGlobalLockImpl storage(n_keys * MapBasedGlobalLockImpl::ItemSize(keys[0].size(), 64));
+                for (auto &key : keys) {
+                    storage.Put(key, std::string(64, 'v'));
+                }
+
+                std::string value;
+                double ns = lookup_latency(keys, n_ops, [&storage, &value](const std::string &key) -> const void * {
+                    return storage.Get(key, value) ? &value : nullptr;
+                });
+                size_t thp = anon_huge_pages() - std::min(thp_before, anon_huge_pages());
+                std::cout << std::setw(12) << (huge_pages ? "huge" : "regular") << std::setw(12) << n_keys
+                          << std::setw(14) << std::fixed << std::setprecision(1) << ns << std::setw(14)
+                          << (arena.mapped() >> 20) << std::setw(14) << (thp >> 20) << std::endl;
+            }
+            Afina::Allocator::SetDefaultArena(process);
+        }
+    }
+}
@@ -1,12 +1,26 @@
 #include "gtest/gtest.h"
+#include <atomic>
+#include <iomanip>
 #include <iostream>
+#include <map>
+#include <memory>
+#include <random>
 #include <set>
+#include <thread>
 #include <vector>
 
 #include <pthread.h>
 
 #include <storage/MapBasedGlobalLockImpl.h>
 #include <storage/MapBasedFlatCombineImpl.h>
+#include <storage/MapBasedShardedImpl.h>
+#include <storage/MapBasedLockFreeImpl.h>
+#include <storage/MemoryLimit.h>
+#include <storage/SwissIndex.h>
+#include <storage/EpochReclaimer.h>
+#include <storage/FlatCombiner.h>
+#include <storage/TimerWheel.h>
+#include <storage/TinyLfu.h>
 #include <afina/execute/Get.h>
 #include <afina/execute/Set.h>
 #include <afina/execute/Add.h>
@@ -20,6 +34,11 @@ using namespace std;
 // using Storage = MapBasedGlobalLockImpl;
 using Storage = MapBasedFlatCombineImpl;
 
+// Storage budget that fits exactly n items with keys and values of the given sizes
+template <typename S = Storage> static size_t budget(size_t n, size_t key_size, size_t value_size) {
+    return n * S::ItemSize(key_size, value_size);
+}
+
 TEST(StorageTest, PutGet) {
     Storage storage;
 
@@ -35,7 +54,7 @@ TEST(StorageTest, PutGet) {
 }
 
 TEST(StorageTest, PutOverwrite) {
-    Storage storage(2 * (3 + 1));
+    Storage storage(budget(2, 4, 4));
 
     storage.Put("KEY1", "val1");
     storage.Put("KEY1", "val2");
@@ -69,7 +88,7 @@ TEST(StorageTest, Delete) {
 }
 
 TEST(StorageTest, BigTest) {
-    Storage storage(2 * (3 + 6) * 100000);
+    Storage storage(budget(100000, 9, 9));
 
     std::stringstream ss;
 
@@ -102,7 +121,7 @@ TEST(StorageTest, BigTest) {
 }
 
 TEST(StorageTest, MaxTest) {
-    Storage storage(2 * (3 + 5) * 1000);
+    Storage storage(budget(1000, 8, 8));
 
     std::stringstream ss;
 
@@ -280,4 +299,1189 @@ TEST(StorageTest, MultithreadedPerformanceTest) {
     for (int i = 0; i < n_threads; ++i) {
         pthread_join(thrds[i], NULL);
     }
-}
\ No newline at end of file
+}
+TEST(ShardedStorageTest, PutGetDelete) {
+    MapBasedShardedImpl storage(1048576, 8);
+    EXPECT_EQ(8, storage.shards());
+
+    std::stringstream ss;
+    for (long i = 0; i < 1000; ++i) {
+        ss << "Key" << i;
+        EXPECT_TRUE(storage.PutIfAbsent(ss.str(), ss.str()));
+        ss.str("");
+    }
+
+    for (long i = 0; i < 1000; ++i) {
+        ss << "Key" << i;
+        std::string res;
+        EXPECT_TRUE(storage.Get(ss.str(), res));
+        EXPECT_EQ(ss.str(), res);
+        EXPECT_FALSE(storage.PutIfAbsent(ss.str(), "other"));
+        EXPECT_TRUE(storage.Set(ss.str(), "other"));
+        EXPECT_TRUE(storage.Delete(ss.str()));
+        EXPECT_FALSE(storage.Get(ss.str(), res));
+        ss.str("");
+    }
+}
+
+TEST(ShardedStorageTest, ShardsRoundedUp) {
+    MapBasedShardedImpl storage(1048576, 5);
+    EXPECT_EQ(8, storage.shards());
+}
+
+TEST(ShardedStorageTest, EvictionPerShard) {
+    // Each of 4 shards has room for a single item only
+    MapBasedShardedImpl storage(4 * (budget<MapBasedGlobalLockImpl>(1, 5, 3) + 2), 4);
+
+    std::stringstream ss;
+    for (long i = 0; i < 100; ++i) {
+        ss << "Key" << std::setw(2) << std::setfill('0') << i;
+        storage.Put(ss.str(), "val");
+        ss.str("");
+    }
+
+    size_t found = 0;
+    for (long i = 0; i < 100; ++i) {
+        ss << "Key" << std::setw(2) << std::setfill('0') << i;
+        std::string res;
+        found += storage.Get(ss.str(), res);
+        ss.str("");
+    }
+    EXPECT_GE(4, found);
+    EXPECT_LT(0, found);
+
+    std::string res;
+    EXPECT_TRUE(storage.Get("Key99", res));
+}
+
+struct CounterOp {
+    long delta;
+};
+
+// Runs n_threads threads, each of them applying n_ops increments through the combiner, threads
+// are spawned in waves so that slots of the exited threads have to be reclaimed
+static long run_counter(FlatCombiner<CounterOp> &fc, long &counter, size_t n_threads, size_t n_waves, long n_ops) {
+    for (size_t wave = 0; wave < n_waves; wave++) {
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < n_threads; t++) {
+            threads.emplace_back([&]() {
+                auto slot = fc.get_slot();
+                for (long i = 0; i < n_ops; i++) {
+                    slot->user_op.delta = 1;
+                    fc.apply_slot(*slot);
+                }
+            });
+        }
+
+        for (auto &t : threads) {
+            t.join();
+        }
+    }
+    return counter;
+}
+
+TEST(FlatCombinerTest, CombineAll) {
+    long counter = 0;
+    FlatCombiner<CounterOp> fc([&counter](FlatCombiner<CounterOp>::Slot **start, FlatCombiner<CounterOp>::Slot **end) {
+        for (auto p = start; p != end; p++) {
+            counter += (*p)->user_op.delta;
+        }
+    });
+
+    EXPECT_EQ(4 * 3 * 10000, run_counter(fc, counter, 4, 3, 10000));
+
+    auto stats = fc.stats();
+    EXPECT_EQ(4 * 3 * 10000, stats.operations);
+    EXPECT_LE(stats.passes, stats.operations);
+    EXPECT_LE(1, stats.max_pass);
+    EXPECT_GE(64, stats.max_pass);
+}
+
+TEST(FlatCombinerTest, ParkAndHandoff) {
+    // Never spin, so that waiting threads are parked right away
+    FlatCombiner<CounterOp>::Options options;
+    options.max_call_size = 2;
+    options.cleanup_horizon = 1;
+    options.spin_iterations = 0;
+    options.yield_iterations = 0;
+
+    long counter = 0;
+    FlatCombiner<CounterOp> fc(
+        [&counter](FlatCombiner<CounterOp>::Slot **start, FlatCombiner<CounterOp>::Slot **end) {
+            for (auto p = start; p != end; p++) {
+                counter += (*p)->user_op.delta;
+            }
+        },
+        options);
+
+    EXPECT_EQ(8 * 2 * 5000, run_counter(fc, counter, 8, 2, 5000));
+
+    auto stats = fc.stats();
+    EXPECT_EQ(8 * 2 * 5000, stats.operations);
+    EXPECT_GE(2, stats.max_pass);
+    EXPECT_GE(stats.parks, stats.handoffs);
+}
+
+TEST(FlatCombinerTest, DetachAndReattach) {
+    long counter = 0;
+    FlatCombiner<CounterOp> fc([&counter](FlatCombiner<CounterOp>::Slot **start, FlatCombiner<CounterOp>::Slot **end) {
+        for (auto p = start; p != end; p++) {
+            counter += (*p)->user_op.delta;
+        }
+    });
+
+    for (int i = 0; i < 100; i++) {
+        auto slot = fc.get_slot();
+        slot->user_op.delta = 2;
+        fc.apply_slot(*slot);
+        fc.detach();
+    }
+    EXPECT_EQ(200, counter);
+
+    // Slot is still owned by thread that outlives combiner, it must be released with combiner
+    auto slot = fc.get_slot();
+    slot->user_op.delta = 1;
+    fc.apply_slot(*slot);
+    EXPECT_EQ(201, counter);
+}
+
+TEST(FlatCombineStorageTest, Stats) {
+    MapBasedFlatCombineImpl storage;
+    storage.Put("KEY1", "val1");
+    storage.Put("KEY2", "val2");
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("KEY1", value));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+
+    std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ("3", stats_map["fc_operations"]);
+    EXPECT_EQ("3", stats_map["fc_passes"]);
+    EXPECT_EQ("1", stats_map["fc_max_pass"]);
+}
+
+TEST(FlatCombineStorageTest, ReadersSeeWholeValues) {
+    // Values are big enough so that copy of the torn value would be caught
+    MapBasedFlatCombineImpl storage(100 * 1024 * 1024);
+    for (int k = 0; k < 4; k++) {
+        storage.Put("KEY" + std::to_string(k), std::string(16 * 1024, 'a'));
+    }
+
+    std::atomic<bool> torn(false);
+    std::vector<std::thread> threads;
+    for (int t = 0; t < 8; t++) {
+        threads.emplace_back([&storage, &torn, t]() {
+            std::string value;
+            for (int i = 0; i < 2000; i++) {
+                std::string key = "KEY" + std::to_string(i % 4);
+                if ((t == 0) && (i % 10 == 0)) {
+                    storage.Set(key, std::string(16 * 1024, 'a' + (i / 10) % 26));
+                } else if ((t == 1) && (i % 50 == 0)) {
+                    storage.Delete(key);
+                    storage.Put(key, std::string(16 * 1024, 'z'));
+                } else if (storage.Get(key, value)) {
+                    if ((value.size() != 16 * 1024) || (value.find_first_not_of(value[0]) != std::string::npos)) {
+                        torn = true;
+                    }
+                }
+            }
+        });
+    }
+
+    for (auto &t : threads) {
+        t.join();
+    }
+    EXPECT_FALSE(torn.load());
+}
+
+TEST(TimerWheelTest, FiresOnTime) {
+    const time_t start = 1000000;
+    TimerWheel wheel(start);
+
+    // Cover every level of the wheel and an overflow
+    std::vector<time_t> deltas = {0, 1, 63, 64, 65, 4095, 4096, 5000, 262143, 262144, 300000, 20000000};
+    std::vector<std::unique_ptr<LinkedList::Entry>> entries;
+    for (time_t delta : deltas) {
+        entries.emplace_back(LinkedList::Entry::Create("key", "value", Afina::Metadata(0, start + delta)));
+        wheel.Schedule(entries.back().get());
+    }
+
+    std::unique_ptr<LinkedList::Entry> never(LinkedList::Entry::Create("key", "value", Afina::Metadata()));
+    wheel.Schedule(never.get());
+    EXPECT_EQ(deltas.size(), wheel.size());
+
+    std::map<LinkedList::Entry *, time_t> fired;
+    time_t now = start;
+    auto callback = [&](LinkedList::Entry *e) {
+        EXPECT_EQ(0, fired.count(e));
+        fired[e] = now;
+    };
+
+    // Step over the interesting times exactly to see that no entry fires early
+    for (now = start; now <= start + 300001; now++) {
+        EXPECT_TRUE(wheel.Advance(now, callback));
+    }
+    EXPECT_EQ(deltas.size() - 1, fired.size());
+    for (size_t i = 0; i + 1 < deltas.size(); i++) {
+        EXPECT_EQ(start + deltas[i], fired[entries[i].get()]);
+    }
+
+    // Overflowing entry is clamped to the wheel range and then rescheduled
+    now = start + 20000000;
+    EXPECT_TRUE(wheel.Advance(now, callback));
+    EXPECT_EQ(start + 20000000, fired[entries.back().get()]);
+    EXPECT_EQ(0, wheel.size());
+}
+
+TEST(TimerWheelTest, RescheduleAndRemove) {
+    const time_t start = 5000;
+    TimerWheel wheel(start);
+
+    std::unique_ptr<LinkedList::Entry> a(LinkedList::Entry::Create("a", "value", Afina::Metadata(0, start + 10)));
+    std::unique_ptr<LinkedList::Entry> b(LinkedList::Entry::Create("b", "value", Afina::Metadata(0, start + 10)));
+    wheel.Schedule(a.get());
+    wheel.Schedule(b.get());
+
+    a->meta.expire = start + 100;
+    wheel.Schedule(a.get());
+    wheel.Remove(b.get());
+    EXPECT_EQ(1, wheel.size());
+
+    std::vector<LinkedList::Entry *> fired;
+    auto callback = [&](LinkedList::Entry *e) { fired.push_back(e); };
+
+    // Limited advance stops half way
+    EXPECT_FALSE(wheel.Advance(start + 99, callback, 50));
+    EXPECT_TRUE(wheel.Advance(start + 99, callback));
+    EXPECT_TRUE(fired.empty());
+
+    EXPECT_TRUE(wheel.Advance(start + 100, callback));
+    ASSERT_EQ(1, fired.size());
+    EXPECT_EQ(a.get(), fired[0]);
+}
+
+template <typename S> static void check_ttl(S &storage) {
+    time_t now = time(nullptr);
+    std::string res;
+
+    EXPECT_TRUE(storage.Put("expired", "value", Afina::Metadata(0, now - 1)));
+    EXPECT_FALSE(storage.Get("expired", res));
+    EXPECT_FALSE(storage.Set("expired", "other", Afina::Metadata(0, now + 100)));
+    EXPECT_TRUE(storage.PutIfAbsent("expired", "again", Afina::Metadata(0, now + 100)));
+    EXPECT_TRUE(storage.Get("expired", res));
+    EXPECT_EQ("again", res);
+
+    EXPECT_TRUE(storage.Put("alive", "value", Afina::Metadata(0, now + 100)));
+    EXPECT_TRUE(storage.Put("forever", "value"));
+    EXPECT_TRUE(storage.Get("alive", res));
+    EXPECT_EQ("value", res);
+
+    // Set keeps item alive for the new period
+    EXPECT_TRUE(storage.Set("alive", "other", Afina::Metadata(0, now + 300)));
+
+    storage.Expire(now + 200);
+    EXPECT_FALSE(storage.Get("expired", res));
+    EXPECT_TRUE(storage.Get("alive", res));
+    EXPECT_EQ("other", res);
+    EXPECT_TRUE(storage.Get("forever", res));
+
+    storage.Expire(now + 300);
+    EXPECT_FALSE(storage.Get("alive", res));
+    EXPECT_FALSE(storage.Delete("alive"));
+    EXPECT_TRUE(storage.Get("forever", res));
+}
+
+TEST(StorageTest, Expire) {
+    MapBasedGlobalLockImpl storage;
+    check_ttl(storage);
+}
+
+TEST(FlatCombineStorageTest, Expire) {
+    MapBasedFlatCombineImpl storage;
+    check_ttl(storage);
+}
+
+TEST(ShardedStorageTest, Expire) {
+    MapBasedShardedImpl storage(1048576, 4);
+    check_ttl(storage);
+}
+
+template <typename S> static void check_metadata(S &storage) {
+    Afina::Value value;
+    Afina::Metadata meta;
+
+    EXPECT_TRUE(storage.Put("plain", "value"));
+    EXPECT_TRUE(storage.Get("plain", value, meta));
+    EXPECT_EQ(0, meta.flags);
+    EXPECT_EQ(0, meta.expire);
+
+    time_t expire = time(nullptr) + 100;
+    EXPECT_TRUE(storage.Put("flagged", "value", Afina::Metadata(0xDEADBEEF, expire)));
+    EXPECT_TRUE(storage.Get("flagged", value, meta));
+    EXPECT_EQ("value", value.str());
+    EXPECT_EQ(0xDEADBEEF, meta.flags);
+    EXPECT_EQ(expire, meta.expire);
+
+    // Flags are replaced along with the value
+    EXPECT_TRUE(storage.Set("flagged", "other", Afina::Metadata(42, 0)));
+    EXPECT_TRUE(storage.Get("flagged", value, meta));
+    EXPECT_EQ("other", value.str());
+    EXPECT_EQ(42, meta.flags);
+    EXPECT_EQ(0, meta.expire);
+
+    EXPECT_TRUE(storage.PutIfAbsent("added", "value", Afina::Metadata(7, 0)));
+    EXPECT_TRUE(storage.Get("added", value, meta));
+    EXPECT_EQ(7, meta.flags);
+}
+
+TEST(StorageTest, Metadata) {
+    MapBasedGlobalLockImpl storage;
+    check_metadata(storage);
+}
+
+TEST(FlatCombineStorageTest, Metadata) {
+    MapBasedFlatCombineImpl storage;
+    check_metadata(storage);
+}
+
+TEST(ShardedStorageTest, Metadata) {
+    MapBasedShardedImpl storage(1048576, 4);
+    check_metadata(storage);
+}
+
+template <typename S> static void check_cas(S &storage) {
+    Afina::Value value;
+    Afina::Metadata meta;
+
+    EXPECT_EQ(Afina::Storage::CasResult::NotFound, storage.CompareAndSwap("key", "value", Afina::Metadata(), 1));
+
+    EXPECT_TRUE(storage.Put("key", "value"));
+    EXPECT_TRUE(storage.Get("key", value, meta));
+    uint64_t version = meta.cas;
+
+    // Every write changes version
+    EXPECT_TRUE(storage.Set("key", "other"));
+    EXPECT_TRUE(storage.Get("key", value, meta));
+    EXPECT_NE(version, meta.cas);
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSwap("key", "stale", Afina::Metadata(), version));
+    version = meta.cas;
+
+    EXPECT_EQ(Afina::Storage::CasResult::Stored,
+              storage.CompareAndSwap("key", "swapped", Afina::Metadata(3, 0), version));
+    EXPECT_TRUE(storage.Get("key", value, meta));
+    EXPECT_EQ("swapped", value.str());
+    EXPECT_EQ(3, meta.flags);
+    EXPECT_NE(version, meta.cas);
+
+    // Same version can't be used twice
+    EXPECT_EQ(Afina::Storage::CasResult::Exists, storage.CompareAndSwap("key", "again", Afina::Metadata(), version));
+
+    EXPECT_TRUE(storage.Delete("key"));
+    EXPECT_EQ(Afina::Storage::CasResult::NotFound, storage.CompareAndSwap("key", "value", Afina::Metadata(), meta.cas));
+}
+
+TEST(StorageTest, CompareAndSwap) {
+    MapBasedGlobalLockImpl storage;
+    check_cas(storage);
+}
+
+TEST(FlatCombineStorageTest, CompareAndSwap) {
+    MapBasedFlatCombineImpl storage;
+    check_cas(storage);
+}
+
+TEST(ShardedStorageTest, CompareAndSwap) {
+    MapBasedShardedImpl storage(1048576, 4);
+    check_cas(storage);
+}
+
+TEST(FlatCombineStorageTest, ConcurrentCompareAndSwap) {
+    // Each thread increments counter using read-modify-write cycles, no update may get lost
+    MapBasedFlatCombineImpl storage;
+    storage.Put("counter", "0");
+
+    const int n_threads = 4;
+    const int n_increments = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&storage]() {
+            Afina::Value value;
+            Afina::Metadata meta;
+            for (int i = 0; i < n_increments;) {
+                ASSERT_TRUE(storage.Get("counter", value, meta));
+                std::string next = std::to_string(std::stoi(value.str()) + 1);
+                if (storage.CompareAndSwap("counter", next, meta, meta.cas) == Afina::Storage::CasResult::Stored) {
+                    i++;
+                }
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    std::string res;
+    EXPECT_TRUE(storage.Get("counter", res));
+    EXPECT_EQ(std::to_string(n_threads * n_increments), res);
+}
+
+template <typename S> static void check_mutations(S &storage) {
+    std::string res;
+    uint64_t number = 0;
+
+    EXPECT_FALSE(storage.Append("text", "tail"));
+    EXPECT_FALSE(storage.Prepend("text", "head"));
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::NotFound, storage.Increment("number", 1, number));
+
+    time_t expire = time(nullptr) + 100;
+    EXPECT_TRUE(storage.Put("text", "body", Afina::Metadata(5, expire)));
+    EXPECT_TRUE(storage.Append("text", "tail"));
+    EXPECT_TRUE(storage.Prepend("text", "head"));
+    EXPECT_TRUE(storage.Get("text", res));
+    EXPECT_EQ("headbodytail", res);
+
+    // Mutations keep flags and expiration time but change version
+    Afina::Value value;
+    Afina::Metadata meta;
+    EXPECT_TRUE(storage.Get("text", value, meta));
+    EXPECT_EQ(5, meta.flags);
+    EXPECT_EQ(expire, meta.expire);
+    uint64_t version = meta.cas;
+    EXPECT_TRUE(storage.Append("text", "!"));
+    EXPECT_TRUE(storage.Get("text", value, meta));
+    EXPECT_NE(version, meta.cas);
+
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::NonNumeric, storage.Increment("text", 1, number));
+
+    EXPECT_TRUE(storage.Put("number", "9"));
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::Stored, storage.Increment("number", 1, number));
+    EXPECT_EQ(10, number);
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::Stored, storage.Decrement("number", 3, number));
+    EXPECT_EQ(7, number);
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::Stored, storage.Decrement("number", 100, number));
+    EXPECT_EQ(0, number);
+    EXPECT_TRUE(storage.Get("number", res));
+    EXPECT_EQ("0", res);
+
+    EXPECT_TRUE(storage.Put("number", "18446744073709551615"));
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::Stored, storage.Increment("number", 2, number));
+    EXPECT_EQ(1, number);
+
+    EXPECT_TRUE(storage.Put("number", "18446744073709551616"));
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::NonNumeric, storage.Increment("number", 1, number));
+}
+
+TEST(StorageTest, Mutations) {
+    MapBasedGlobalLockImpl storage;
+    check_mutations(storage);
+}
+
+TEST(FlatCombineStorageTest, Mutations) {
+    MapBasedFlatCombineImpl storage;
+    check_mutations(storage);
+}
+
+TEST(ShardedStorageTest, Mutations) {
+    MapBasedShardedImpl storage(1048576, 4);
+    check_mutations(storage);
+}
+
+TEST(StorageTest, AppendInPlace) {
+    MapBasedGlobalLockImpl storage;
+    std::string big(LinkedList::Entry::SMALL_VALUE + 1, 'v');
+    EXPECT_TRUE(storage.Put("key", big));
+
+    // Handle keeps old bytes unchanged, so value gets copied
+    Afina::Value before;
+    EXPECT_TRUE(storage.Get("key", before));
+    EXPECT_TRUE(storage.Append("key", "1"));
+    EXPECT_EQ(big, before.str());
+
+    Afina::Value after;
+    EXPECT_TRUE(storage.Get("key", after));
+    EXPECT_NE(before.data(), after.data());
+    EXPECT_EQ(big + "1", after.str());
+
+    // Nobody refers to the value, so it grows in place. Copy above has no spare room, the first
+    // append gets some
+    after.reset();
+    before.reset();
+    EXPECT_TRUE(storage.Append("key", "2"));
+    EXPECT_TRUE(storage.Get("key", after));
+    const char *data = after.data();
+    after.reset();
+    EXPECT_TRUE(storage.Append("key", "3"));
+    EXPECT_TRUE(storage.Get("key", after));
+    EXPECT_EQ(data, after.data());
+    EXPECT_EQ(big + "123", after.str());
+}
+
+TEST(StorageTest, SmallValuesInline) {
+    MapBasedGlobalLockImpl storage;
+    EXPECT_TRUE(storage.Put("key", "value"));
+
+    // Small value is copied out, handle doesn't see later changes
+    Afina::Value before;
+    EXPECT_TRUE(storage.Get("key", before));
+    EXPECT_TRUE(storage.Append("key", "1"));
+    EXPECT_TRUE(storage.Prepend("key", "0"));
+    EXPECT_EQ("value", before.str());
+
+    std::string value;
+    EXPECT_TRUE(storage.Get("key", value));
+    EXPECT_EQ("0value1", value);
+
+    // Value outgrows the inline space and moves out into a buffer, then comes back
+    std::string big(LinkedList::Entry::SMALL_VALUE + 1, 'v');
+    EXPECT_TRUE(storage.Append("key", big));
+    EXPECT_TRUE(storage.Get("key", value));
+    EXPECT_EQ("0value1" + big, value);
+    EXPECT_TRUE(storage.Set("key", "42"));
+    uint64_t result;
+    EXPECT_EQ(Afina::Storage::ArithmeticResult::Stored, storage.Increment("key", 1, result));
+    EXPECT_TRUE(storage.Get("key", value));
+    EXPECT_EQ("43", value);
+}
+
+TEST(StorageTest, EntryFootprint) {
+    // Header, key and small value take a single allocation
+    std::unique_ptr<LinkedList::Entry> small(LinkedList::Entry::Create(std::string(20, 'k'), std::string(100, 'v'),
+                                                                       Afina::Metadata()));
+    EXPECT_EQ(LinkedList::Entry::Footprint(20, 100), small->size());
+    EXPECT_GE(small->size(), sizeof(LinkedList::Entry) + 120);
+    EXPECT_LT(small->size(), sizeof(LinkedList::Entry) + 120 + 48);
+    EXPECT_EQ(std::string(20, 'k'), small->key());
+    EXPECT_EQ(std::string(100, 'v'), std::string(small->value_data(), small->value_size()));
+    EXPECT_TRUE(small->small());
+
+    // Big value costs its buffer too
+    std::string big(4096, 'v');
+    std::unique_ptr<LinkedList::Entry> large(LinkedList::Entry::Create("key", big, Afina::Metadata()));
+    EXPECT_FALSE(large->small());
+    EXPECT_EQ(LinkedList::Entry::Footprint(3, big.size()), large->size());
+    EXPECT_GT(large->size(), big.size() + sizeof(LinkedList::Entry));
+
+    // Shrunk value that fits into the value area goes back inline
+    large->set_value("v");
+    EXPECT_TRUE(large->small());
+    EXPECT_EQ("v", std::string(large->value_data(), large->value_size()));
+}
+
+TEST(FlatCombineStorageTest, ConcurrentMutations) {
+    MapBasedFlatCombineImpl storage;
+    storage.Put("counter", "0");
+    storage.Put("log", "");
+
+    const int n_threads = 4;
+    const int n_ops = 2000;
+    std::vector<std::thread> threads;
+    for (int t = 0; t < n_threads; t++) {
+        threads.emplace_back([&storage]() {
+            uint64_t number;
+            for (int i = 0; i < n_ops; i++) {
+                storage.Increment("counter", 1, number);
+                storage.Append("log", "x");
+            }
+        });
+    }
+    for (auto &t : threads) {
+        t.join();
+    }
+
+    std::string res;
+    EXPECT_TRUE(storage.Get("counter", res));
+    EXPECT_EQ(std::to_string(n_threads * n_ops), res);
+    EXPECT_TRUE(storage.Get("log", res));
+    EXPECT_EQ(n_threads * n_ops, res.size());
+}
+
+static std::string fill_key(const char *prefix, int i) {
+    std::stringstream ss;
+    ss << prefix << std::setw(3) << std::setfill('0') << i;
+    return ss.str();
+}
+
+// Hot keys are read twice, then cold keys are put once each. Returns number of hot keys survived
+static int scan_survivors(EvictionPolicy::Type eviction) {
+    // Storage fits 20 entries
+    MapBasedGlobalLockImpl storage(budget<MapBasedGlobalLockImpl>(20, 4, 1), eviction);
+
+    std::string res;
+    for (int i = 0; i < 10; i++) {
+        storage.Put(fill_key("H", i), "v");
+    }
+    for (int i = 0; i < 10; i++) {
+        storage.Get(fill_key("H", i), res);
+    }
+    for (int i = 0; i < 100; i++) {
+        storage.Put(fill_key("C", i), "v");
+    }
+
+    int survived = 0;
+    for (int i = 0; i < 10; i++) {
+        survived += storage.Get(fill_key("H", i), res);
+    }
+    return survived;
+}
+
+TEST(EvictionPolicyTest, SegmentedLruResistsScan) {
+    EXPECT_EQ(0, scan_survivors(EvictionPolicy::Type::Lru));
+    EXPECT_EQ(10, scan_survivors(EvictionPolicy::Type::SegmentedLru));
+}
+
+TEST(EvictionPolicyTest, ClockSecondChance) {
+    // Storage fits 3 entries
+    MapBasedGlobalLockImpl storage(budget<MapBasedGlobalLockImpl>(3, 1, 1), EvictionPolicy::Type::Clock);
+    std::string res;
+
+    storage.Put("a", "1");
+    storage.Put("b", "1");
+    storage.Put("c", "1");
+    EXPECT_TRUE(storage.Get("a", res));
+
+    // Referenced "a" gets second chance, "b" goes away
+    storage.Put("d", "1");
+    EXPECT_TRUE(storage.Get("a", res));
+    EXPECT_FALSE(storage.Get("b", res));
+
+    // Hand keeps going from where it stopped
+    storage.Put("e", "1");
+    EXPECT_FALSE(storage.Get("c", res));
+    EXPECT_TRUE(storage.Get("d", res));
+    EXPECT_TRUE(storage.Get("e", res));
+}
+
+TEST(EvictionPolicyTest, SlabLruPerClass) {
+    // Storage fits 20 small entries and 2 big ones
+    size_t max_size =
+        budget<MapBasedGlobalLockImpl>(20, 4, 4) + budget<MapBasedGlobalLockImpl>(2, 4, 1000);
+    MapBasedGlobalLockImpl storage(max_size, EvictionPolicy::Type::SlabLru);
+    std::string res;
+
+    for (int i = 0; i < 20; i++) {
+        storage.Put(fill_key("S", i), "vvvv");
+    }
+    for (int i = 0; i < 3; i++) {
+        storage.Put(fill_key("B", i), std::string(1000, 'b'));
+    }
+
+    // Big entry evicts the oldest big one, not the oldest entry overall
+    EXPECT_FALSE(storage.Get("B000", res));
+    EXPECT_TRUE(storage.Get("B001", res));
+    EXPECT_TRUE(storage.Get("B002", res));
+    for (int i = 0; i < 20; i++) {
+        EXPECT_TRUE(storage.Get(fill_key("S", i), res));
+    }
+}
+
+// Storage is filled with small entries, then only big ones are put, so they keep evicting each other
+// while small ones hold the memory. Rebalance must give some of it to the big ones
+template <typename S> static void check_rebalance(S &storage) {
+    std::string small(100, 's'), big(1000, 'b');
+    const int n_small = 40000;
+    for (int i = 0; i < n_small; i++) {
+        storage.Put("S" + std::to_string(i), small);
+    }
+
+    int n_big = 0;
+    for (time_t now = 1000; now < 1060; now++) {
+        for (int i = 0; i < 50; i++) {
+            storage.Put("B" + std::to_string(n_big++), big);
+        }
+        storage.Rebalance(now);
+    }
+
+    // Without rebalance only the last couple of big entries would be there
+    std::string res;
+    int small_left = 0, big_left = 0;
+    for (int i = 0; i < n_small; i++) {
+        small_left += storage.Get("S" + std::to_string(i), res);
+    }
+    for (int i = 0; i < n_big; i++) {
+        big_left += storage.Get("B" + std::to_string(i), res);
+    }
+    EXPECT_GT(small_left, 0);
+    EXPECT_GT(big_left, 100);
+}
+
+TEST(EvictionPolicyTest, SlabRebalance) {
+    MapBasedGlobalLockImpl global(4 << 20, EvictionPolicy::Type::SlabLru);
+    check_rebalance(global);
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    global.Stats(stats);
+    std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ("1", stats_map["slab_lru_pages_moved"]);
+
+    MapBasedFlatCombineImpl fc(4 << 20, MapBasedFlatCombineImpl::Options(), EvictionPolicy::Type::SlabLru);
+    check_rebalance(fc);
+
+    MapBasedLockFreeImpl lock_free(4 << 20, EvictionPolicy::Type::SlabLru);
+    check_rebalance(lock_free);
+}
+
+TEST(EvictionPolicyTest, ParseType) {
+    EXPECT_EQ(EvictionPolicy::Type::Lru, EvictionPolicy::ParseType("lru"));
+    EXPECT_EQ(EvictionPolicy::Type::SegmentedLru, EvictionPolicy::ParseType("slru"));
+    EXPECT_EQ(EvictionPolicy::Type::Clock, EvictionPolicy::ParseType("clock"));
+    EXPECT_EQ(EvictionPolicy::Type::SlabLru, EvictionPolicy::ParseType("slab"));
+    EXPECT_THROW(EvictionPolicy::ParseType("random"), std::invalid_argument);
+}
+
+TEST(EvictionPolicyTest, AllOperations) {
+    for (auto eviction :
+         {EvictionPolicy::Type::SegmentedLru, EvictionPolicy::Type::Clock, EvictionPolicy::Type::SlabLru}) {
+        MapBasedGlobalLockImpl global(1048576, eviction);
+        check_ttl(global);
+        check_mutations(global);
+        check_cas(global);
+
+        MapBasedFlatCombineImpl fc(1048576, MapBasedFlatCombineImpl::Options(), eviction);
+        check_ttl(fc);
+        check_mutations(fc);
+        check_cas(fc);
+
+        std::vector<std::pair<std::string, std::string>> stats;
+        fc.Stats(stats);
+        std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+        EXPECT_EQ(EvictionPolicy::Create(eviction)->Name(), stats_map["eviction_policy"]);
+    }
+}
+
+TEST(TinyLfuTest, FrequencySketch) {
+    FrequencySketch sketch(1024, 100);
+    std::hash<std::string> hash;
+
+    for (int i = 0; i < 5; i++) {
+        sketch.Increment(hash("hot"));
+    }
+    sketch.Increment(hash("warm"));
+    EXPECT_EQ(5, sketch.Frequency(hash("hot")));
+    EXPECT_EQ(1, sketch.Frequency(hash("warm")));
+    EXPECT_EQ(0, sketch.Frequency(hash("cold")));
+
+    // Counters saturate instead of overflowing
+    for (int i = 0; i < 20; i++) {
+        sketch.Increment(hash("hot"));
+    }
+    EXPECT_EQ(FrequencySketch::MAX_FREQUENCY, sketch.Frequency(hash("hot")));
+
+    // Sample is exhausted: history fades away
+    for (int i = 0; sketch.agings() == 0; i++) {
+        sketch.Increment(hash(fill_key("K", i)));
+    }
+    EXPECT_EQ(FrequencySketch::MAX_FREQUENCY / 2, sketch.Frequency(hash("hot")));
+    EXPECT_EQ(0, sketch.Frequency(hash("warm")));
+}
+
+template <typename S> static void check_admission(S &storage) {
+    std::string res;
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Put(fill_key("H", i), "v"));
+    }
+    for (int i = 0; i < 10; i++) {
+        storage.Get(fill_key("H", i), res);
+    }
+
+    // Once storage is full keys seen once lose to the hot ones
+    int stored = 0;
+    for (int i = 0; i < 100; i++) {
+        stored += storage.Put(fill_key("C", i), "v");
+    }
+    EXPECT_EQ(10, stored);
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Get(fill_key("H", i), res));
+    }
+
+    // Key that keeps coming back gets in eventually
+    for (int i = 0; i < 5; i++) {
+        storage.Get("C099", res);
+    }
+    EXPECT_TRUE(storage.Put("C099", "v"));
+    EXPECT_TRUE(storage.Get("C099", res));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+    std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ("tinylfu", stats_map["admission"]);
+    EXPECT_EQ("90", stats_map["admission_rejected"]);
+    EXPECT_EQ("1", stats_map["admission_admitted"]);
+}
+
+TEST(TinyLfuTest, GlobalLockAdmission) {
+    // Storage fits 20 entries
+    MapBasedGlobalLockImpl storage(budget<MapBasedGlobalLockImpl>(20, 4, 1), EvictionPolicy::Type::Lru, true);
+    check_admission(storage);
+}
+
+TEST(TinyLfuTest, FlatCombineAdmission) {
+    MapBasedFlatCombineImpl storage(budget(20, 4, 1), MapBasedFlatCombineImpl::Options(), EvictionPolicy::Type::Lru,
+                                    true);
+    check_admission(storage);
+}
+
+TEST(TinyLfuTest, AllOperations) {
+    MapBasedGlobalLockImpl global(1048576, EvictionPolicy::Type::Lru, true);
+    check_ttl(global);
+    check_mutations(global);
+    check_cas(global);
+
+    MapBasedShardedImpl sharded(1048576, 4, EvictionPolicy::Type::Lru, true);
+    check_ttl(sharded);
+    check_mutations(sharded);
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    sharded.Stats(stats);
+    std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ("tinylfu", stats_map["admission"]);
+    EXPECT_EQ("0", stats_map["admission_rejected"]);
+}
+
+TEST(EpochReclaimerTest, WaitsForReaders) {
+    EpochReclaimer reclaimer;
+    static int freed;
+    freed = 0;
+    auto deleter = [](void *p) {
+        freed++;
+        delete static_cast<int *>(p);
+    };
+
+    std::atomic<int> stage(0);
+    std::thread reader([&]() {
+        EpochReclaimer::Guard guard(reclaimer);
+        stage = 1;
+        while (stage.load() != 2) {
+            std::this_thread::yield();
+        }
+    });
+    while (stage.load() != 1) {
+        std::this_thread::yield();
+    }
+
+    // Reader pinned the epoch before retirement, object could still be in use
+    reclaimer.Retire(new int(1), deleter);
+    EXPECT_EQ(0, reclaimer.Reclaim());
+    {
+        // Guards taken after retirement don't hold it back
+        EpochReclaimer::Guard outer(reclaimer);
+        EpochReclaimer::Guard nested(reclaimer);
+        stage = 2;
+        reader.join();
+        EXPECT_EQ(1, reclaimer.Reclaim());
+    }
+    EXPECT_EQ(1, freed);
+
+    // Leftovers are freed along with the reclaimer
+    reclaimer.Retire(new int(2), deleter);
+    EXPECT_EQ(1, reclaimer.pending());
+}
+
+TEST(LockFreeStorageTest, PutGetDelete) {
+    MapBasedLockFreeImpl storage;
+
+    // Enough keys and deletes to grow index and to rebuild it after tombstones
+    std::string res;
+    for (int round = 0; round < 3; round++) {
+        for (int i = 0; i < 1000; i++) {
+            std::string key = "Key" + std::to_string(i);
+            EXPECT_TRUE(storage.PutIfAbsent(key, key));
+        }
+        for (int i = 0; i < 1000; i++) {
+            std::string key = "Key" + std::to_string(i);
+            EXPECT_TRUE(storage.Get(key, res));
+            EXPECT_EQ(key, res);
+            EXPECT_FALSE(storage.PutIfAbsent(key, "other"));
+            EXPECT_TRUE(storage.Set(key, "other"));
+            EXPECT_TRUE(storage.Get(key, res));
+            EXPECT_EQ("other", res);
+            EXPECT_TRUE(storage.Delete(key));
+            EXPECT_FALSE(storage.Get(key, res));
+        }
+    }
+}
+
+TEST(LockFreeStorageTest, DeferredLru) {
+    // Storage fits 3 entries
+    MapBasedLockFreeImpl storage(budget<MapBasedLockFreeImpl>(3, 1, 1));
+    std::string res;
+
+    storage.Put("a", "1");
+    storage.Put("b", "1");
+    storage.Put("c", "1");
+
+    // Read is only recorded, but it reaches the policy before the victim is picked
+    EXPECT_TRUE(storage.Get("a", res));
+    storage.Put("d", "1");
+    EXPECT_TRUE(storage.Get("a", res));
+    EXPECT_FALSE(storage.Get("b", res));
+    EXPECT_TRUE(storage.Get("c", res));
+    EXPECT_TRUE(storage.Get("d", res));
+}
+
+TEST(LockFreeStorageTest, AllOperations) {
+    MapBasedLockFreeImpl ttl;
+    check_ttl(ttl);
+
+    MapBasedLockFreeImpl metadata;
+    check_metadata(metadata);
+
+    MapBasedLockFreeImpl cas;
+    check_cas(cas);
+
+    MapBasedLockFreeImpl mutations;
+    check_mutations(mutations);
+}
+
+TEST(LockFreeStorageTest, ReadersDuringChurn) {
+    // Small storage keeps evicting, so entries are retired and freed while being read
+    MapBasedLockFreeImpl storage(64 * 1024, EvictionPolicy::Type::Clock);
+
+    std::atomic<bool> stop(false);
+    std::atomic<bool> torn(false);
+    std::vector<std::thread> readers;
+    for (int t = 0; t < 4; t++) {
+        readers.emplace_back([&storage, &stop, &torn]() {
+            std::string value;
+            for (int i = 0; !stop.load(); i++) {
+                if (storage.Get("Key" + std::to_string(i % 512), value) &&
+                    ((value.size() != 256) || (value.find_first_not_of(value[0]) != std::string::npos))) {
+                    torn = true;
+                }
+            }
+        });
+    }
+
+    for (int i = 0; i < 100000; i++) {
+        std::string key = "Key" + std::to_string(i % 512);
+        if (i % 7 == 0) {
+            storage.Delete(key);
+        } else {
+            storage.Put(key, std::string(256, 'a' + i % 26));
+        }
+    }
+    stop = true;
+    for (auto &t : readers) {
+        t.join();
+    }
+    EXPECT_FALSE(torn.load());
+
+    // Writers reclaim in batches of 64, once readers are gone the next batch frees everything retired
+    std::map<std::string, std::string> stats_map;
+    for (int i = 0; i < 64 && stats_map["retired_entries"] != "0"; i++) {
+        storage.Put("Key0", "value" + std::to_string(i));
+        std::vector<std::pair<std::string, std::string>> stats;
+        storage.Stats(stats);
+        stats_map = std::map<std::string, std::string>(stats.begin(), stats.end());
+    }
+    EXPECT_EQ("clock", stats_map["eviction_policy"]);
+    EXPECT_EQ("0", stats_map["retired_entries"]);
+}
+
+TEST(StorageTest, HeapMemory) {
+    // Storage built while there is no default arena takes everything from the heap
+    Afina::Allocator::Slab *process = Afina::Allocator::DefaultArena();
+    Afina::Allocator::SetDefaultArena(nullptr);
+    {
+        MapBasedGlobalLockImpl global(1048576, EvictionPolicy::Type::SlabLru);
+        check_mutations(global);
+        check_ttl(global);
+
+        MapBasedLockFreeImpl lock_free;
+        check_mutations(lock_free);
+    }
+    Afina::Allocator::SetDefaultArena(process);
+}
+
+TEST(StorageTest, BatchedPromotions) {
+    // Storage fits 3 entries
+    MapBasedGlobalLockImpl storage(budget<MapBasedGlobalLockImpl>(3, 1, 1), EvictionPolicy::Type::Lru, false, true);
+    std::string res;
+
+    storage.Put("a", "1");
+    storage.Put("b", "1");
+    storage.Put("c", "1");
+
+    // Hits are applied in order before the writer picks a victim
+    EXPECT_TRUE(storage.Get("b", res));
+    EXPECT_TRUE(storage.Get("a", res));
+    storage.Put("d", "1");
+    EXPECT_FALSE(storage.Get("c", res));
+    storage.Put("e", "1");
+    EXPECT_FALSE(storage.Get("b", res));
+    EXPECT_TRUE(storage.Get("a", res));
+
+    // Only the most recent hits survive buffer overflow: the hit of "a" above is lost, so it is
+    // the least recently used one now
+    for (size_t i = 0; i < MapBasedGlobalLockImpl::READ_BUFFER_SIZE; i++) {
+        storage.Get("d", res);
+    }
+    storage.Put("f", "1");
+    EXPECT_FALSE(storage.Get("a", res));
+    EXPECT_TRUE(storage.Get("d", res));
+    EXPECT_TRUE(storage.Get("e", res));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+    std::map<std::string, std::string> stats_map(stats.begin(), stats.end());
+    EXPECT_EQ("batched", stats_map["promotion"]);
+    EXPECT_NE("0", stats_map["promotions_dropped"]);
+}
+
+TEST(StorageTest, BatchedPromotionsAllOperations) {
+    MapBasedGlobalLockImpl ttl(1048576, EvictionPolicy::Type::SegmentedLru, false, true);
+    check_ttl(ttl);
+
+    MapBasedGlobalLockImpl metadata(1048576, EvictionPolicy::Type::Lru, false, true);
+    check_metadata(metadata);
+    check_cas(metadata);
+    check_mutations(metadata);
+
+    MapBasedShardedImpl sharded(1048576, 4, EvictionPolicy::Type::Lru, false, true);
+    check_mutations(sharded);
+}
+
+TEST(SwissIndexTest, InsertFindErase) {
+    LinkedList list;
+    SwissIndex index;
+    std::map<std::string, LinkedList::Entry *> model;
+
+    // Churn on a fixed key set leaves plenty of deleted slots behind, table has to reuse them
+    std::mt19937 gen(42);
+    for (int i = 0; i < 200000; i++) {
+        std::string key = "key" + std::to_string(gen() % 5000);
+        SwissIndex::Slot *slot = index.Find(key);
+        auto it = model.find(key);
+        ASSERT_EQ(it == model.end(), slot == nullptr) << key;
+        if (slot == nullptr) {
+            LinkedList::Entry *e = list.Put(key, std::to_string(i));
+            ASSERT_EQ(e, *index.Insert(e));
+            model[key] = e;
+        } else {
+            ASSERT_EQ(it->second, *slot);
+            index.Erase(slot);
+            list.Delete(it->second);
+            model.erase(it);
+        }
+    }
+
+    ASSERT_EQ(model.size(), index.size());
+    for (auto &kv : model) {
+        SwissIndex::Slot *slot = index.Find(kv.first);
+        ASSERT_NE(nullptr, slot);
+        EXPECT_EQ(kv.second, *slot);
+    }
+    EXPECT_EQ(nullptr, index.Find("missing"));
+
+    for (auto &kv : model) {
+        index.Erase(index.Find(kv.first));
+    }
+    EXPECT_TRUE(index.empty());
+    EXPECT_EQ(nullptr, index.Find(model.begin()->first));
+}
+
+template <typename S> static void check_max_size(S &storage) {
+    // Index share is accounted along with the entry
+    EXPECT_GT(S::ItemSize(4, 3), LinkedList::Entry::Footprint(5, 3));
+    for (int i = 0; i < 10; i++) {
+        EXPECT_TRUE(storage.Put(fill_key("k", i), "val"));
+    }
+    EXPECT_EQ(10 * S::ItemSize(4, 3), storage.Size());
+
+    // Smaller limit evicts right away
+    storage.SetMaxSize(4 * S::ItemSize(4, 3));
+    EXPECT_EQ(4 * S::ItemSize(4, 3), storage.Size());
+    std::string value;
+    EXPECT_FALSE(storage.Get(fill_key("k", 5), value));
+    EXPECT_TRUE(storage.Get(fill_key("k", 9), value));
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+    std::map<std::string, std::string> metrics(stats.begin(), stats.end());
+    EXPECT_EQ(std::to_string(4 * S::ItemSize(4, 3)), metrics["bytes"]);
+    EXPECT_EQ(std::to_string(4 * S::ItemSize(4, 3)), metrics["limit_maxbytes"]);
+}
+
+TEST(StorageTest, SetMaxSize) {
+    MapBasedGlobalLockImpl storage(budget<MapBasedGlobalLockImpl>(10, 4, 3));
+    check_max_size(storage);
+
+    std::vector<std::pair<std::string, std::string>> stats;
+    storage.Stats(stats);
+    std::map<std::string, std::string> metrics(stats.begin(), stats.end());
+    EXPECT_EQ("4", metrics["curr_items"]);
+    EXPECT_NE("0", metrics["index_bytes"]);
+}
+
+TEST(FlatCombineStorageTest, SetMaxSize) {
+    MapBasedFlatCombineImpl storage(budget<MapBasedFlatCombineImpl>(10, 4, 3));
+    check_max_size(storage);
+}
+
+TEST(LockFreeStorageTest, SetMaxSize) {
+    MapBasedLockFreeImpl storage(budget<MapBasedLockFreeImpl>(10, 4, 3));
+    check_max_size(storage);
+}
+
+TEST(MemoryLimitTest, Resident) {
+    size_t before = MemoryLimit::Resident();
+    EXPECT_GT(before, 0);
+
+    // Touched pages become resident
+    std::unique_ptr<char[]> block(new char[16 << 20]);
+    std::fill(block.get(), block.get() + (16 << 20), 'x');
+    EXPECT_GT(MemoryLimit::Resident(), before + (8 << 20));
+}
+
+TEST(MemoryLimitTest, FollowsResident) {
+    size_t limit = budget<MapBasedGlobalLockImpl>(1000, 4, 8);
+    MapBasedGlobalLockImpl storage(limit);
+    MemoryLimit memory(storage, limit);
+    for (int i = 0; i < 1000; i++) {
+        storage.Put(fill_key("k", i), std::string(8, 'v'));
+    }
+    EXPECT_EQ(limit, storage.Size());
+
+    // Rest of the process takes half of the limit, storage limit goes there step by step
+    for (int i = 0; i < 32; i++) {
+        memory.Sample(storage.Size() + limit / 2);
+        EXPECT_LE(storage.Size(), memory.max_size());
+    }
+    EXPECT_LE(memory.max_size(), limit / 2 + 1);
+    EXPECT_GE(memory.max_size(), limit / 2 - 1);
+
+    // Overhead alone is over the limit, but storage keeps some room
+    for (int i = 0; i < 32; i++) {
+        memory.Sample(storage.Size() + 2 * limit);
+    }
+    EXPECT_GE(memory.max_size(), limit / MemoryLimit::MIN_SHARE);
+    EXPECT_LE(memory.max_size(), limit / MemoryLimit::MIN_SHARE + 1);
+    EXPECT_TRUE(storage.Put("key", "val"));
+
+    // Once memory is back storage grows again
+    for (int i = 0; i < 32; i++) {
+        memory.Sample(storage.Size());
+    }
+    EXPECT_GE(memory.max_size(), limit - 1);
+}
+
+TEST(MemoryLimitTest, FreedChunksAreNotOverhead) {
+    size_t limit = budget<MapBasedGlobalLockImpl>(1000, 4, 8);
+    MapBasedGlobalLockImpl storage(limit);
+    MemoryLimit memory(storage, limit);
+    for (int i = 0; i < 1000; i++) {
+        storage.Put(fill_key("k", i), std::string(8, 'v'));
+    }
+
+    // Evicted items stay resident as free chunks of the allocator, so RSS doesn't go down while storage
+    // shrinks. Only the rest of the process is overhead, storage limit stops there
+    size_t resident = limit + limit / 8;
+    for (int i = 0; i < 32; i++) {
+        memory.Sample(resident, limit - storage.Size());
+        EXPECT_LE(storage.Size(), memory.max_size());
+    }
+    EXPECT_GT(resident, limit);
+    EXPECT_LE(memory.max_size(), limit - limit / 8 + 1);
+    EXPECT_GE(memory.max_size(), limit - limit / 8 - 1);
+}